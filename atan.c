@@ -43,12 +43,10 @@
 
 
 #include <stdint.h>
-
-float p_nan(void);
-double p_abs(double v);
+#include "prayertimes.h"
 
 int isnan(double v) {
-	return v == p_nan() ? 1 : 0;
+	return v != v;
 }
 
 #define FORCE_EVAL(x) do {                        \
@@ -85,21 +83,36 @@ do {                                              \
 } while (0)
 
 
-static const double atanhi[] = {
+#ifdef PT_SMALL_ATAN
+/* atan(x) = asin(x/sqrt(1+x*x)) for |x| <= 1, and pi/2 - atan(1/|x|)
+ * above, so that asin is taken below sqrt(1/2) only. A few ulps more
+ * than the tables below, with none of their size.
+ */
+double p_atan(double x)
+{
+	double a = p_abs(x), z;
+
+	if (a <= 1.0)
+		return p_asin(x/p_sqrt(1.0+x*x));
+	z = 1.57079632679489655800e+00 - p_asin(1.0/p_sqrt(1.0+a*a));
+	return x < 0.0 ? -z : z;
+}
+#else
+static const double atanhi[] PT_ROM = {
   4.63647609000806093515e-01, /* atan(0.5)hi 0x3FDDAC67, 0x0561BB4F */
   7.85398163397448278999e-01, /* atan(1.0)hi 0x3FE921FB, 0x54442D18 */
   9.82793723247329054082e-01, /* atan(1.5)hi 0x3FEF730B, 0xD281F69B */
   1.57079632679489655800e+00, /* atan(inf)hi 0x3FF921FB, 0x54442D18 */
 };
 
-static const double atanlo[] = {
+static const double atanlo[] PT_ROM = {
   2.26987774529616870924e-17, /* atan(0.5)lo 0x3C7A2B7F, 0x222F65E2 */
   3.06161699786838301793e-17, /* atan(1.0)lo 0x3C81A626, 0x33145C07 */
   1.39033110312309984516e-17, /* atan(1.5)lo 0x3C700788, 0x7AF0CBBD */
   6.12323399573676603587e-17, /* atan(inf)lo 0x3C91A626, 0x33145C07 */
 };
 
-static const double aT[] = {
+static const double aT[] PT_ROM = {
   3.33333333333329318027e-01, /* 0x3FD55555, 0x5555550D */
  -1.99999999998764832476e-01, /* 0xBFC99999, 0x9998EBC4 */
   1.42857142725034663711e-01, /* 0x3FC24924, 0x920083FF */
@@ -167,6 +180,7 @@ double p_atan(double x)
 	z = atanhi[id] - (x*(s1+s2) - atanlo[id] - x);
 	return sign ? -z : z;
 }
+#endif
 
 /* origin: FreeBSD /usr/src/lib/msun/src/e_atan2.c */
 /*
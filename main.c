@@ -3,9 +3,25 @@
 // By Abdullah Daud, chelahmy@gmail.com
 // 20 October 2018
 
-#include "prayertimes.h"
+#define _POSIX_C_SOURCE 200809L
 
-int printf(const char *format, ...);
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "prayertimes.h"
+#include "ptparse.h"
+#include "ptmethod.h"
+#include "ptpool.h"
+#include "ptfmt.h"
+#include "ptarrow.h"
+#include "ptmap.h"
+#include "ptpipe.h"
+#include "ptserve.h"
+#include "ptcache.h"
+#include "ptroute.h"
+#include "ptdem.h"
 
 // Notes:
 // 1. The main objective of this project is to convert the prayer time
@@ -14,140 +30,53 @@ int printf(const char *format, ...);
 //      without the need of the standard math or any library.
 // 
 
-#define METHOD_MWL 0
-#define METHOD_ISNA 1
-#define METHOD_EGYPT 2
-#define METHOD_MAKKAH 3
-#define METHOD_KARACHI 4
-#define METHOD_TEHRAN 5
-#define METHOD_JAFARI 6
+#define BATCH_BUF (1 << 20) // batch input block size
+#define BATCH_MAX_DAYS 36600 // longest date range of a batch record
+#define BATCH_JOBS 4096 // records or parts of records in a block
+#define BATCH_ITEMS 16384 // prayer times of a block
+#define BATCH_TASK 64 // prayer times of a thread task
+#define BATCH_OUT (1 << 20) // output buffer
+#define SERVE_MAX_DAYS 500 // longest date range of a served record
+
+#define OUT_ARROW 3 // Arrow IPC stream of hours
+#define OUT_ARROW_SECONDS 4 // Arrow IPC stream of seconds
 
-struct _pt_method_params
+// Settings of the server mode.
+struct _serve
 {
-	float fajr_rel_d;
-	float isha_rel_d;
-	float isha_rel_m;
-	float maghrib_rel_d;
-	float maghrib_rel_m;
-	short midnight_type;
+	struct _ptimes def; // for fields not in a request
+	short out;
+	struct _ptcache *cache; // of replies, if any
 };
 
-struct _pt_method
+// A record, or a part of a record with a long date range, of a batch block.
+struct _batch_job
 {
-	char *name;
-	char *desc;
-	struct _pt_method_params params;
+	struct _ptimes pt; // location, settings and the first date
+	long id;
+	short has_id;
+	long first; // first prayer times in the block
+	long ndays;
 };
 
-struct _pt_method pt_methods[] =
+// A block of batch input calculated in parallel.
+struct _batch
 {
-	{
-		.name = "MWL",
-		.desc = "Muslim World League",
-		.params =
-		{
-			.fajr_rel_d = 18.0,
-			.isha_rel_d = 17.0,
-			.isha_rel_m = 0.0,
-			.maghrib_rel_d = 0,
-			.maghrib_rel_m = 0,
-			.midnight_type = MIDNIGHT_STANDARD
-		}
-	},
-	{
-		.name = "ISNA",
-		.desc = "Islamic Society of North America (ISNA)",
-		.params =
-		{
-			.fajr_rel_d = 15.0,
-			.isha_rel_d = 15.0,
-			.isha_rel_m = 0.0,
-			.maghrib_rel_d = 0,
-			.maghrib_rel_m = 0,
-			.midnight_type = MIDNIGHT_STANDARD
-		}
-	},
-	{
-		.name = "Egypt",
-		.desc = "Egyptian General Authority of Survey",
-		.params =
-		{
-			.fajr_rel_d = 19.5,
-			.isha_rel_d = 17.5, 
-			.isha_rel_m = 0.0,
-			.maghrib_rel_d = 0,
-			.maghrib_rel_m = 0,
-			.midnight_type = MIDNIGHT_STANDARD
-		}
-	},
-	{
-		.name = "Makkah",
-		.desc = "Umm Al-Qura University, Makkah",
-		.params =
-		{
-			.fajr_rel_d = 18.5, // fajr was 19 degrees before 1430 hijri
-			.isha_rel_d = 0.0,
-			.isha_rel_m = 90.0, 
-			.maghrib_rel_d = 0.0,
-			.maghrib_rel_m = 0,
-			.midnight_type = MIDNIGHT_STANDARD
-		}
-	},
-	{
-		.name = "Karachi",
-		.desc = "University of Islamic Sciences, Karachi",
-		.params =
-		{
-			.fajr_rel_d = 18.0,
-			.isha_rel_d = 18.0,
-			.isha_rel_m = 0.0,
-			.maghrib_rel_d = 0.0,
-			.maghrib_rel_m = 0,
-			.midnight_type = MIDNIGHT_STANDARD
-		}
-	},
-	{
-		.name = "Tehran",
-		.desc = "Institute of Geophysics, University of Tehran",
-		.params =
-		{
-			.fajr_rel_d = 17.7,
-			.isha_rel_d = 14.0, // isha was not explicitly specified in this method
-			.isha_rel_m = 0.0,
-			.maghrib_rel_d = 4.5,
-			.maghrib_rel_m = 0,
-			.midnight_type = MIDNIGHT_JAFARI
-		}
-	},
-	{
-		.name = "Jafari",
-		.desc = "Shia Ithna-Ashari, Leva Institute, Qum",
-		.params =
-		{
-			.fajr_rel_d = 16.0,
-			.isha_rel_d = 14.0,
-			.isha_rel_m = 0.0,
-			.maghrib_rel_d = 4.0,
-			.maghrib_rel_m = 0,
-			.midnight_type = MIDNIGHT_JAFARI
-		}
-	}
+	struct _ptpool pool;
+	struct _ptfmt fmt;
+	struct _ptarrow arrow;
+	struct _ptpipe pipe;
+	char obuf[BATCH_OUT];
+	short out;
+	short piped; // calculated by the stages of *pipe*
+	long njobs;
+	long nitems;
+	struct _batch_job job[BATCH_JOBS];
+	struct _ptimes item[BATCH_ITEMS];
 };
 
-void ptSetMethod(struct _ptimes *pt, short method)
-{
-	if (method < 0 || method >= 7)
-		return;
-	
-	struct _pt_method *m = &(pt_methods[method]);
-	
-	pt->fajr_rel_d = m->params.fajr_rel_d;
-	pt->maghrib_rel_d = m->params.maghrib_rel_d;
-	pt->maghrib_rel_m = m->params.maghrib_rel_m;
-	pt->isha_rel_d = m->params.isha_rel_d;
-	pt->isha_rel_m = m->params.isha_rel_m;
-	pt->midnight_type = m->params.midnight_type;
-}
+// Elevation model of the records with no elevation, if any.
+static struct _ptdem *dem;
 
 // Compare the equality of *s1* and *s2* string.
 int eq(char *s1, char *s2)
@@ -184,135 +113,36 @@ short isnum(char *s)
 	if (*s == '-' || *s == '+')
 		++s;
 
-	if (*s >= '0' && *s < '9')
+	if (*s >= '0' && *s <= '9')
 		return 1;
 
 	return 0;
 }
 
-// Convert string to number.
-double atof(char *s)
+// Convert string to number, decimal or in clock or compass notation.
+// I.e. hh:mm:ss -> nn.nnnn
+double num(char *s)
 {
-	double v = 0.0, dp = 0.0, m = 1.0;
-	
-	s = ltrim(s);
-	
-	if (*s == '-' || *s == '+')
-	{
-		if (*s == '-')
-			m = -1.0;
-		
-		++s;
-	}
-		
-	while (*s != '\0')
-	{
-		if (*s >= '0' && *s <= '9')
-		{
-			dp *= 10.0;
-			v *= 10.0;
-			v += (float)(*s - '0');
-		}
-		else if (*s == '.')
-		{
-			if (dp > 0.0)
-				break;
-				
-			dp = 1.0;
-		}
-		else
-			break;
-		
-		++s;
-	}
-	
-	if (dp > 0.0)
-		v /= dp;
-		
-	return v * m;
-}
+	double v;
 
-// Convert clock or compass notation to number.
-// I.e. hh::mm::ss -> nn.nnnn
-double ctof(char *s)
-{
-	short i = 0, m = 1;
-	short p[3] = {0, 0, 0};
-	
-	s = ltrim(s);
-		
-	if (*s == '-' || *s == '+')
-	{
-		if (*s == '-')
-			m = -1;
-		
-		++s;
-	}
-		
-	while (*s != '\0')
-	{
-		if (*s >= '0' && *s <= '9')
-		{
-			p[i] *= 10;
-			p[i] += (short)(*s - '0');
-		}
-		else if (*s == ':')
-		{
-			if (++i >= 3)
-				break;
-		}
-		else
-			break;
-		
-		++s;
-	}
-	
-	while (p[1] > 60)
-		p[1] -= 60;
-	
-	while (p[2] > 60)
-		p[2] -= 60;
-		
-	return ((double)p[0] + ((double)p[1] / 60.0) + ((double)p[2] / 3600.0)) * (double)m;
+	ps_num(s, s + strlen(s), &v);
+	return v;
 }
 
 // Split date notation <yyyy-mm-dd> to invidual
 // *y*ear, *m*onth and *d*ay parts.
 void ds(char *s, short *y, short *m, short *d)
 {
-	short i = 0, *p[3];
-	
-	p[0] = y;
-	p[1] = m;
-	p[2] = d;
-	
-	*p[0] = 0;
-	*p[1] = 0;
-	*p[2] = 0;
-
-	s = ltrim(s);
-
-	while (*s != '\0')
+	if (ps_date(s, s + strlen(s), y, m, d) == s)
 	{
-		if (*s >= '0' && *s < '9')
-		{
-			*(p[i]) *= 10;
-			*(p[i]) += (short)(*s - '0');
-		}
-		else if (*s == '-')
-		{
-			if (++i >= 3)
-				break;
-		}
-		else
-			break;
-
-		++s;
-	}		
+		*y = 0;
+		*m = 0;
+		*d = 0;
+	}
 }
 
 // Parse arguments into *pt* structure.
-void parseArgs(struct _ptimes *pt, int argc, char *argv[], short *out, short *pm)
+void parseArgs(struct _ptimes *pt, int argc, char *argv[], short *out, short *pm, char **in, short *threads, short *stages, char **sock, short *shards, long *cache, char **elv)
 {
 	short i, a, b, c;
 	char *s;
@@ -325,27 +155,27 @@ void parseArgs(struct _ptimes *pt, int argc, char *argv[], short *out, short *pm
 		if (eq(argv[i], "o")) // output
 		{
 			if (i + 1 < argc)
-				*out = (short)ctof(argv[++i]);
+				*out = (short)num(argv[++i]);
 		}
 		else if (eq(argv[i], "l")) // location
 		{
 			if (i + 1 < argc)
 			{
-				pt->lat = (float)ctof(argv[++i]);
+				pt->lat = (float)num(argv[++i]);
 				
 				if (i + 1 < argc)
 				{
-					pt->lng = (float)ctof(argv[++i]);
+					pt->lng = (float)num(argv[++i]);
 					
 					if (i + 1 < argc && isnum(argv[i+1]))
-						pt->elv = (float)atof(argv[++i]);
+						ptSetElevation(pt, (float)num(argv[++i]));
 				}
 			}
 		}
 		else if (eq(argv[i], "z")) // timezone
 		{
 			if (i + 1 < argc)
-				pt->tz = (float)atof(argv[++i]);		
+				pt->tz = (float)num(argv[++i]);		
 		}
 		else if (eq(argv[i], "d")) // date
 		{
@@ -358,18 +188,18 @@ void parseArgs(struct _ptimes *pt, int argc, char *argv[], short *out, short *pm
 		else if (eq(argv[i], "m")) // method
 		{
 			if (i + 1 < argc)
-				ptSetMethod(pt, (short)atof(argv[++i]) - 1);
+				ptSetMethod(pt, (short)num(argv[++i]) - 1);
 		}
 		else if (eq(argv[i], "p")) // print method
 		{
 			if (i + 1 < argc)
-				*pm = (short)atof(argv[++i]);
+				*pm = (short)num(argv[++i]);
 		}
 		else if (eq(argv[i], "a")) // adjustment
 		{
 			if (i + 1 < argc)
 			{
-				a = (short)atof(argv[++i]); // prayer time
+				a = (short)num(argv[++i]); // prayer time
 
 				if (i + 1 < argc)
 				{
@@ -377,26 +207,10 @@ void parseArgs(struct _ptimes *pt, int argc, char *argv[], short *out, short *pm
 
 					if (i + 1 < argc)
 					{
-						v = (float)atof(argv[++i]); // value
-						
-						if (eq(s, "m"))
-							switch (a)
-							{
-								case 1: pt->imsak_rel_m = v; break;
-								case 2: pt->fajr_rel_m = v; break;
-								case 3: pt->dhuhr_rel_m = v; break;
-								case 4: pt->asr_rel_m = v; break;
-								case 5: pt->maghrib_rel_m = v; break;
-								case 6: pt->isha_rel_m = v; break;
-							}
-						else if (eq(s, "d"))
-							switch (a)
-							{
-								case 1: pt->imsak_rel_d = v; break;
-								case 2: pt->fajr_rel_d = v; break;
-								case 5: pt->maghrib_rel_d = v; break;
-								case 6: pt->isha_rel_d = v; break;
-							}
+						v = (float)num(argv[++i]); // value
+
+						if (s[0] != '\0' && s[1] == '\0')
+							ptAdjust(pt, a, s[0], v);
 					}
 				}
 			}
@@ -404,17 +218,57 @@ void parseArgs(struct _ptimes *pt, int argc, char *argv[], short *out, short *pm
 		else if (eq(argv[i], "f")) // asr factor
 		{
 			if (i + 1 < argc)
-				pt->asr_factor = (float)atof(argv[++i]);
+				pt->asr_factor = (float)num(argv[++i]);
 		}
 		else if (eq(argv[i], "n")) // midnight type
 		{
 			if (i + 1 < argc)
-				pt->midnight_type = (short)atof(argv[++i]);
+				pt->midnight_type = (short)num(argv[++i]);
 		}
 		else if (eq(argv[i], "h")) // high latitude adjustment
 		{
 			if (i + 1 < argc)
-				pt->high_lats = (short)atof(argv[++i]);
+				pt->high_lats = (short)num(argv[++i]);
+		}
+		else if (eq(argv[i], "x")) // model of the Sun position
+		{
+			if (i + 1 < argc)
+				ptSetSunModel(pt, (short)num(argv[++i]) - 1);
+		}
+		else if (eq(argv[i], "b")) // batch input
+		{
+			if (i + 1 < argc)
+				*in = argv[++i];
+		}
+		else if (eq(argv[i], "j")) // batch threads
+		{
+			if (i + 1 < argc)
+				*threads = (short)num(argv[++i]);
+		}
+		else if (eq(argv[i], "u")) // server socket
+		{
+			if (i + 1 < argc)
+				*sock = argv[++i];
+		}
+		else if (eq(argv[i], "s")) // batch stages
+		{
+			if (i + 1 < argc)
+				*stages = (short)num(argv[++i]);
+		}
+		else if (eq(argv[i], "k")) // server shards
+		{
+			if (i + 1 < argc)
+				*shards = (short)num(argv[++i]);
+		}
+		else if (eq(argv[i], "c")) // server cache
+		{
+			if (i + 1 < argc)
+				*cache = (long)num(argv[++i]);
+		}
+		else if (eq(argv[i], "e")) // elevation model
+		{
+			if (i + 1 < argc)
+				*elv = argv[++i];
 		}
 	} 
 }
@@ -444,6 +298,10 @@ void help(void)
 	printf("\to <output type>\n");
 	printf("\t   1 CSV\n");
 	printf("\t   2 JSON\n");
+	printf("\t   3 Arrow IPC stream, times in hours (float64)\n");
+	printf("\t   4 Arrow IPC stream, times in seconds from midnight (int32)\n");
+	printf("\t   5 CSV, times in Unix time, seconds since 1970 UTC, empty\n");
+	printf("\t     when a time does not occur\n");
 	printf("\t   If no output type is specified then a normal form\n");
 	printf("\t   of prayer times will be printed out.\n");
 	printf("\tl <latitute> <longitude> [<elevation>]\n");
@@ -494,25 +352,570 @@ void help(void)
 	printf("\t   1 middle of night\n");
 	printf("\t   2 angle/60th of night\n");
 	printf("\t   3 1/7th of night\n");
+	printf("\tx <model of the position of the Sun>\n");
+	printf("\t   1 USNO approximation, the default\n");
+	printf("\t   2 NOAA series with nutation, most accurate\n");
+	printf("\t   3 Spencer's Fourier series, cheapest\n");
+	printf("\tb <file>\n");
+	printf("\t   Calculate prayer times for every record of a file,\n");
+	printf("\t   or of the standard input for -, one record a line:\n");
+	printf("\t   CSV  id,lat,lng,elv,tz,method,date[,to[,adjustments]]\n");
+	printf("\t   JSON {\"id\":1,\"lat\":\"1:43\",\"lng\":\"103:32\",\"tz\":8,\n");
+	printf("\t         \"method\":3,\"date\":\"2018-10-01\",\"to\":\"2018-10-31\"}\n");
+	printf("\t   Adjustments are <prayer time><m|d><value> separated\n");
+	printf("\t   by spaces, i.e. 2d18.5 6m90. Empty or missing fields\n");
+	printf("\t   are taken from the other options.\n");
+	printf("\tj <threads>\n");
+	printf("\t   Threads for the batch input, one per CPU by default.\n");
+	printf("\ts <stages>\n");
+	printf("\t   1 Parse, calculate and print the batch input in stages\n");
+	printf("\t     on their own threads, j threads calculating.\n");
+	printf("\t   2 Also print the counters of the stages at the end.\n");
+	printf("\tu <socket>\n");
+	printf("\t   Serve on a Unix domain socket. Every line sent is a\n");
+	printf("\t   record as of the b option, answered by its prayer times\n");
+	printf("\t   and an empty line, on j threads. A record of more\n");
+	printf("\t   than %d days is refused.\n", SERVE_MAX_DAYS);
+	printf("\te <file>\n");
+	printf("\t   Elevation model for the b and u records with no\n");
+	printf("\t   elevation, heights on a lattice as of ptdem.h.\n");
+	printf("\tk <shards>\n");
+	printf("\t   Serve with as many server processes, each owning the\n");
+	printf("\t   locations of a part of the map, behind a router on\n");
+	printf("\t   the u socket. Shard i listens on <socket>.i.\n");
+	printf("\tc <entries>\n");
+	printf("\t   Cache the replies of as many recent requests in each\n");
+	printf("\t   server process.\n");
 	printf("\t   \n");
 	printf("\tExample: pt l 1:43 103:32 z 8 d 2018-10-20 m 3\n");
+	printf("\t         pt o 1 d 2018-10-20 b locations.csv\n");
 	printf("\n");
 	printf("By Abdullah Daud, chelahmy@gmail.com, 2018.\n");
 	printf("Credits to PrayTimes.org\n\n");
 }
 
-void hms(double t, char end)
+// Find the job of output *item* in block *b*.
+long findJob(struct _batch *b, long item)
+{
+	long lo = 0, hi = b->njobs - 1, m;
+
+	while (lo < hi)
+	{
+		m = (lo + hi + 1) / 2;
+
+		if (b->job[m].first <= item)
+			lo = m;
+		else
+			hi = m - 1;
+	}
+
+	return lo;
+}
+
+// Calculate a task of BATCH_TASK output items of block *arg*.
+// Consecutive items of the same date share the positions of the Sun.
+void batchTask(void *arg, long task, int worker)
+{
+	struct _batch *b = arg;
+	struct _batch_job *job;
+	struct _ptimes pt;
+	struct _ptsun sun;
+	long i = task * BATCH_TASK, e = i + BATCH_TASK, j = findJob(b, i);
+	short y, m, d;
+
+	sun.jd = 0.0;
+
+	if (e > b->nitems)
+		e = b->nitems;
+
+	for (; i < e; i++)
+	{
+		while (b->job[j].first + b->job[j].ndays <= i)
+			++j;
+
+		job = &(b->job[j]);
+		pt = job->pt;
+		gregorian(pt.jd + (double)(i - job->first), &y, &m, &d);
+		ptSetDate(&pt, y, m, d);
+
+		if (sun.jd != pt.jd || sun.model != pt.sun_model)
+			ptSunInit(&sun, pt.jd, pt.sun_model);
+
+		pt.sun = &sun;
+		pt.phase = 0;
+
+		while (ptCalc(&pt) != 0);
+
+		pt.sun = 0;
+		b->item[i] = pt;
+	}
+}
+
+// Print the prayer times *pt* of location *id*, 0 if none, of block *arg*.
+void emit(void *arg, struct _ptimes *pt, long *id)
+{
+	struct _batch *b = arg;
+
+	if (b->out == OUT_ARROW || b->out == OUT_ARROW_SECONDS)
+		ptArrowAdd(&(b->arrow), pt, id != 0 ? *id : 0);
+	else
+		ptFmtTimes(&(b->fmt), pt, b->out, id);
+}
+
+// Calculate the queued jobs of block *b* on its pool and print them in
+// the order of the input.
+void flush(struct _batch *b)
+{
+	struct _batch_job *job;
+	long i, k;
+
+	ptPoolRun(&(b->pool), (b->nitems + BATCH_TASK - 1) / BATCH_TASK, batchTask, b);
+
+	for (i = 0; i < b->njobs; i++)
+	{
+		job = &(b->job[i]);
+
+		for (k = 0; k < job->ndays; k++)
+			emit(b, &(b->item[job->first + k]), job->has_id ? &(job->id) : 0);
+	}
+
+	b->njobs = 0;
+	b->nitems = 0;
+}
+
+// Set the fields of batch record *r* to *pt* as of ptSetRecord(), and its
+// elevation from the elevation model when it has none.
+// Return 0 on success, -1 when the record is not valid.
+int setRecord(struct _ptimes *pt, struct _ptrec *r, double *last)
+{
+	if (ptSetRecord(pt, r, BATCH_MAX_DAYS, last) != 0)
+		return -1;
+
+	if (dem != 0 && !(r->has & PTREC_ELV))
+		ptSetElevation(pt, ptDemHeight(dem, pt->lat, pt->lng));
+
+	return 0;
+}
+
+// Queue the prayer times of a batch record *r* for every date of its
+// range to block *b*. Fields not in the record are taken from *def*.
+// Return 0 on success, -1 when the record is not valid.
+int addRecord(struct _batch *b, struct _ptrec *r, struct _ptimes *def)
+{
+	struct _ptimes pt = *def;
+	struct _batch_job *job;
+	double jd, last;
+	long n;
+	short y, m, d;
+
+	if (setRecord(&pt, r, &last) != 0)
+		return -1;
+
+	jd = pt.jd;
+
+	if (b->piped) // a day at a time down the pipeline
+	{
+		for (; jd <= last; jd += 1.0)
+		{
+			gregorian(jd, &y, &m, &d);
+			ptSetDate(&pt, y, m, d);
+			ptPipeAdd(&(b->pipe), &pt, r->has & PTREC_ID ? &(r->id) : 0);
+		}
+
+		return 0;
+	}
+
+	// a long range is split over blocks
+	while (jd <= last)
+	{
+		if (b->njobs == BATCH_JOBS || b->nitems == BATCH_ITEMS)
+			flush(b);
+
+		n = (long)(last - jd) + 1;
+
+		if (n > BATCH_ITEMS - b->nitems)
+			n = BATCH_ITEMS - b->nitems;
+
+		gregorian(jd, &y, &m, &d);
+		ptSetDate(&pt, y, m, d);
+
+		job = &(b->job[b->njobs++]);
+		job->pt = pt;
+		job->id = r->id;
+		job->has_id = (r->has & PTREC_ID) != 0;
+		job->first = b->nitems;
+		job->ndays = n;
+
+		b->nitems += n;
+		jd += (double)n;
+	}
+
+	return 0;
+}
+
+// Take the result *ok* of parsing *line* into *r*, as of ptParseRecord().
+// Return 1 when the record is not valid.
+int takeRecord(struct _batch *b, struct _ptrec *r, int ok, long line, struct _ptimes *def)
 {
-	short h, m, s;
-	t2hms(t, &h, &m, &s);
-	printf("%02d:%02d:%02d%c", h, m, s, end);	
+	if (ok == 1 && addRecord(b, r, def) != 0)
+		ok = -1;
+
+	if (ok == -1)
+	{
+		fprintf(stderr, "pt: invalid record at line %ld\n", line);
+		return 1;
+	}
+
+	return 0;
+}
+
+// Queue the records of batch input *f* to block *b*. The input is read in
+// large blocks and the records are parsed in place.
+// Return the number of invalid lines.
+long batchStream(FILE *f, struct _batch *b, struct _ptimes *def)
+{
+	static char buf[BATCH_BUF];
+	struct _ptrec r;
+	char *s, *e, *eol;
+	size_t len = 0, n;
+	long line = 0, bad = 0;
+	short eof = 0, skip = 0;
+
+	while (!eof)
+	{
+		n = fread(buf + len, 1, BATCH_BUF - len, f);
+		eof = n == 0;
+		len += n;
+		s = buf;
+		e = buf + len;
+
+		while (s < e)
+		{
+			eol = memchr(s, '\n', e - s);
+
+			if (eol == 0)
+			{
+				if (!eof && (s > buf || len < BATCH_BUF))
+					break; // read the rest of the line
+
+				eol = e; // last line, or a line longer than the buffer
+			}
+
+			if (skip) // the rest of a line longer than the buffer
+				skip = eol == e && !eof;
+			else
+			{
+				++line;
+
+				if (eol == e && !eof)
+				{
+					fprintf(stderr, "pt: line %ld is too long\n", line);
+					++bad;
+					skip = 1;
+				}
+				else
+					bad += takeRecord(b, &r, ptParseRecord(s, eol, &r), line, def);
+			}
+
+			s = eol + 1;
+		}
+
+		// keep the partial line
+		len = s < e ? (size_t)(e - s) : 0;
+		memmove(buf, s < e ? s : e, len);
+	}
+
+	return bad;
+}
+
+// Queue the records of mapped batch input *m* to block *b*. The chunks of
+// a window are parsed in parallel on the pool of the block.
+// Return the number of invalid lines.
+long batchMap(struct _ptmap *m, struct _batch *b, struct _ptimes *def)
+{
+	struct _ptmap_chunk *c;
+	struct _ptrec r;
+	const char *s, *eol;
+	long i, k, line = 0, bad = 0;
+
+	while (ptMapParse(m, &(b->pool)) > 0)
+	{
+		for (i = 0; i < m->nchunks; i++)
+		{
+			c = &(m->chunk[i]);
+
+			for (k = 0; k < c->n; k++)
+				bad += takeRecord(b, &(c->rec[k].r), c->rec[k].ok, line + c->rec[k].line, def);
+
+			line += c->lines;
+
+			// lines past the records of the chunk
+			for (s = c->stop; s < c->e; s = eol + 1)
+			{
+				eol = memchr(s, '\n', c->e - s);
+
+				if (eol == 0)
+					eol = c->e;
+
+				++line;
+				bad += takeRecord(b, &r, ptParseRecord(s, eol, &r), line, def);
+			}
+		}
+	}
+
+	return bad;
+}
+
+// Calculate and print the prayer times of every record of a batch input
+// *path*, or of the standard input for "-", on *threads* threads. A file
+// is mapped into memory, anything else is read. With *stages*, the input
+// is parsed, calculated and printed in a pipeline.
+// Return 0 on success, 1 when the input cannot be read or has invalid records.
+int batch(char *path, struct _ptimes *def, short out, short threads, short stages)
+{
+	static const char *names[PTPIPE_STAGES] = {"parse", "calc", "format"};
+	struct _ptpipe_stat *st;
+	static struct _batch b;
+	static struct _ptmap m;
+	FILE *f = 0;
+	long bad;
+	short i, mapped = !eq(path, "-") && ptMapOpen(&m, path) == 0;
+
+	if (!mapped)
+	{
+		f = eq(path, "-") ? stdin : fopen(path, "rb");
+
+		if (f == 0)
+		{
+			fprintf(stderr, "pt: cannot open %s\n", path);
+			return 1;
+		}
+	}
+
+	b.out = out;
+	b.piped = stages > 0;
+
+	// a pipeline maps input with the pool of the parse stage only
+	if (ptPoolInit(&(b.pool), b.piped ? 1 : threads) != 0
+		|| (b.piped && ptPipeInit(&(b.pipe), threads, emit, &b) != 0))
+	{
+		fprintf(stderr, "pt: cannot start threads\n");
+		return 1;
+	}
+
+	if ((out == OUT_ARROW || out == OUT_ARROW_SECONDS)
+		&& ptArrowOpen(&(b.arrow), 1, out == OUT_ARROW ? PTARROW_HOURS : PTARROW_SECONDS, BATCH_ITEMS) != 0)
+	{
+		fprintf(stderr, "pt: cannot write the output\n");
+		return 1;
+	}
+
+	ptFmtInit(&(b.fmt), b.obuf, BATCH_OUT, 1);
+	b.njobs = 0;
+	b.nitems = 0;
+
+	bad = mapped ? batchMap(&m, &b, def) : batchStream(f, &b, def);
+
+	if (b.piped)
+	{
+		ptPipeClose(&(b.pipe));
+
+		for (i = 0; stages > 1 && i < PTPIPE_STAGES; i++)
+		{
+			st = &(b.pipe.stat[i]);
+			fprintf(stderr, "pt: %-6s %9ld batches %11ld items %9.3fs busy %9.3fs waiting\n",
+				names[i], st->batches, st->items, st->busy, st->wait);
+		}
+	}
+	else
+		flush(&b);
+	ptFmtFlush(&(b.fmt));
+	ptPoolFree(&(b.pool));
+
+	if ((out == OUT_ARROW || out == OUT_ARROW_SECONDS) && ptArrowClose(&(b.arrow)) != 0)
+	{
+		fprintf(stderr, "pt: cannot write the output\n");
+		++bad;
+	}
+
+	if (mapped)
+		ptMapClose(&m);
+	else if (f != stdin)
+		fclose(f);
+
+	return bad > 0;
+}
+
+// Reply to request line [s, e), a batch record, of the server *arg* with
+// the prayer times of every date of its range into *out* of *room* bytes,
+// and an empty line.
+size_t reply(void *arg, const char *s, const char *e, char *out, size_t room)
+{
+	static const char invalid[] = "!invalid record\n\n", range[] = "!range too long\n\n";
+	struct _serve *sv = arg;
+	struct _ptrec r;
+	struct _ptimes pt;
+	struct _ptfmt f;
+	double jd, last;
+	short y, m, d;
+	size_t n;
+
+	if (sv->cache != 0 && (n = ptCacheGet(sv->cache, s, (size_t)(e - s), out, room)) > 0)
+		return n;
+
+	switch (ptParseRecord(s, e, &r))
+	{
+		case 0: out[0] = '\n'; return 1;
+		case -1: memcpy(out, invalid, sizeof(invalid) - 1); return sizeof(invalid) - 1;
+	}
+
+	pt = sv->def;
+
+	if (setRecord(&pt, &r, &last) != 0)
+	{
+		memcpy(out, invalid, sizeof(invalid) - 1);
+		return sizeof(invalid) - 1;
+	}
+
+	// a record each day and the empty line always fit
+	if (last - pt.jd + 1.0 > SERVE_MAX_DAYS || last - pt.jd + 2.0 > (double)(room / PTFMT_MAX_RECORD))
+	{
+		memcpy(out, range, sizeof(range) - 1);
+		return sizeof(range) - 1;
+	}
+
+	ptFmtInit(&f, out, room, -1);
+
+	for (jd = pt.jd; jd <= last; jd += 1.0)
+	{
+		gregorian(jd, &y, &m, &d);
+		ptSetDate(&pt, y, m, d);
+		pt.phase = 0;
+
+		while (ptCalc(&pt) != 0);
+
+		ptFmtTimes(&f, &pt, sv->out, r.has & PTREC_ID ? &(r.id) : 0);
+	}
+
+	out[f.len++] = '\n';
+
+	if (sv->cache != 0)
+		ptCachePut(sv->cache, s, (size_t)(e - s), out, f.len);
+
+	return f.len;
+}
+
+static struct _ptserve server;
+static struct _ptroute router;
+
+void stop(int sig)
+{
+	ptServeStop(&server);
+	ptRouteStop(&router);
+}
+
+// Serve the prayer times of request lines on Unix domain socket *path*
+// on *threads* threads, caching the replies of *cache* requests. Fields
+// not in a request are taken from *def*.
+int serve(char *path, struct _ptimes *def, short out, short threads, long cache)
+{
+	static struct _serve sv;
+	static struct _ptcache c;
+
+	sv.def = *def;
+	sv.out = out == OUT_ARROW || out == OUT_ARROW_SECONDS ? PTFMT_CSV : out;
+	sv.cache = 0;
+
+	if (cache > 0)
+	{
+		if (ptCacheInit(&c, cache) != 0)
+		{
+			fprintf(stderr, "pt: cannot allocate the cache\n");
+			return 1;
+		}
+
+		sv.cache = &c;
+	}
+
+	if (ptServeInit(&server, path, threads, reply, &sv) != 0)
+	{
+		fprintf(stderr, "pt: cannot listen on %s\n", path);
+		return 1;
+	}
+
+	signal(SIGINT, stop);
+	signal(SIGTERM, stop);
+	ptServeRun(&server);
+
+	if (sv.cache != 0)
+	{
+		fprintf(stderr, "pt: %s cache %ld hits %ld misses\n", path, c.hits, c.misses);
+		ptCacheFree(&c);
+	}
+
+	return 0;
+}
+
+// Serve as of serve() with *shards* server processes, each listening on
+// *path*.<shard>, behind a router listening on *path*.
+int serveShards(char *path, struct _ptimes *def, short out, short threads, short shards, long cache)
+{
+	static char name[PTROUTE_MAX_SHARDS][sizeof(((struct sockaddr_un *)0)->sun_path)];
+	const char *names[PTROUTE_MAX_SHARDS];
+	pid_t pid[PTROUTE_MAX_SHARDS];
+	short i, n;
+	int ok;
+
+	if (shards > PTROUTE_MAX_SHARDS)
+	{
+		fprintf(stderr, "pt: at most %d shards\n", PTROUTE_MAX_SHARDS);
+		return 1;
+	}
+
+	for (n = 0; n < shards; n++)
+	{
+		snprintf(name[n], sizeof(name[n]), "%s.%d", path, n);
+		names[n] = name[n];
+		pid[n] = fork();
+
+		if (pid[n] == 0)
+			_exit(serve(name[n], def, out, threads, cache));
+
+		if (pid[n] < 0)
+			break;
+	}
+
+	ok = n == shards && ptRouteInit(&router, path, names, shards, def->lat, def->lng) == 0;
+
+	if (!ok)
+		fprintf(stderr, "pt: cannot route on %s\n", path);
+	else
+	{
+		signal(SIGINT, stop);
+		signal(SIGTERM, stop);
+		ptRouteRun(&router);
+	}
+
+	for (i = 0; i < n; i++)
+		kill(pid[i], SIGTERM);
+
+	for (i = 0; i < n; i++)
+		waitpid(pid[i], 0, 0);
+
+	return !ok;
 }
 
 int main(int argc, char *argv[])
 {
 	struct _ptimes pt;
-	struct _pt_method *ptm;
-	short out = 0, pm = 0;
+	const struct _pt_method *ptm;
+	struct _ptfmt fmt;
+	struct _ptarrow arrow;
+	static struct _ptdem elevations;
+	char obuf[PTFMT_MAX_RECORD];
+	short out = 0, pm = 0, threads = 0, stages = 0, shards = 0;
+	long cache = 0;
+	char *in = 0, *sock = 0, *elv = 0;
 		
 	ptInit(&pt);
 	ptSetLocation(&pt, 43, -80, 0, -5); // Waterloo, ON, Canada
@@ -524,7 +927,27 @@ int main(int argc, char *argv[])
 		return 0;
 	}
 
-	parseArgs(&pt, argc - 1, &(argv[1]), &out, &pm);
+	parseArgs(&pt, argc - 1, &(argv[1]), &out, &pm, &in, &threads, &stages, &sock, &shards, &cache, &elv);
+
+	if (elv != 0)
+	{
+		if (ptDemOpen(&elevations, elv) != 0)
+		{
+			fprintf(stderr, "pt: cannot read the elevation model %s\n", elv);
+			return 1;
+		}
+
+		dem = &elevations;
+	}
+
+	if (sock != 0 && shards > 0)
+		return serveShards(sock, &pt, out, threads, shards, cache);
+
+	if (sock != 0)
+		return serve(sock, &pt, out, threads, cache);
+
+	if (in != 0)
+		return batch(in, &pt, out, threads, stages);
 
 	while (ptCalc(&pt) != 0)
 	{
@@ -535,9 +958,8 @@ int main(int argc, char *argv[])
 
 	if (pm > 0)
 	{
-		if (--pm >= 0 && pm < 7) // print method settings
+		if (--pm >= 0 && pm < METHODS && (ptm = ptMethod(pm)) != 0) // print method settings
 		{ 
-			ptm = &pt_methods[pm];
 			printf("%s\n", ptm->desc);
 
 			if (ptm->params.fajr_rel_d != 0.0)
@@ -626,49 +1048,18 @@ int main(int argc, char *argv[])
 		else
 			printf("Invalid number\n");
 	}
-	else if (out == 1) // CSV
-	{
-		printf("%04d-%02d-%02d,", pt.year, pt.month, pt.day);
-		hms(pt.imsak, ',');
-		hms(pt.fajr, ',');
-		hms(pt.sunrise, ',');
-		hms(pt.dhuhr, ',');
-		hms(pt.asr, ',');
-		hms(pt.sunset, ',');
-		hms(pt.maghrib, ',');
-		hms(pt.isha, ',');
-		hms(pt.midnight, ' ');
-		printf("\n");
-	}
-	else if (out == 2) // JSON
-	{
-		printf("{\"date\":\"%04d-%02d-%02d\"", pt.year, pt.month, pt.day);
-		printf(",\"imsak\":\"");		hms(pt.imsak, '"');
-		printf(",\"fajr\":\"");		hms(pt.fajr, '"');
-		printf(",\"sunrise\":\"");	hms(pt.sunrise, '"');
-		printf(",\"dhuhr\":\"");		hms(pt.dhuhr, '"');
-		printf(",\"asr\":\"");		hms(pt.asr, '"');
-		printf(",\"sunset\":\"");	hms(pt.sunset, '"');
-		printf(",\"maghrib\":\"");	hms(pt.maghrib, '"');
-		printf(",\"isha\":\"");		hms(pt.isha, '"');
-		printf(",\"midnight\":\"");	hms(pt.midnight, '"');
-		printf("}\n"); 
+	else if (out == OUT_ARROW || out == OUT_ARROW_SECONDS)
+	{
+		if (ptArrowOpen(&arrow, 1, out == OUT_ARROW ? PTARROW_HOURS : PTARROW_SECONDS, 1) == 0)
+			ptArrowAdd(&arrow, &pt, 0);
+
+		return ptArrowClose(&arrow) != 0;
 	}
 	else
-	{	
-		printf("----%04d-%02d-%02d----\n", pt.year, pt.month, pt.day);
-		printf("lat %14.6f\nlng %14.6f\nelv %14.6f\n", pt.lat, pt.lng, pt.elv);
-		printf("tz  %14.6f\n", pt.tz);
-		printf("------------------\n");
-		printf("imsak:    "); hms(pt.imsak, '\n');
-		printf("fajr:     "); hms(pt.fajr, '\n');
-		printf("sunrise:  "); hms(pt.sunrise, '\n');
-		printf("dhuhr:    "); hms(pt.dhuhr, '\n');
-		printf("asr:      "); hms(pt.asr, '\n');
-		printf("sunset:   "); hms(pt.sunset, '\n');
-		printf("maghrib:  "); hms(pt.maghrib, '\n');
-		printf("isha:     "); hms(pt.isha, '\n');
-		printf("midnight: "); hms(pt.midnight, '\n');
+	{
+		ptFmtInit(&fmt, obuf, sizeof(obuf), 1);
+		ptFmtTimes(&fmt, &pt, out, 0);
+		ptFmtFlush(&fmt);
 	}
 	
 	return 0;
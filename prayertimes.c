@@ -9,6 +9,7 @@
 // completed on 19 October 2018
 // on as-is-time basis
 
+#include <stdint.h>
 #include "prayertimes.h"
 
 // Notes:
@@ -32,12 +33,12 @@
 
 //---------------------- Math routines --------------------
 
-// IEEE 754 floating point NAN value
-// https://stackoverflow.com/a/1923903
+// IEEE 754 floating point quiet NAN value
 float p_nan(void)
 {
-	int nan = 0x7F800001;
-	return *(float*)&nan;
+	union { uint32_t i; float f; } u = {0x7FC00000};
+
+	return u.f;
 }
 
 // Absolute value
@@ -46,238 +47,200 @@ double p_abs(double v)
 	return v < 0.0 ? -v : v;
 }
 
-// 10^pow for used by p_sqrt()
-long p_10(short pow)
+// Square root by Newton's method from a guess of half the exponent, good
+// to 6%, so that four steps reach double precision. NAN for *v* below 0.
+double p_sqrt(double v)
 {
-	long t = 1;
-	for (; pow > 0; t *= 10, --pow);
-	return t;
+	union { double f; uint64_t i; } u;
+	double r;
+
+	if (!(v > 0.0))
+		return v == 0.0 ? 0.0 : p_nan();
+
+	u.f = v;
+	u.i = (u.i >> 1) + (0x3FF0000000000000ULL >> 1);
+	r = u.f;
+	r = 0.5 * (r + v / r);
+	r = 0.5 * (r + v / r);
+	r = 0.5 * (r + v / r);
+
+	return 0.5 * (r + v / r);
 }
 
-// Square root based on algorithm
-// from https://www.homeschoolmath.net/teaching/square-root-algorithm.php
-double p_sqrt(double v)
+//---------------------- Degree-based trignometry routines -----------------------
+
+// The sine and cosine are computed from a polynomial kernel on [-pi/4, pi/4]
+// after reducing the argument by a whole number of quarter turns, in
+// constant time whatever the argument.
+// PT_TRIG_TIER picks the degree of the kernels, see prayertimes.h.
+
+// pi/2 in three parts for the Cody-Waite reduction. The first two have
+// their low bits zero, so k * part is exact for |k| < 2^20.
+#define PIO2_1  1.57079632673412561417e+00 // 0x3FF921FB, 0x54400000
+#define PIO2_2  6.07710050630396597660e-11 // 0x3DD0B461, 0x1A600000
+#define PIO2_2T 2.02226624879595063154e-21 // 0x3BA3198A, 0x2E037073
+#define INVPIO2 6.36619772367581382433e-01 // 2/pi
+#define DTR     1.74532925199432957692e-02 // pi/180
+
+// Nearest whole number of *x*, for |x| < 2^31. 0 for a NAN or larger *x*,
+// whose conversion to long is undefined.
+static double nearest(double x)
 {
-	long t, d, b = 0, ir = 0, s, p10, i = (long)v; // integer part
-	double f = v - (double)i; // fragment part
-	short j, k, c = 1;
-	for (t = i; t /= 10; c++); // count digits
-	
-	// extract the first digits
-	if (c % 2 > 0)
-		--c;
-	else
-		c -= 2;
+	if (!(x > -2147483647.0 && x < 2147483647.0)) // NAN too
+		return 0.0;
 
-	// start with the integer part
-	t = i;
-	do
-	{
-		// car i
-		p10 = p_10(c);
-		d = (long)(t / p10);
-		t -= d * p10;
-		
-		// append to balance
-		b *= 100;
-		b += d;
-		
-		s = ir * 20; // side note 
-		
-		for (j = 0; j < 10; j++)
-		{
-			if ((s + j) * j > b)
-				break;
-		}
-		
-		if (j > 0)
-			--j;
-		
-		// add to the integer result
-		ir *= 10;
-		ir += j;
-		
-		b -= (s + j) * j; // balance to push forward
-		
-		c -= 2;
-	}
-	while (c >= 0);
-	
-	// continue with the fraction part
-	for (k = 0; k < 8; k++)
-	{
-		f *= 100;
-		d = (long)f;
-		f -= d;
-		
-		// append to balance
-		b *= 100;
-		b += d;
-		
-		s = ir * 20; // side note 
-		
-		for (j = 0; j < 10; j++)
-		{
-			if ((s + j) * j > b)
-				break;
-		}
-		
-		if (j > 0)
-			--j;
-		
-		// add to the integer result
-		ir *= 10;
-		ir += j;
-		
-		b -= (s + j) * j; // balance to push forward
-	}
-	
-	return (double)ir / p_10(8);
+	return (double)(long)(x < 0.0 ? x - 0.5 : x + 0.5);
 }
 
-//---------------------- Degree-based trignometry routines -----------------------
+// sin(*r*) for |r| <= pi/4.
+static double kSin(double r)
+{
+	double z = r * r;
 
-short p_reduce(double *x)
+#if PT_TRIG_TIER >= 3
+	// minimax of fdlibm __kernel_sin, error below 2^-58
+	return r + r * z * (-1.66666666666666324348e-01 + z * (8.33333333332248946124e-03
+		+ z * (-1.98412698298579493134e-04 + z * (2.75573137070700676789e-06
+		+ z * (-2.50507602534068634195e-08 + z * 1.58969099521155010221e-10)))));
+#elif PT_TRIG_TIER == 2
+	// Taylor to r^9, error below 2e-9
+	return r + r * z * (-1.0 / 6.0 + z * (1.0 / 120.0 + z * (-1.0 / 5040.0 + z * (1.0 / 362880.0))));
+#else
+	// Taylor to r^5, error below 4e-5
+	return r + r * z * (-1.0 / 6.0 + z * (1.0 / 120.0));
+#endif
+}
+
+// cos(*r*) for |r| <= pi/4.
+static double kCos(double r)
 {
-	short q = 0;
-	
-	while (*x > P_2PI)
-		*x -= P_2PI;
-		
-	if (*x > P_hPI && *x <= P_PI)
-	{
-		*x -= P_hPI;
-		*x = P_hPI - *x;
-		q = 1;
-	}
-	else if (*x > P_PI && *x <= P_3hPI)
-	{
-		*x -= P_PI;
-		q = 2;
-	}
-	else if (*x > P_3hPI)
+	double z = r * r;
+
+#if PT_TRIG_TIER >= 3
+	// minimax of fdlibm __kernel_cos, error below 2^-58
+	return 1.0 - 0.5 * z + z * z * (4.16666666666666019037e-02 + z * (-1.38888888888741095749e-03
+		+ z * (2.48015872894767294178e-05 + z * (-2.75573143513906633035e-07
+		+ z * (2.08757232129817482790e-09 + z * -1.13596475577881948265e-11)))));
+#elif PT_TRIG_TIER == 2
+	// Taylor to r^10, error below 2e-10
+	return 1.0 - 0.5 * z + z * z * (1.0 / 24.0 + z * (-1.0 / 720.0 + z * (1.0 / 40320.0 + z * (-1.0 / 3628800.0))));
+#else
+	// Taylor to r^6, error below 4e-6
+	return 1.0 - 0.5 * z + z * z * (1.0 / 24.0 + z * (-1.0 / 720.0));
+#endif
+}
+
+// sin(r + q * pi/2) from the kernels.
+static double quadSin(double r, long q)
+{
+	switch (q & 3)
 	{
-		*x -= P_3hPI;
-		*x = P_hPI - *x;
-		q = 3;
+		case 0: return kSin(r);
+		case 1: return kCos(r);
+		case 2: return -kSin(r);
 	}
-	
-	return q;
+
+	return -kCos(r);
 }
 
-// The trignometry algorithms are based on the Taylor Series
-// https://en.wikipedia.org/wiki/Taylor_series
-// Shorter series improves speed but reduces accuracy.
+// Reduce *x* radians to [-pi/4, pi/4] and return the quarter turns taken.
+// Exact to the last bits for |x| < 2^20 * pi/2.
+static long reduceRad(double *x)
+{
+	double k = nearest(*x * INVPIO2);
+
+	*x = ((*x - k * PIO2_1) - k * PIO2_2) - k * PIO2_2T;
 
-double p_sin(double x)
+	return (long)k;
+}
+
+// Reduce *d* degrees to [-45, 45] and return the quarter turns taken.
+// The subtraction is exact as 90 is, so there is no error at all.
+static long reduceDeg(double *d)
 {
-	double rst, p;
-	short q, minus = 0;
+	double k = nearest(*d / 90.0);
 
-	q = p_reduce(&x);
-	
-	if (q >= 2)
-		minus = 1;
-	
-	rst = x; // x
-	p = x;
-	p *= x;
-	p *= x;
-	rst -= (p / 6.0); // - (x^3 / 3!)
-	p *= x;
-	p *= x;
-	rst += (p / 120.0); // + (x^5 / 5!)
-	p *= x;
-	p *= x;
-	rst -= (p / 5040.0); // - (x^7 / 7!)
-	p *= x;
-	p *= x;
-	rst += (p / 362880.0); // + (x^9 / 9!)
-	p *= x;
-	p *= x;
-	rst -= (p / 39916800.0); // - (x^11 / 11!)
-	p *= x;
-	p *= x;
-	rst += (p / 6227020800.0); // + (x^13 / 13!)
-	p *= x;
-	p *= x;
-	rst -= (p / 1307674368000.0); // - (x^15 / 15!)
+	*d -= k * 90.0;
 
-	return minus ? -rst : rst;
+	return (long)k;
 }
 
-double p_cos(double x)
+double p_sin(double x)
 {
-	double rst, p;
-	short q, minus = 0;
+	long q = reduceRad(&x);
 
-	q = p_reduce(&x);
-	
-	if (q == 1 || q == 2)
-		minus = 1;
-	
-	rst = 1.0; // 1
-	p = x;
-	p *= x;
-	rst -= (p / 2.0); // - (x^2 / 2!)
-	p *= x;
-	p *= x;
-	rst += (p / 24.0); // + (x^4 / 4!)
-	p *= x;
-	p *= x;
-	rst -= (p / 720.0); // - (x^8 / 8!)
-	p *= x;
-	p *= x;
-	rst += (p / 40320.0); // + (x^10 / 10!)
-	p *= x;
-	p *= x;
-	rst -= (p / 3628800.0); // - (x^12 / 12!)	
-	p *= x;
-	p *= x;
-	rst += (p / 87178291200.0); // + (x^14 / 14!)
-	p *= x;
-	p *= x;
-	rst -= (p / 20922789888000.0); // - (x^16 / 16!)
-	p *= x;
-	p *= x;
-	rst += (p / 6402373705728000.0); // + (x^18 / 18!)
-	p *= x;
-	p *= x;
-	rst -= (p / 2432902008176640000.0); // - (x^20 / 20!)
+	return quadSin(x, q);
+}
 
-	return minus ? -rst : rst;
+double p_cos(double x)
+{
+	long q = reduceRad(&x);
+
+	return quadSin(x, q + 1);
 }
 
 double p_tan(double x)
 {
-	return p_sin(x) / p_cos(x);
+	long q = reduceRad(&x);
+
+	return quadSin(x, q) / quadSin(x, q + 1);
+}
+
+// The inverse sine and cosine take the rational minimax approximation
+// of fdlibm, asin(x) = x + x * R(x^2), on [-0.5, 0.5]. Closer to 1, where
+// a series in x converges too slowly, they use
+// asin(x) = pi/2 - 2 * asin(sqrt((1 - x) / 2)) on the argument of R below
+// 0.25. Error is a few ulps over the whole domain, and NAN outside [-1, 1].
+
+#define PIO2_HI 1.57079632679489655800e+00 // 0x3FF921FB, 0x54442D18
+#define PIO2_LO 6.12323399573676603587e-17 // 0x3C91A626, 0x33145C07
+
+// R(z) of asin(x) = x + x * R(x^2), for z in [0, 0.25].
+static double asinR(double z)
+{
+	double p, q;
+
+	p = z * (1.66666666666666657415e-01 + z * (-3.25565818622400915405e-01
+		+ z * (2.01212532134862925881e-01 + z * (-4.00555345006794114027e-02
+		+ z * (7.91534994289814532176e-04 + z * 3.47933107596021167570e-05)))));
+	q = 1.0 + z * (-2.40339491173441421878e+00 + z * (2.02094576023350569471e+00
+		+ z * (-6.88283971605453293030e-01 + z * 7.70381505559019352791e-02)));
+
+	return p / q;
 }
 
 double p_asin(double x)
 {
-	double rst, p;
-	
-	rst = x; // x
-	p = x;
-	p *= x;
-	p *= x;
-	rst += (p / 6.0); // + (x^3 / 6)
-	p *= x;
-	p *= x;
-	rst += (3.0 * p / 40.0); // + (3x^5 / 40)
-	p *= x;
-	p *= x;
-	rst += (5.0 * p / 112.0); // + (5x^7 / 112)
-	p *= x;
-	p *= x;
-	rst += (35.0 * p / 1152.0); // + (35x^9 / 1152)
+	double a = p_abs(x), s, t;
 
-	return rst;
+	if (!(a <= 1.0)) // NAN too
+		return p_nan();
+
+	if (a < 0.5)
+		return x + x * asinR(x * x);
+
+	t = 0.5 * (1.0 - a);
+	s = p_sqrt(t);
+	t = PIO2_HI - (2.0 * (s + s * asinR(t)) - PIO2_LO);
+
+	return x < 0.0 ? -t : t;
 }
 
 double p_acos(double x)
 {
-	return P_hPI - p_asin(x);
+	double a = p_abs(x), s, t;
+
+	if (!(a <= 1.0)) // NAN too
+		return p_nan();
+
+	if (a <= 0.5)
+		return PIO2_HI - (x - (PIO2_LO - x * asinR(x * x)));
+
+	t = 0.5 * (1.0 - a);
+	s = p_sqrt(t);
+	s += s * asinR(t);
+
+	return x < 0.0 ? 2.0 * (PIO2_HI - s) + 2.0 * PIO2_LO : 2.0 * s;
 }
 /*
 double p_atan(double x)
@@ -348,17 +311,25 @@ double dm_rtd(double r)
 
 double dm_sin(double d)
 {
-	return p_sin(dm_dtr(d));
+	long q = reduceDeg(&d);
+
+	return quadSin(d * DTR, q);
 }
 
 double dm_cos(double d)
 {
-	return p_cos(dm_dtr(d));
+	long q = reduceDeg(&d);
+
+	return quadSin(d * DTR, q + 1);
 }
 
 double dm_tan(double d)
 {
-	return p_tan(dm_dtr(d));
+	long q = reduceDeg(&d);
+
+	d *= DTR;
+
+	return quadSin(d, q) / quadSin(d, q + 1);
 }
 
 double dm_arcsin(double d)
@@ -433,6 +404,110 @@ void sunPosition(double jd, double *decl, double *eqt)
 		*eqt += 24.0;
 }
 
+#ifndef PT_NO_SUN_MODELS
+// Same as sunPosition() with the NOAA solar calculator series, which
+// adds the second order terms of the anomaly and the nutation of the
+// longitude and the obliquity.
+// Ref: Jean Meeus, Astronomical Algorithms, ch. 25 and 28
+// Ref: https://gml.noaa.gov/grad/solcalc/calcdetails.html
+void sunPositionNoaa(double jd, double *decl, double *eqt)
+{
+	double T, L0, M, ecc, C, omega, L, e, y, sM, s2M, E;
+
+	T = (jd - 2451545.0) / 36525.0; // Julian centuries since j2000.0
+
+	L0 = dm_fixAngle(280.46646 + T * (36000.76983 + T * 0.0003032)); // the mean longitude of the Sun
+	M = dm_fixAngle(357.52911 + T * (35999.05029 - T * 0.0001537)); // the mean anomaly of the Sun
+	ecc = 0.016708634 - T * (0.000042037 + T * 0.0000001267); // the eccentricity of the Earth's orbit
+	sM = dm_sin(M);
+	s2M = dm_sin(2.0 * M);
+	C = sM * (1.914602 - T * (0.004817 + T * 0.000014))
+		+ s2M * (0.019993 - T * 0.000101)
+		+ dm_sin(3.0 * M) * 0.000289; // the equation of the center
+
+	omega = 125.04 - 1934.136 * T; // the longitude of the ascending node of the Moon
+	L = L0 + C - 0.00569 - 0.00478 * dm_sin(omega); // the apparent longitude of the Sun
+	e = 23.0 + (26.0 + (21.448 - T * (46.815 + T * (0.00059 - T * 0.001813))) / 60.0) / 60.0
+		+ 0.00256 * dm_cos(omega); // the apparent obliquity of the ecliptic
+
+	*decl = dm_arcsin(dm_sin(e) * dm_sin(L));
+
+	y = dm_tan(e / 2.0);
+	y *= y;
+	E = y * dm_sin(2.0 * L0) - 2.0 * ecc * sM + 4.0 * ecc * y * sM * dm_cos(2.0 * L0)
+		- 0.5 * y * y * dm_sin(4.0 * L0) - 1.25 * ecc * ecc * s2M; // in radians
+	*eqt = dm_rtd(E) / 15.0;
+}
+
+// Same as sunPosition() with Spencer's Fourier series of the year angle.
+// Multiples of the angle come from one sine and cosine, so it costs a
+// fraction of the others for tiny targets.
+// Ref: J. W. Spencer, Fourier series representation of the position of
+// the Sun, Search 2(5), 1971
+void sunPositionLite(double jd, double *decl, double *eqt)
+{
+	double g, c1, s1, c2, s2, c3, s3;
+
+	// the year angle, from the start of 1 January 2000
+	g = P_2PI / 365.2422 * dm_fix(jd - 2451544.5, 365.2422);
+
+	c1 = p_cos(g);
+	s1 = p_sin(g);
+	c2 = c1 * c1 - s1 * s1;
+	s2 = 2.0 * s1 * c1;
+	c3 = c1 * c2 - s1 * s2;
+	s3 = s1 * c2 + c1 * s2;
+
+	*decl = dm_rtd(0.006918 - 0.399912 * c1 + 0.070257 * s1 - 0.006758 * c2
+		+ 0.000907 * s2 - 0.002697 * c3 + 0.00148 * s3);
+	*eqt = 229.18 / 60.0 * (0.000075 + 0.001868 * c1 - 0.032077 * s1
+		- 0.014615 * c2 - 0.040849 * s2);
+}
+
+static const pt_sun_model sun_models[PT_SUN_MODELS] PT_ROM =
+{
+	sunPosition, // PT_SUN_USNO
+	sunPositionNoaa, // PT_SUN_NOAA
+	sunPositionLite // PT_SUN_LITE
+};
+#endif
+
+// Return the function of the Sun position *model*, PT_SUN_x, or the
+// default one for an unknown model or one not built.
+pt_sun_model ptSunModel(short model)
+{
+#ifndef PT_NO_SUN_MODELS
+	if (model >= 0 && model < PT_SUN_MODELS)
+		return sun_models[model];
+#endif
+
+	return sunPosition;
+}
+
+// Compute the positions of the Sun for every prayer time of the date at
+// Julian date *jd* with *model*. Prayer times at the same time of the
+// day share one.
+void ptSunInit(struct _ptsun *sun, double jd, pt_sun_model model)
+{
+	sun->jd = jd;
+	sun->model = model;
+
+	model(jd + DAYTIME_FAJR, &(sun->decl[PT_FAJR]), &(sun->eqt[PT_FAJR]));
+	model(jd + DAYTIME_SUNRISE, &(sun->decl[PT_SUNRISE]), &(sun->eqt[PT_SUNRISE]));
+	model(jd + DAYTIME_DHUHR, &(sun->decl[PT_DHUHR]), &(sun->eqt[PT_DHUHR]));
+	model(jd + DAYTIME_ASR, &(sun->decl[PT_ASR]), &(sun->eqt[PT_ASR]));
+	model(jd + DAYTIME_SUNSET, &(sun->decl[PT_SUNSET]), &(sun->eqt[PT_SUNSET]));
+
+	sun->decl[PT_IMSAK] = sun->decl[PT_FAJR]; // DAYTIME_IMSAK
+	sun->eqt[PT_IMSAK] = sun->eqt[PT_FAJR];
+	sun->decl[PT_MAGHRIB] = sun->decl[PT_SUNSET]; // DAYTIME_MAGHRIB
+	sun->eqt[PT_MAGHRIB] = sun->eqt[PT_SUNSET];
+	sun->decl[PT_ISHA] = sun->decl[PT_SUNSET]; // DAYTIME_ISHA
+	sun->eqt[PT_ISHA] = sun->eqt[PT_SUNSET];
+	sun->decl[PT_MIDNIGHT] = 0.0;
+	sun->eqt[PT_MIDNIGHT] = 0.0;
+}
+
 // Compute the time different against mid-day at a *lat*itude position when
 // the Sun is at an *angle* below the horizon and at a specific *decl*ination
 // angle of the year.
@@ -481,15 +556,21 @@ double asrTime(double sun_decl, double sun_eqt, float lat, float shadow_factor)
 }
 
 // Sun angle adjustment for sunset/sunrise
-// *elv* in meters.
+// *elv* in meters, below sea level taken as at sea level.
 double horizonAdj(float elv)
 {
-	double elv_angle = 0.0347 * p_sqrt(elv); // an approximation of elevation angle
+	double elv_angle = elv > 0.0 ? 0.0347 * p_sqrt(elv) : 0.0; // an approximation of elevation angle
 	return 0.833 + elv_angle; // actual sunrise or sunset adjusted to the refraction of light
 }
 
 //---------------------- Higher latitudes -----------------------
 
+// Bit *bit* when highLatTime() moved time *t* to *h*, otherwise 0.
+static short highLatBit(double t, double h, short bit)
+{
+	return t == h || (t != t && h != h) ? 0 : bit;
+}
+
 // Adjust a time for higher latitudes 
 double highLatTime(struct _ptimes *pt, double t, double base, float angle, double night, short clock_dir)
 {
@@ -508,7 +589,7 @@ double highLatTime(struct _ptimes *pt, double t, double base, float angle, doubl
 	
 	td = clock_dir == DIR_COUNTER_CLOCKWISE ? dm_fixHour(base - t) : dm_fixHour(t - base);
 	
-	if (t == p_nan() || td > p)
+	if (t != t || td > p) // no time, or too far in the night
 		t = base + (clock_dir == DIR_COUNTER_CLOCKWISE ? -p : p);
 	
 	return t;
@@ -536,11 +617,55 @@ double julian(short year, short month, short day)
 	return C + D + (double)day + B - 1524.5;
 }
 
-// Convert decimal time to h:m:s.
+// Convert Julian day to Gregorian date
+// Ref: Astronomical Algorithms by Jean Meeus
+void gregorian(double jd, short *year, short *month, short *day)
+{
+	double A, B, C, D, E, F, Z, alpha;
+
+	jd += 0.5;
+	Z = p_floor(jd);
+	F = jd - Z;
+	alpha = p_floor((Z - 1867216.25) / 36524.25);
+	A = Z + 1.0 + alpha - p_floor(alpha / 4.0);
+	B = A + 1524.0;
+	C = p_floor((B - 122.1) / 365.25);
+	D = p_floor(365.25 * C);
+	E = p_floor((B - D) / 30.6001);
+
+	*day = (short)(B - D - p_floor(30.6001 * E) + F);
+	*month = (short)(E < 14.0 ? E - 1.0 : E - 13.0);
+	*year = (short)(*month > 2 ? C - 4716.0 : C - 4715.0);
+}
+
+// Convert a local time *t* in hours on the date of *pt* to seconds
+// since 1970-01-01 UTC, rounded to the nearest second as t2hms() does.
+// Times past 24 or below 0 fall on the next or previous day.
+double ptUnixTime(struct _ptimes *pt, double t)
+{
+	return p_floor((pt->jd - 2440587.5) * 86400.0 + (t - pt->tz) * 3600.0 + 0.5);
+}
+
+// ptUnixTime() of time *field* of *pt* as an integer, PT_NO_TIME when the
+// time does not occur.
+int64_t ptUnixSeconds(struct _ptimes *pt, short field)
+{
+	double u = ptUnixTime(pt, ptTime(pt, field));
+
+	return u > -PT_UNIX_MAX && u < PT_UNIX_MAX ? (int64_t)u : PT_NO_TIME; // false for NAN
+}
+
+// Convert decimal time to h:m:s, all -1 for no time (NAN).
 void t2hms(double t, short *h, short *m, short *s)
 {
-	while(t >= 24.0)
-		t -= 24.0;
+	if (t - t != 0.0) // NAN, or infinite
+	{
+		*h = *m = *s = -1;
+		return;
+	}
+
+	if (t < 0.0 || t >= 24.0)
+		t = dm_fixHour(t);
 		
 	*h = (short)t;
 	t -= *h;
@@ -568,6 +693,19 @@ void t2hms(double t, short *h, short *m, short *s)
 	}	
 }
 
+// Set the position of the Sun for prayer time *field* at *daytime* of
+// the date, from the shared table when there is one for the date.
+void ptSunPosition(struct _ptimes *pt, short field, double daytime)
+{
+	if (pt->sun != 0 && pt->sun->jd == pt->jd && pt->sun->model == pt->sun_model)
+	{
+		pt->decl = pt->sun->decl[field];
+		pt->eqt = pt->sun->eqt[field];
+	}
+	else
+		pt->sun_model(pt->jd + daytime, &(pt->decl), &(pt->eqt));
+}
+
 void ptInit(struct _ptimes *pt)
 {
 	pt->imsak_rel_d = 0.0;
@@ -586,13 +724,15 @@ void ptInit(struct _ptimes *pt)
 	pt->isha_rel_m = 0.0;
 	pt->midnight_type = MIDNIGHT_STANDARD;
 
-	pt->elv = 0.0;
+	ptSetElevation(pt, 0.0);
 	pt->tz = 0.0;
 
+	pt->sun = 0;
+	pt->sun_model = sunPosition;
 	pt->phase = 0;
+	pt->high_lat_adj = 0;
 	pt->decl = 0.0;
 	pt->eqt = 0.0;
-	pt->horz_adj = 0.0;
 	pt->night = 0.0;
 }
 
@@ -600,10 +740,25 @@ void ptSetLocation(struct _ptimes *pt, float lat, float lng, float elv, float tz
 {
 	pt->lat = lat;
 	pt->lng = lng;
-	pt->elv = elv;
+	ptSetElevation(pt, elv);
 	pt->tz = tz;
 }
 
+// Set the elevation of *pt* in meters with its horizon adjustment, which
+// the copies of *pt* for other dates then keep.
+void ptSetElevation(struct _ptimes *pt, float elv)
+{
+	pt->elv = elv;
+	pt->horz_elv = elv;
+	pt->horz_adj = horizonAdj(elv);
+}
+
+// Set the Sun position *model*, PT_SUN_x.
+void ptSetSunModel(struct _ptimes *pt, short model)
+{
+	pt->sun_model = ptSunModel(model);
+}
+
 void ptSetDate(struct _ptimes *pt, short year, short month, short day)
 {
 	pt->year = year;
@@ -621,16 +776,24 @@ short ptCalc(struct _ptimes *pt)
 {
 	double td;
 
+#ifdef PT_WCET
+	if (pt->phase < 0 || pt->phase > 28)
+		pt->phase = 0;
+#endif
+
 	switch (pt->phase)
 	{
 		case 0:
 		
-			pt->horz_adj = horizonAdj(pt->elv);
+			if (pt->horz_elv != pt->elv) // elv set by hand
+				ptSetElevation(pt, pt->elv);
+
+			pt->high_lat_adj = 0;
 			break;
 			
 		case 1:
 			
-			sunPosition(pt->jd + DAYTIME_SUNRISE, &(pt->decl), &(pt->eqt));
+			ptSunPosition(pt, PT_SUNRISE, DAYTIME_SUNRISE);
 			break;
 
 		case 2:
@@ -640,7 +803,7 @@ short ptCalc(struct _ptimes *pt)
 
 		case 3:
 		
-			sunPosition(pt->jd + DAYTIME_SUNSET, &(pt->decl), &(pt->eqt));
+			ptSunPosition(pt, PT_SUNSET, DAYTIME_SUNSET);
 			break;
 
 		case 4:
@@ -655,13 +818,13 @@ short ptCalc(struct _ptimes *pt)
 		
 		case 6:
 		
-			sunPosition(pt->jd + DAYTIME_FAJR, &(pt->decl), &(pt->eqt));
+			ptSunPosition(pt, PT_FAJR, DAYTIME_FAJR);
 			break;
 		
 		case 7:
 		
 			if (pt->fajr_rel_d != 0.0)
-				sunPosition(pt->jd + DAYTIME_FAJR, &(pt->decl), &(pt->eqt));
+				ptSunPosition(pt, PT_FAJR, DAYTIME_FAJR);
 		
 			break;
 		
@@ -682,7 +845,7 @@ short ptCalc(struct _ptimes *pt)
 		case 10:
 		
 			if (pt->imsak_rel_d != 0.0)
-				sunPosition(pt->jd + DAYTIME_IMSAK, &(pt->decl), &(pt->eqt));
+				ptSunPosition(pt, PT_IMSAK, DAYTIME_IMSAK);
 		
 			break;
 		
@@ -702,7 +865,7 @@ short ptCalc(struct _ptimes *pt)
 		
 		case 13:
 		
-			sunPosition(pt->jd + DAYTIME_DHUHR, &(pt->decl), &(pt->eqt));
+			ptSunPosition(pt, PT_DHUHR, DAYTIME_DHUHR);
 			break;
 
 		case 14:
@@ -713,7 +876,7 @@ short ptCalc(struct _ptimes *pt)
 		
 		case 15:
 		
-			sunPosition(pt->jd + DAYTIME_ASR, &(pt->decl), &(pt->eqt));
+			ptSunPosition(pt, PT_ASR, DAYTIME_ASR);
 			break;
 
 		case 16:
@@ -725,7 +888,7 @@ short ptCalc(struct _ptimes *pt)
 		case 17:
 			
 			if (pt->maghrib_rel_d != 0.0)
-				sunPosition(pt->jd + DAYTIME_MAGHRIB, &(pt->decl), &(pt->eqt));
+				ptSunPosition(pt, PT_MAGHRIB, DAYTIME_MAGHRIB);
 
 			break;
 		
@@ -746,7 +909,7 @@ short ptCalc(struct _ptimes *pt)
 		case 20:
 			
 			if (pt->isha_rel_d != 0.0)
-				sunPosition(pt->jd + DAYTIME_ISHA, &(pt->decl), &(pt->eqt));
+				ptSunPosition(pt, PT_ISHA, DAYTIME_ISHA);
 
 			break;
 			
@@ -766,22 +929,30 @@ short ptCalc(struct _ptimes *pt)
 
 		case 23:
 
-			pt->imsak = highLatTime(pt, pt->imsak, pt->sunrise, 0.0, pt->night, DIR_COUNTER_CLOCKWISE);
+			td = highLatTime(pt, pt->imsak, pt->sunrise, 0.0, pt->night, DIR_COUNTER_CLOCKWISE);
+			pt->high_lat_adj |= highLatBit(pt->imsak, td, PT_HL_IMSAK);
+			pt->imsak = td;
 			break;
 
 		case 24:
 		
-			pt->fajr = highLatTime(pt, pt->fajr, pt->sunrise, pt->fajr_rel_d, pt->night, DIR_COUNTER_CLOCKWISE);
+			td = highLatTime(pt, pt->fajr, pt->sunrise, pt->fajr_rel_d, pt->night, DIR_COUNTER_CLOCKWISE);
+			pt->high_lat_adj |= highLatBit(pt->fajr, td, PT_HL_FAJR);
+			pt->fajr = td;
 			break;
 		
 		case 25:
 			
-			pt->maghrib = highLatTime(pt, pt->maghrib, pt->sunset, pt->maghrib_rel_d, pt->night, DIR_CLOCKWISE);
+			td = highLatTime(pt, pt->maghrib, pt->sunset, pt->maghrib_rel_d, pt->night, DIR_CLOCKWISE);
+			pt->high_lat_adj |= highLatBit(pt->maghrib, td, PT_HL_MAGHRIB);
+			pt->maghrib = td;
 			break;
 			
 		case 26:
 			
-			pt->isha = highLatTime(pt, pt->isha, pt->sunset, pt->isha_rel_d, pt->night, DIR_CLOCKWISE);
+			td = highLatTime(pt, pt->isha, pt->sunset, pt->isha_rel_d, pt->night, DIR_CLOCKWISE);
+			pt->high_lat_adj |= highLatBit(pt->isha, td, PT_HL_ISHA);
+			pt->isha = td;
 			break;
 			
 		case 27:
@@ -817,3 +988,21 @@ short ptCalc(struct _ptimes *pt)
 	return pt->phase;
 }
 
+// Get the calculated time of a prayer time *field*, i.e. PT_FAJR.
+double ptTime(struct _ptimes *pt, short field)
+{
+	switch (field)
+	{
+		case PT_IMSAK: return pt->imsak;
+		case PT_FAJR: return pt->fajr;
+		case PT_SUNRISE: return pt->sunrise;
+		case PT_DHUHR: return pt->dhuhr;
+		case PT_ASR: return pt->asr;
+		case PT_SUNSET: return pt->sunset;
+		case PT_MAGHRIB: return pt->maghrib;
+		case PT_ISHA: return pt->isha;
+		case PT_MIDNIGHT: return pt->midnight;
+	}
+
+	return p_nan();
+}
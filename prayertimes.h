@@ -3,6 +3,8 @@
 #ifndef __PRAYERTIMES_H__
 #define __PRAYERTIMES_H__
 
+#include <stdint.h>
+
 #define ASR_STANDARD 1.0		// Shafi`i, Maliki, Ja`fari, Hanbali
 #define ASR_HANAFI 2.0			// Hanafi
 
@@ -14,6 +16,12 @@
 #define HIGHLAT_ANGLE_BASED 2	// Angle/60th of night
 #define HIGHLAT_ONE_SEVEN 3		// 1/7th of night
 
+// Times moved by the high latitude adjustment, bits of high_lat_adj
+#define PT_HL_IMSAK 1
+#define PT_HL_FAJR 2
+#define PT_HL_MAGHRIB 4
+#define PT_HL_ISHA 8
+
 #define DIR_CLOCKWISE 0
 #define DIR_COUNTER_CLOCKWISE 1
 
@@ -29,12 +37,95 @@
 #define DAYTIME_MAGHRIB 0.750000 // 18:00h
 #define DAYTIME_ISHA 	0.750000 // 18:00h
 
+// Precision of sin() and cos(), by the degree of their polynomials:
+//  1 error below 4e-5, times off by up to 11 seconds at 65N/S
+//  2 error below 2e-9, times off by 0.02 seconds
+//  3 full double precision, the default
+// The errors of the times are those allowed by ptref.budget, where the
+// cost of each tier is measured too, see ptref.c.
+#ifndef PT_TRIG_TIER
+#define PT_TRIG_TIER 3
+#endif
+
+// Define PT_WCET for a bounded time of every ptCalc() phase on any input.
+// The math has no loops in any build, so a phase costs a fixed maximum of
+// operations. A NAN or huge argument to the trigonometry is guarded in
+// every build; PT_WCET adds the guard against a phase out of range.
+// ptwcet measures the worst case cycles of every phase, see "make wcet".
+
+// Models of the position of the Sun, from the most accurate:
+//  PT_SUN_NOAA  NOAA series with nutation, see sunPositionNoaa()
+//  PT_SUN_USNO  USNO approximation, the default, see sunPosition()
+//  PT_SUN_LITE  Spencer's Fourier series, see sunPositionLite()
+// Largest errors against the NOAA series in long double over 1950-2050,
+// and cost per evaluation of the default build on x86-64 (ptmath f sun):
+//  model  declination  equation of time  ns   sin/cos/tan/asin/atan2
+//  NOAA   1e-8"        2e-10 s           300  12
+//  USNO   14"          3.4 s             300  8
+//  LITE   158"         40 s              70   2
+// Every second of the equation of time is a second of every prayer time.
+#define PT_SUN_USNO 0
+#define PT_SUN_NOAA 1
+#define PT_SUN_LITE 2
+#define PT_SUN_MODELS 3
+
+typedef void (*pt_sun_model)(double jd, double *decl, double *eqt);
+
+// Footprint of the library, see "make size":
+//  PT_ROM            storage of the constant tables, i.e. the flash section
+//                    attribute of the target, empty by default
+//  PT_NO_SUN_MODELS  only the USNO model of the Sun
+//  PT_SMALL_ATAN     arctangent from p_asin() and p_sqrt(), leaving out the
+//                    tables of atan.c for a few ulps more error
+//  PT_METHOD_MASK    bits of the METHOD_x of ptmethod.h compiled in
+// PT_MINIMAL is the smallest profile, with PT_NO_SUN_MODELS and PT_SMALL_ATAN.
+#ifdef PT_MINIMAL
+#ifndef PT_NO_SUN_MODELS
+#define PT_NO_SUN_MODELS
+#endif
+#ifndef PT_SMALL_ATAN
+#define PT_SMALL_ATAN
+#endif
+#endif
+
+#ifndef PT_ROM
+#define PT_ROM
+#endif
+
+// Prayer time fields in the order they are kept in struct _ptimes.
+#define PT_IMSAK 0
+#define PT_FAJR 1
+#define PT_SUNRISE 2
+#define PT_DHUHR 3
+#define PT_ASR 4
+#define PT_SUNSET 5
+#define PT_MAGHRIB 6
+#define PT_ISHA 7
+#define PT_MIDNIGHT 8
+#define PT_FIELDS 9
+
+// Unix time of a prayer time that does not occur, or of one more than
+// PT_UNIX_MAX seconds, 71 million years, away from 1970, see ptUnixSeconds()
+#define PT_NO_TIME INT64_MIN
+#define PT_UNIX_MAX 0x1p51
+
 // pi
 #define P_hPI  1.570796326794896
 #define P_PI   3.141592653589793
 #define P_3hPI 4.71238898038469
 #define P_2PI  6.283185307179586
 
+// Position of the Sun at the time of day of every prayer time field for
+// a date. Shared by all locations calculated for the same date.
+struct _ptsun
+{
+	double jd; // Julian date of the table
+	pt_sun_model model; // model of the table
+	double decl[PT_FIELDS];
+	double eqt[PT_FIELDS];
+};
+
+// Fields are in order of their size, so there is no padding between them.
 struct _ptimes
 {
 	double imsak;
@@ -46,7 +137,18 @@ struct _ptimes
 	double maghrib;
 	double isha;
 	double midnight;
-	
+	double jd; // Julian date
+
+	// run time variables
+	double decl;
+	double eqt;
+	double horz_adj;
+	double night;
+
+	// shared positions of the Sun for the date, optional
+	struct _ptsun *sun;
+	pt_sun_model sun_model;
+
 	// settings
 	//  x_rel_d : relative in degrees
 	//  x_rel_m : relative in minutes
@@ -61,25 +163,21 @@ struct _ptimes
 	float maghrib_rel_m;
 	float isha_rel_d;
 	float isha_rel_m;
-	short midnight_type;
-	short high_lats;
 
 	// location and time
 	float lat; // Latitude
 	float lng; // Longitude
 	float elv; // Elevation in meters
 	float tz;  // Time zone
+
+	float horz_elv; // elevation of horz_adj
+	short midnight_type;
+	short high_lats;
 	short year;
 	short month;
 	short day;
-	double jd; // Julian date
-	
-	// run time variables
 	short phase;
-	double decl;
-	double eqt;
-	double horz_adj;
-	double night;
+	short high_lat_adj; // PT_HL_x of the times highLatTime() moved
 };
 
 // Math
@@ -111,20 +209,31 @@ double dm_fixAngle(double a);
 double dm_fixHour(double a);
 
 void sunPosition(double jd, double *decl, double *eqt);
+void sunPositionNoaa(double jd, double *decl, double *eqt);
+void sunPositionLite(double jd, double *decl, double *eqt);
+pt_sun_model ptSunModel(short model);
+void ptSunInit(struct _ptsun *sun, double jd, pt_sun_model model);
 double _sunAngleTimeRel(float lat, float angle, double decl);
 double sunAngleTime(double sun_decl, double sun_eqt, float lat, float angle, short clock_dir);
 double asrTime(double sun_decl, double sun_eqt, float lat, float shadow_factor);
 double horizonAdj(float elv);
 double highLatTime(struct _ptimes *pt, double t, double base, float angle, double night, short clock_dir);
 double julian(short year, short month, short day);
+void gregorian(double jd, short *year, short *month, short *day);
 
-// Convert decimal time to h:m:s.
+// Convert decimal time to h:m:s, all -1 for no time (NAN).
 void t2hms(double t, short *h, short *m, short *s);
 
+void ptSunPosition(struct _ptimes *pt, short field, double daytime);
 void ptInit(struct _ptimes *pt);
 void ptSetLocation(struct _ptimes *pt, float lat, float lng, float elv, float tz);
+void ptSetElevation(struct _ptimes *pt, float elv);
+void ptSetSunModel(struct _ptimes *pt, short model);
 void ptSetDate(struct _ptimes *pt, short year, short month, short day);
 short ptCalc(struct _ptimes *pt);
+double ptTime(struct _ptimes *pt, short field);
+double ptUnixTime(struct _ptimes *pt, double t);
+int64_t ptUnixSeconds(struct _ptimes *pt, short field);
 
 #endif
 
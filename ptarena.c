@@ -0,0 +1,62 @@
+// ptarena.c
+// Arena allocator
+// Gives the result sets of a bulk run their memory from one allocation,
+// so that a run costs a single malloc() and a single free() whatever the
+// number of its locations and days.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include "ptarena.h"
+
+// Notes:
+// 1. A block is the next PTARENA_ALIGN aligned part of the arena. Threads
+//     of a pool take blocks at the same time with an atomic add, and one
+//     that goes past the end gets none.
+// 2. The pages of the arena are only made resident by the system as the
+//     blocks are written, so a generous size costs address space only.
+//
+
+static size_t alignUp(size_t n)
+{
+	return (n + PTARENA_ALIGN - 1) & ~(size_t)(PTARENA_ALIGN - 1);
+}
+
+// Start an arena of *size* bytes. Return 0 on success, -1 when out of memory.
+int ptArenaInit(struct _ptarena *a, size_t size)
+{
+	void *p;
+
+	a->size = alignUp(size > 0 ? size : 1);
+	a->used = 0;
+	a->base = posix_memalign(&p, PTARENA_ALIGN, a->size) == 0 ? p : 0;
+
+	return a->base == 0 ? -1 : 0;
+}
+
+// Return a block of *size* bytes, 0 when the arena is full.
+void *ptArenaAlloc(struct _ptarena *a, size_t size)
+{
+	size_t n = alignUp(size > 0 ? size : 1), at;
+
+	at = __atomic_fetch_add(&(a->used), n, __ATOMIC_RELAXED);
+
+	if (at > a->size || a->size - at < n)
+		return 0;
+
+	return a->base + at;
+}
+
+// Give back every block at once, keeping the memory for the next run.
+void ptArenaReset(struct _ptarena *a)
+{
+	__atomic_store_n(&(a->used), 0, __ATOMIC_RELAXED);
+}
+
+void ptArenaFree(struct _ptarena *a)
+{
+	free(a->base);
+	a->base = 0;
+	a->size = 0;
+	a->used = 0;
+}
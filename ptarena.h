@@ -0,0 +1,24 @@
+// ptarena.h
+
+#ifndef __PTARENA_H__
+#define __PTARENA_H__
+
+#include <stddef.h>
+
+#define PTARENA_ALIGN 64 // of every block, a cache line
+
+// Memory of a bulk run, taken in one allocation and given back at once.
+// Blocks are carved from it in order and never freed one by one.
+struct _ptarena
+{
+	char *base;
+	size_t size;
+	size_t used; // taken by threads with an atomic add
+};
+
+int ptArenaInit(struct _ptarena *a, size_t size);
+void *ptArenaAlloc(struct _ptarena *a, size_t size);
+void ptArenaReset(struct _ptarena *a);
+void ptArenaFree(struct _ptarena *a);
+
+#endif
@@ -0,0 +1,457 @@
+// ptarrow.c
+// Arrow IPC stream writer
+// Writes prayer times as columns in the Arrow IPC streaming format, so
+// analytics tools read them with no parsing and with the full precision
+// of the calculation.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ptarrow.h"
+
+// Notes:
+// 1. A stream is a Schema message, a RecordBatch message every *rows*
+//     rows, and the end of stream marker. A message is the continuation
+//     marker 0xFFFFFFFF, the 32-bit length of its metadata, the metadata
+//     as a flatbuffer padded to 8 bytes, and the body of the columns.
+// 2. The flatbuffers are written front to back by hand: a vtable, then
+//     its table, then the objects the table refers to, so every offset
+//     points forward as the format requires. Flatbuffer numbers are
+//     always little endian. The column data is in the host byte order,
+//     told by the endianness of the Schema.
+// 3. The columns are:
+//      date      Date32, days since 1970-01-01
+//      id        Int64
+//      imsak ... midnight
+//                Float64 local hours as calculated for PTARROW_HOURS, or
+//                Int32 seconds from local midnight for PTARROW_SECONDS,
+//                null when there is no time, i.e. at high latitudes.
+//
+
+#define ARROW_V5 4
+
+// Message header and field type unions of the Arrow format.
+#define ARROW_SCHEMA 1
+#define ARROW_RECORD_BATCH 3
+#define ARROW_INT 2
+#define ARROW_FLOAT 3
+#define ARROW_DATE 8
+
+#define ARROW_DOUBLE 2
+#define ARROW_DAY 0
+
+static const char *names[PTARROW_COLS] =
+{
+	"date", "id", "imsak", "fajr", "sunrise", "dhuhr", "asr",
+	"sunset", "maghrib", "isha", "midnight"
+};
+
+// Flatbuffer under construction.
+struct _fb
+{
+	uint8_t *b;
+	size_t len;
+};
+
+static void fbSet(struct _fb *fb, size_t at, uint64_t v, short n)
+{
+	short i;
+
+	for (i = 0; i < n; i++, v >>= 8)
+		fb->b[at + i] = (uint8_t)(v & 0xFF);
+}
+
+static void fbPut(struct _fb *fb, uint64_t v, short n)
+{
+	fbSet(fb, fb->len, v, n);
+	fb->len += n;
+}
+
+static void fbPad(struct _fb *fb, size_t align)
+{
+	while (fb->len % align != 0)
+		fb->b[fb->len++] = 0;
+}
+
+// Point the offset at *at* to the object at *to*.
+static void fbRef(struct _fb *fb, size_t at, size_t to)
+{
+	fbSet(fb, at, to - at, 4);
+}
+
+// Start a table of *nf* fields at the offsets *off* in the table, 0 for a
+// field left out, and of *size* bytes including its vtable offset. The
+// table is 8-byte aligned. Return its position.
+static size_t fbTable(struct _fb *fb, short nf, const uint16_t *off, uint16_t size)
+{
+	size_t vt, t;
+	short i;
+
+	fbPad(fb, 2);
+	vt = fb->len;
+	fbPut(fb, 4 + 2 * nf, 2);
+	fbPut(fb, size, 2);
+
+	for (i = 0; i < nf; i++)
+		fbPut(fb, off[i], 2);
+
+	fbPad(fb, 8);
+	t = fb->len;
+	fbPut(fb, t - vt, 4);
+	memset(fb->b + fb->len, 0, size - 4);
+	fb->len += size - 4;
+
+	return t;
+}
+
+// Start a vector of *n* elements of *size* bytes aligned to *align*.
+// Return its position, the one of its length.
+static size_t fbVector(struct _fb *fb, uint32_t n, size_t size, size_t align)
+{
+	size_t v;
+
+	fbPad(fb, 4);
+
+	while ((fb->len + 4) % align != 0)
+		fbPut(fb, 0, 4);
+
+	v = fb->len;
+	fbPut(fb, n, 4);
+	memset(fb->b + fb->len, 0, n * size);
+	fb->len += n * size;
+
+	return v;
+}
+
+static size_t fbString(struct _fb *fb, const char *s)
+{
+	size_t v, n = strlen(s);
+
+	fbPad(fb, 4);
+	v = fb->len;
+	fbPut(fb, n, 4);
+	memcpy(fb->b + fb->len, s, n + 1);
+	fb->len += n + 1;
+
+	return v;
+}
+
+// Start the metadata of a message of *type* with a body of *body* bytes.
+// Return the position of the Message table.
+static size_t message(struct _fb *fb, uint8_t type, int64_t body)
+{
+	static const uint16_t off[] = {16, 18, 4, 8}; // version, header type, header, bodyLength
+	size_t m;
+
+	fb->len = 0;
+	fbPut(fb, 0, 4); // root
+	m = fbTable(fb, 4, off, 24);
+	fbRef(fb, 0, m);
+	fbSet(fb, m + 16, ARROW_V5, 2);
+	fbSet(fb, m + 18, type, 1);
+	fbSet(fb, m + 8, (uint64_t)body, 8);
+
+	return m;
+}
+
+// Field table of column *c*.
+static size_t field(struct _fb *fb, struct _ptarrow *a, short c)
+{
+	static const uint16_t off[] = {4, 16, 17, 8, 0, 12}; // name, nullable, type type, type, -, children
+	static const uint16_t off_int[] = {4, 8}; // bitWidth, is_signed
+	static const uint16_t off_one[] = {4}; // precision or unit
+	size_t f, t;
+
+	f = fbTable(fb, 6, off, 20);
+	fbRef(fb, f + 4, fbString(fb, names[c]));
+
+	if (c == 0)
+	{
+		fbSet(fb, f + 17, ARROW_DATE, 1);
+		t = fbTable(fb, 1, off_one, 8);
+		fbSet(fb, t + 4, ARROW_DAY, 2);
+	}
+	else if (c == 1 || a->unit == PTARROW_SECONDS)
+	{
+		fbSet(fb, f + 16, c > 1, 1);
+		fbSet(fb, f + 17, ARROW_INT, 1);
+		t = fbTable(fb, 2, off_int, 12);
+		fbSet(fb, t + 4, c == 1 ? 64 : 32, 4);
+		fbSet(fb, t + 8, 1, 1);
+	}
+	else
+	{
+		fbSet(fb, f + 17, ARROW_FLOAT, 1);
+		t = fbTable(fb, 1, off_one, 8);
+		fbSet(fb, t + 4, ARROW_DOUBLE, 2);
+	}
+
+	fbRef(fb, f + 8, t);
+	fbRef(fb, f + 12, fbVector(fb, 0, 4, 4));
+
+	return f;
+}
+
+static int put(struct _ptarrow *a, const void *p, size_t n)
+{
+	const char *s = p;
+	ssize_t w;
+
+	while (n > 0 && !a->error)
+	{
+		w = write(a->fd, s, n);
+
+		if (w < 0 && errno == EINTR)
+			continue;
+
+		if (w <= 0)
+		{
+			a->error = 1;
+			break;
+		}
+
+		s += w;
+		n -= (size_t)w;
+	}
+
+	return a->error ? -1 : 0;
+}
+
+// Put *n* bytes of *p* padded with zeros to 8 bytes.
+static int putPadded(struct _ptarrow *a, const void *p, size_t n)
+{
+	static const char zeros[8] = {0};
+
+	put(a, p, n);
+	return put(a, zeros, (8 - n % 8) % 8);
+}
+
+// Put the message in *fb* with its length, padded to 8 bytes.
+static int putMessage(struct _ptarrow *a, struct _fb *fb)
+{
+	uint8_t h[8];
+	struct _fb hb;
+
+	fbPad(fb, 8);
+	hb.b = h;
+	hb.len = 0;
+	fbPut(&hb, 0xFFFFFFFF, 4);
+	fbPut(&hb, fb->len, 4);
+
+	put(a, h, 8);
+	return put(a, fb->b, fb->len);
+}
+
+static int schema(struct _ptarrow *a)
+{
+	static const uint16_t off[] = {8, 4}; // endianness, fields
+	const uint16_t one = 1;
+	struct _fb fb;
+	size_t m, s, v;
+	short c;
+
+	fb.b = a->meta;
+	m = message(&fb, ARROW_SCHEMA, 0);
+	s = fbTable(&fb, 2, off, 12);
+	fbRef(&fb, m + 4, s);
+	fbSet(&fb, s + 8, *(const uint8_t *)&one == 1 ? 0 : 1, 2); // little or big endian
+	v = fbVector(&fb, PTARROW_COLS, 4, 4);
+	fbRef(&fb, s + 4, v);
+
+	for (c = 0; c < PTARROW_COLS; c++)
+		fbRef(&fb, v + 4 + 4 * c, field(&fb, a, c));
+
+	return putMessage(a, &fb);
+}
+
+static size_t padded(size_t n)
+{
+	return (n + 7) & ~(size_t)7;
+}
+
+// Write the rows of the current batch as a record batch.
+int ptArrowFlush(struct _ptarrow *a)
+{
+	static const uint16_t off[] = {8, 4, 16}; // length, nodes, buffers
+	struct _fb fb;
+	size_t m, r, nodes, bufs, at, body = 0, len[2 * PTARROW_COLS];
+	long n = a->n, nulls;
+	short c, b;
+
+	if (n == 0)
+		return a->error ? -1 : 0;
+
+	// validity and data buffer lengths of each column
+	for (c = 0; c < PTARROW_COLS; c++)
+	{
+		nulls = c > 1 && a->unit == PTARROW_SECONDS ? a->nulls[c - 2] : 0;
+		len[2 * c] = nulls > 0 ? (size_t)(n + 7) / 8 : 0;
+		len[2 * c + 1] = (size_t)n * (c == 0 || (c > 1 && a->unit == PTARROW_SECONDS) ? 4 : 8);
+		body += padded(len[2 * c]) + padded(len[2 * c + 1]);
+	}
+
+	fb.b = a->meta;
+	m = message(&fb, ARROW_RECORD_BATCH, (int64_t)body);
+	r = fbTable(&fb, 3, off, 24);
+	fbRef(&fb, m + 4, r);
+	fbSet(&fb, r + 8, (uint64_t)n, 8);
+	nodes = fbVector(&fb, PTARROW_COLS, 16, 8);
+	fbRef(&fb, r + 4, nodes);
+
+	for (c = 0; c < PTARROW_COLS; c++)
+	{
+		nulls = c > 1 && a->unit == PTARROW_SECONDS ? a->nulls[c - 2] : 0;
+		fbSet(&fb, nodes + 4 + 16 * c, (uint64_t)n, 8);
+		fbSet(&fb, nodes + 12 + 16 * c, (uint64_t)nulls, 8);
+	}
+
+	bufs = fbVector(&fb, 2 * PTARROW_COLS, 16, 8);
+	fbRef(&fb, r + 16, bufs);
+
+	for (b = 0, at = 0; b < 2 * PTARROW_COLS; b++)
+	{
+		fbSet(&fb, bufs + 4 + 16 * b, at, 8);
+		fbSet(&fb, bufs + 12 + 16 * b, len[b], 8);
+		at += padded(len[b]);
+	}
+
+	putMessage(a, &fb);
+	putPadded(a, a->date, len[1]);
+	putPadded(a, a->id, len[3]);
+
+	for (c = 0; c < PT_FIELDS; c++)
+	{
+		if (a->unit == PTARROW_SECONDS)
+		{
+			putPadded(a, a->valid[c], len[2 * c + 4]);
+			putPadded(a, a->secs[c], len[2 * c + 5]);
+			memset(a->valid[c], 0, (size_t)(a->rows + 7) / 8);
+		}
+		else
+			putPadded(a, a->hours[c], len[2 * c + 5]);
+
+		a->nulls[c] = 0;
+	}
+
+	a->n = 0;
+
+	return a->error ? -1 : 0;
+}
+
+// Start an Arrow stream on *fd* with the prayer times in *unit*, written
+// every *rows* rows. Return 0 on success, -1 when out of memory.
+int ptArrowOpen(struct _ptarrow *a, int fd, short unit, long rows)
+{
+	short c;
+	int nomem;
+
+	a->fd = fd;
+	a->unit = unit;
+	a->rows = rows > 0 ? rows : 1;
+	a->n = 0;
+	a->error = 0;
+	a->date = malloc(sizeof(int32_t) * a->rows);
+	a->id = malloc(sizeof(int64_t) * a->rows);
+	nomem = a->date == 0 || a->id == 0;
+
+	for (c = 0; c < PT_FIELDS; c++)
+	{
+		a->hours[c] = 0;
+		a->secs[c] = 0;
+		a->valid[c] = 0;
+		a->nulls[c] = 0;
+
+		if (unit == PTARROW_SECONDS)
+		{
+			a->secs[c] = malloc(sizeof(int32_t) * a->rows);
+			a->valid[c] = calloc((size_t)(a->rows + 7) / 8, 1);
+			nomem |= a->secs[c] == 0 || a->valid[c] == 0;
+		}
+		else
+		{
+			a->hours[c] = malloc(sizeof(double) * a->rows);
+			nomem |= a->hours[c] == 0;
+		}
+	}
+
+	if (nomem)
+	{
+		a->error = 1;
+		return -1;
+	}
+
+	return schema(a);
+}
+
+// Add a row of the prayer times *t* in local hours, as of ptTime(), of
+// *days* since 1970-01-01 and location *id*.
+void ptArrowRow(struct _ptarrow *a, int32_t days, int64_t id, const double *t)
+{
+	long i = a->n;
+	double s;
+	short c;
+
+	a->date[i] = days;
+	a->id[i] = id;
+
+	for (c = 0; c < PT_FIELDS; c++)
+	{
+		if (a->unit == PTARROW_HOURS)
+			a->hours[c][i] = t[c];
+		else if (t[c] != t[c]) // NaN
+		{
+			a->secs[c][i] = 0;
+			a->nulls[c]++;
+		}
+		else
+		{
+			s = t[c] * 3600.0;
+			a->secs[c][i] = (int32_t)(s < 0.0 ? s - 0.5 : s + 0.5);
+			a->valid[c][i / 8] |= (uint8_t)(1 << (i % 8));
+		}
+	}
+
+	if (++(a->n) == a->rows)
+		ptArrowFlush(a);
+}
+
+// Add a row of the prayer times calculated in *pt*.
+void ptArrowAdd(struct _ptarrow *a, struct _ptimes *pt, int64_t id)
+{
+	double t[PT_FIELDS];
+	short f;
+
+	for (f = 0; f < PT_FIELDS; f++)
+		t[f] = ptTime(pt, f);
+
+	ptArrowRow(a, (int32_t)(pt->jd - 2440587.5), id, t);
+}
+
+// Write the last batch and the end of the stream, and free the columns.
+// Return 0 on success, -1 when a write() failed.
+int ptArrowClose(struct _ptarrow *a)
+{
+	static const uint8_t eos[8] = {0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0};
+	short c;
+
+	if (!a->error) // not when ptArrowOpen() failed
+	{
+		ptArrowFlush(a);
+		put(a, eos, 8);
+	}
+
+	free(a->date);
+	free(a->id);
+
+	for (c = 0; c < PT_FIELDS; c++)
+	{
+		free(a->hours[c]);
+		free(a->secs[c]);
+		free(a->valid[c]);
+	}
+
+	return a->error ? -1 : 0;
+}
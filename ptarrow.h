@@ -0,0 +1,43 @@
+// ptarrow.h
+
+#ifndef __PTARROW_H__
+#define __PTARROW_H__
+
+#include <stdint.h>
+#include "prayertimes.h"
+
+// Units of the prayer time columns.
+#define PTARROW_HOURS 0   // float64 local hours as calculated, NaN kept
+#define PTARROW_SECONDS 1 // int32 seconds from local midnight, NaN as null
+
+// Columns of a record batch: date, id and the prayer time fields.
+#define PTARROW_COLS (2 + PT_FIELDS)
+
+// Room for the flatbuffer metadata of a message.
+#define PTARROW_META 4096
+
+// Arrow IPC stream writer of prayer times. Rows are kept in columns and
+// written out as a record batch every *rows* rows.
+struct _ptarrow
+{
+	int fd;
+	short unit;
+	long rows;  // rows of a record batch
+	long n;     // rows in the current batch
+	int32_t *date;  // days since 1970-01-01
+	int64_t *id;
+	double *hours[PT_FIELDS];
+	int32_t *secs[PT_FIELDS];
+	uint8_t *valid[PT_FIELDS];
+	long nulls[PT_FIELDS];
+	uint8_t meta[PTARROW_META];
+	int error; // a write() failed
+};
+
+int ptArrowOpen(struct _ptarrow *a, int fd, short unit, long rows);
+void ptArrowRow(struct _ptarrow *a, int32_t days, int64_t id, const double *t);
+void ptArrowAdd(struct _ptarrow *a, struct _ptimes *pt, int64_t id);
+int ptArrowFlush(struct _ptarrow *a);
+int ptArrowClose(struct _ptarrow *a);
+
+#endif
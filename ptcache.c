@@ -0,0 +1,100 @@
+// ptcache.c
+// Result cache
+// Keeps the replies of recent requests in a fixed table, a slot for every
+// hash of the request, so that a hit costs a hash and a copy.
+
+#include <stdlib.h>
+#include <string.h>
+#include "ptcache.h"
+
+// Notes:
+// 1. A new entry replaces whatever was in its slot. There is no list to
+//     keep in order, and the memory is fixed at n slots.
+// 2. A slot has a spin lock of its own, held for a copy only, so threads
+//     hardly ever meet on one.
+// 3. The counters are approximate, updated with no ordering.
+//
+
+// FNV-1a hash of *klen* bytes of *key*.
+static uint64_t hash(const char *key, size_t klen)
+{
+	uint64_t h = 14695981039346656037ULL;
+	size_t i;
+
+	for (i = 0; i < klen; i++)
+	{
+		h ^= (unsigned char)key[i];
+		h *= 1099511628211ULL;
+	}
+
+	return h;
+}
+
+static void lock(struct _ptcache_slot *s)
+{
+	while (__atomic_test_and_set(&(s->lock), __ATOMIC_ACQUIRE))
+		while (__atomic_load_n(&(s->lock), __ATOMIC_RELAXED));
+}
+
+static void unlock(struct _ptcache_slot *s)
+{
+	__atomic_clear(&(s->lock), __ATOMIC_RELEASE);
+}
+
+// Start a cache of *n* slots. Return 0 on success, -1 when out of memory.
+int ptCacheInit(struct _ptcache *c, long n)
+{
+	c->n = n > 0 ? n : 1;
+	c->hits = 0;
+	c->misses = 0;
+	c->slot = calloc(c->n, sizeof(struct _ptcache_slot));
+
+	return c->slot == 0 ? -1 : 0;
+}
+
+// Copy the value of *key* to *value* of *room* bytes.
+// Return its length, 0 when not cached.
+size_t ptCacheGet(struct _ptcache *c, const char *key, size_t klen, char *value, size_t room)
+{
+	uint64_t h = hash(key, klen);
+	struct _ptcache_slot *s = &(c->slot[h % (uint64_t)c->n]);
+	size_t n = 0;
+
+	lock(s);
+
+	if (s->vlen > 0 && s->hash == h && s->klen == klen && s->vlen <= room && memcmp(s->key, key, klen) == 0)
+	{
+		n = s->vlen;
+		memcpy(value, s->value, n);
+	}
+
+	unlock(s);
+
+	__atomic_fetch_add(n > 0 ? &(c->hits) : &(c->misses), 1, __ATOMIC_RELAXED);
+
+	return n;
+}
+
+// Cache *value* of *key*, unless either is too long.
+void ptCachePut(struct _ptcache *c, const char *key, size_t klen, const char *value, size_t vlen)
+{
+	uint64_t h = hash(key, klen);
+	struct _ptcache_slot *s = &(c->slot[h % (uint64_t)c->n]);
+
+	if (klen > PTCACHE_KEY || vlen > PTCACHE_VALUE || vlen == 0)
+		return;
+
+	lock(s);
+	s->hash = h;
+	s->klen = (unsigned short)klen;
+	s->vlen = (unsigned short)vlen;
+	memcpy(s->key, key, klen);
+	memcpy(s->value, value, vlen);
+	unlock(s);
+}
+
+void ptCacheFree(struct _ptcache *c)
+{
+	free(c->slot);
+	c->slot = 0;
+}
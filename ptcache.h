@@ -0,0 +1,37 @@
+// ptcache.h
+
+#ifndef __PTCACHE_H__
+#define __PTCACHE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PTCACHE_KEY 120   // longest key cached
+#define PTCACHE_VALUE 4096 // longest value cached
+
+// A cached key and value.
+struct _ptcache_slot
+{
+	int lock;
+	uint64_t hash;
+	unsigned short klen;
+	unsigned short vlen;
+	char key[PTCACHE_KEY];
+	char value[PTCACHE_VALUE];
+};
+
+// Direct-mapped cache of byte strings shared by threads.
+struct _ptcache
+{
+	long n;
+	struct _ptcache_slot *slot;
+	long hits;
+	long misses;
+};
+
+int ptCacheInit(struct _ptcache *c, long n);
+size_t ptCacheGet(struct _ptcache *c, const char *key, size_t klen, char *value, size_t room);
+void ptCachePut(struct _ptcache *c, const char *key, size_t klen, const char *value, size_t vlen);
+void ptCacheFree(struct _ptcache *c);
+
+#endif
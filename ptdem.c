@@ -0,0 +1,134 @@
+// ptdem.c
+// Digital elevation model
+// Maps a raster of heights on a latitude/longitude lattice and samples
+// the elevation of locations from it.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ptdem.h"
+
+// Notes:
+// 1. The heights are read in place from the mapping. The kernel is told
+//     the reads are random, as locations come in no order.
+// 2. The height of a location is interpolated from the four lattice
+//     points around it. A point with no data counts as 0, as does a
+//     location outside the lattice, sea level.
+// 3. Heights below sea level are kept, horizonAdj() takes them as 0.
+// 4. A lattice whose columns go all around the globe, a whole number of
+//     columns in 360 degrees, wraps: any longitude is taken into the turn
+//     of the lattice, and the last column is interpolated with the first.
+//     A last column that repeats the first one, at 360 degrees from it,
+//     is left out of the turn.
+//
+
+// Height of lattice point *row*, *col*, 0 when none.
+static float point(struct _ptdem *d, long row, long col)
+{
+	int16_t v;
+
+	if (row < 0 || col < 0 || row >= d->h->rows || col >= d->h->cols)
+		return 0.0;
+
+	v = d->height[row * d->h->cols + col];
+
+	return v == PTDEM_NODATA ? 0.0f : (float)v;
+}
+
+// Map the elevation model file *path*.
+// Return 0 on success, -1 when it cannot be read or is not one.
+int ptDemOpen(struct _ptdem *d, const char *path)
+{
+	const struct _ptdem_header *h;
+	struct stat st;
+	void *p;
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct _ptdem_header))
+	{
+		close(fd);
+		return -1;
+	}
+
+	p = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping stays
+
+	if (p == MAP_FAILED)
+		return -1;
+
+	h = p;
+
+	if (memcmp(h->magic, PTDEM_MAGIC, sizeof(h->magic)) != 0 || h->rows < 1 || h->cols < 1
+		|| h->dlat == 0.0 || h->dlng == 0.0
+		|| (size_t)st.st_size < sizeof(struct _ptdem_header) + (size_t)h->rows * (size_t)h->cols * sizeof(int16_t))
+	{
+		munmap(p, (size_t)st.st_size);
+		return -1;
+	}
+
+	posix_madvise(p, (size_t)st.st_size, POSIX_MADV_RANDOM);
+
+	d->h = h;
+	d->height = (const int16_t *)(h + 1);
+	d->size = (size_t)st.st_size;
+
+	return 0;
+}
+
+// Columns of a turn of 360 degrees when the lattice of *d* goes around
+// the globe, 0 when not, see note 4.
+static long turn(struct _ptdem *d)
+{
+	double c = 360.0 / (d->h->dlng < 0.0 ? -d->h->dlng : d->h->dlng);
+	long n = (long)(c + 0.5);
+
+	return n <= d->h->cols && c - (double)n < 1e-6 && (double)n - c < 1e-6 ? n : 0;
+}
+
+// Height in meters at *lat*, *lng*.
+float ptDemHeight(struct _ptdem *d, double lat, double lng)
+{
+	double y = (lat - d->h->lat) / d->h->dlat, x = (lng - d->h->lng) / d->h->dlng, fy, fx;
+	long row, col, next, n = turn(d);
+
+	if (n > 0 && x == x)
+		x = dm_fix(x, (double)n);
+
+	if (!(y > -1.0 && x > -1.0 && y < (double)d->h->rows && x < (double)d->h->cols))
+		return 0.0; // outside, or NAN
+
+	row = (long)(y + 1.0) - 1; // floor
+	col = (long)(x + 1.0) - 1;
+	fy = y - (double)row;
+	fx = x - (double)col;
+
+	if (n > 0 && col >= n) // rounded up to the turn
+		col -= n;
+
+	next = n > 0 && col + 1 == n ? 0 : col + 1;
+
+	return (float)((1.0 - fy) * ((1.0 - fx) * point(d, row, col) + fx * point(d, row, next))
+		+ fy * ((1.0 - fx) * point(d, row + 1, col) + fx * point(d, row + 1, next)));
+}
+
+// Set the elevation of *n* locations *loc* from the model.
+void ptDemElevate(struct _ptdem *d, struct _ptimes *loc, long n)
+{
+	long i;
+
+	for (i = 0; i < n; i++)
+		ptSetElevation(&(loc[i]), ptDemHeight(d, loc[i].lat, loc[i].lng));
+}
+
+void ptDemClose(struct _ptdem *d)
+{
+	munmap((void *)d->h, d->size);
+	d->h = 0;
+}
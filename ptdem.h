@@ -0,0 +1,39 @@
+// ptdem.h
+
+#ifndef __PTDEM_H__
+#define __PTDEM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "prayertimes.h"
+
+#define PTDEM_MAGIC "PTDEM1\0"
+#define PTDEM_NODATA -32768 // height of a cell with no data, taken as 0
+
+// Header of a digital elevation model file. It is followed by rows x cols
+// int16_t heights in meters, row by row, in the byte order of the host.
+struct _ptdem_header
+{
+	char magic[8]; // PTDEM_MAGIC
+	int32_t rows;
+	int32_t cols;
+	double lat;    // of the first row, degrees
+	double lng;    // of the first column
+	double dlat;   // from a row to the next, below 0 going south
+	double dlng;   // from a column to the next
+};
+
+// A digital elevation model mapped into memory.
+struct _ptdem
+{
+	const struct _ptdem_header *h;
+	const int16_t *height;
+	size_t size;
+};
+
+int ptDemOpen(struct _ptdem *d, const char *path);
+float ptDemHeight(struct _ptdem *d, double lat, double lng);
+void ptDemElevate(struct _ptdem *d, struct _ptimes *loc, long n);
+void ptDemClose(struct _ptdem *d);
+
+#endif
@@ -0,0 +1,377 @@
+// ptfmt.c
+// Buffered prayer times output formatter
+// Writes the CSV, JSON and text output of pt digit by digit into a large
+// buffer with no printf() and flushes it with few large write() calls.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "ptfmt.h"
+
+// Notes:
+// 1. The output is byte for byte the same as the printf() formats it
+//     replaces: %02d for the parts of a time from t2hms(), %04d-%02d-%02d
+//     for dates, %ld for ids and %14.6f for the location in text output.
+//     %14.6f is matched for any magnitude below PTFMT_FIXED_MAX, well past
+//     every latitude, longitude, elevation and zone, with the sign of
+//     printf(): a negative number that rounds to zero, or -0.0, is put as
+//     -0.000000. A larger number is put as PTFMT_FIXED_MAX, so the digits
+//     always fit 64 bits. The six decimals are rounded from the exact value
+//     of the number, and a tie to even as glibc does, i.e. 124.7890625 is
+//     124.789062: the fraction times 1e6 is split into its rounded double
+//     and the error of the rounding (Dekker's product), which decide on
+//     which side of one half it is.
+//     A time that does not occur, NAN, is put as --:--:--, or left empty
+//     in the Unix times of PTFMT_UNIX.
+// 2. Two digit numbers are copied from a table of the pairs 00 to 99.
+// 3. A record is only started when PTFMT_MAX_RECORD bytes are free, so
+//     the formatting never checks for room within a record.
+//
+
+static const char digits2[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+#define PTFMT_FIXED_MAX 1e12
+
+static char *putStr(char *p, const char *s)
+{
+	while (*s != '\0')
+		*p++ = *s++;
+
+	return p;
+}
+
+// Put an unsigned number in at least *width* digits padded with zeros.
+static char *putUnsigned(char *p, uint64_t v, short width)
+{
+	char t[24];
+	short n = 0;
+
+	while (v >= 100)
+	{
+		n += 2;
+		memcpy(&t[sizeof(t) - n], &digits2[(v % 100) * 2], 2);
+		v /= 100;
+	}
+
+	if (v >= 10)
+	{
+		n += 2;
+		memcpy(&t[sizeof(t) - n], &digits2[v * 2], 2);
+	}
+	else
+		t[sizeof(t) - ++n] = (char)('0' + v);
+
+	while (n < width)
+		t[sizeof(t) - ++n] = '0';
+
+	memcpy(p, &t[sizeof(t) - n], n);
+
+	return p + n;
+}
+
+// Put a number as of printf() %0<width>d or %ld.
+static char *putInt(char *p, long v, short width)
+{
+	if (v >= 0 && v < 100 && width == 2)
+	{
+		memcpy(p, &digits2[v * 2], 2);
+		return p + 2;
+	}
+
+	if (v < 0)
+	{
+		*p++ = '-';
+		return putUnsigned(p, (uint64_t)-v, width - 1);
+	}
+
+	return putUnsigned(p, (uint64_t)v, width);
+}
+
+// Put a number as of printf() %14.6f.
+static char *putFixed(char *p, double v)
+{
+	char t[32], *q = t;
+	uint64_t i, u;
+	double a = v < 0.0 ? -v : v, x, m, c, h, e, d;
+	short n;
+
+	if (signbit(v))
+		*q++ = '-';
+
+	if (a != a)
+		q = putStr(q, "nan");
+	else if (a > PTFMT_FIXED_MAX)
+		q = putStr(q, a == INFINITY ? "inf" : "1000000000000.000000");
+	else
+	{
+		i = (uint64_t)a;
+		x = a - (double)i; // exact
+		m = x * 1e6;
+
+		// x * 1e6 is m + e exactly, 1e6 needs no split
+		c = 134217729.0 * x;
+		h = c - (c - x);
+		e = (h * 1e6 - m) + (x - h) * 1e6;
+
+		u = (uint64_t)m;
+		d = (m - (double)u) - 0.5; // exact, as is m - u
+		u += d > 0.0 || (d == 0.0 && (e > 0.0 || (e == 0.0 && (u & 1) != 0)));
+
+		if (u == 1000000)
+		{
+			++i;
+			u = 0;
+		}
+
+		q = putUnsigned(q, i, 1);
+		*q++ = '.';
+		q = putUnsigned(q, u, 6);
+	}
+
+	for (n = (short)(q - t); n < 14; n++)
+		*p++ = ' ';
+
+	memcpy(p, t, q - t);
+
+	return p + (q - t);
+}
+
+// Put a time as of t2hms() and printf() %02d:%02d:%02d.
+static char *putTime(char *p, double t)
+{
+	short h, m, s;
+
+	t2hms(t, &h, &m, &s);
+
+	if (h < 0)
+		return putStr(p, "--:--:--");
+
+	p = putInt(p, h, 2);
+	*p++ = ':';
+	p = putInt(p, m, 2);
+	*p++ = ':';
+
+	return putInt(p, s, 2);
+}
+
+static char *putDate(char *p, struct _ptimes *pt)
+{
+	p = putInt(p, pt->year, 4);
+	*p++ = '-';
+	p = putInt(p, pt->month, 2);
+	*p++ = '-';
+
+	return putInt(p, pt->day, 2);
+}
+
+static char *putCsv(char *p, struct _ptimes *pt, long *id)
+{
+	short f;
+
+	if (id != 0)
+	{
+		p = putInt(p, *id, 1);
+		*p++ = ',';
+	}
+
+	p = putDate(p, pt);
+
+	for (f = 0; f < PT_FIELDS; f++)
+	{
+		*p++ = ',';
+		p = putTime(p, ptTime(pt, f));
+	}
+
+	*p++ = ' ';
+	*p++ = '\n';
+
+	return p;
+}
+
+static char *putUnix(char *p, struct _ptimes *pt, long *id)
+{
+	int64_t u;
+	short f;
+
+	if (id != 0)
+	{
+		p = putInt(p, *id, 1);
+		*p++ = ',';
+	}
+
+	p = putDate(p, pt);
+
+	for (f = 0; f < PT_FIELDS; f++)
+	{
+		*p++ = ',';
+		u = ptUnixSeconds(pt, f);
+
+		if (u == PT_NO_TIME)
+			continue;
+
+		if (u < 0)
+		{
+			*p++ = '-';
+			p = putUnsigned(p, (uint64_t)-u, 1);
+		}
+		else
+			p = putUnsigned(p, (uint64_t)u, 1);
+	}
+
+	*p++ = '\n';
+
+	return p;
+}
+
+static char *putJson(char *p, struct _ptimes *pt, long *id)
+{
+	static const char *keys[PT_FIELDS] =
+	{
+		",\"imsak\":\"", ",\"fajr\":\"", ",\"sunrise\":\"",
+		",\"dhuhr\":\"", ",\"asr\":\"", ",\"sunset\":\"",
+		",\"maghrib\":\"", ",\"isha\":\"", ",\"midnight\":\""
+	};
+	short f;
+
+	*p++ = '{';
+
+	if (id != 0)
+	{
+		p = putStr(p, "\"id\":");
+		p = putInt(p, *id, 1);
+		*p++ = ',';
+	}
+
+	p = putStr(p, "\"date\":\"");
+	p = putDate(p, pt);
+	*p++ = '"';
+
+	for (f = 0; f < PT_FIELDS; f++)
+	{
+		p = putStr(p, keys[f]);
+		p = putTime(p, ptTime(pt, f));
+		*p++ = '"';
+	}
+
+	*p++ = '}';
+	*p++ = '\n';
+
+	return p;
+}
+
+static char *putText(char *p, struct _ptimes *pt, long *id)
+{
+	static const char *labels[PT_FIELDS] =
+	{
+		"imsak:    ", "fajr:     ", "sunrise:  ",
+		"dhuhr:    ", "asr:      ", "sunset:   ",
+		"maghrib:  ", "isha:     ", "midnight: "
+	};
+	char t[24], *q;
+	short f, n;
+
+	p = putStr(p, "----");
+	p = putDate(p, pt);
+	p = putStr(p, "----\n");
+
+	if (id != 0)
+	{
+		p = putStr(p, "id  ");
+		q = putInt(t, *id, 1);
+
+		for (n = (short)(q - t); n < 14; n++)
+			*p++ = ' ';
+
+		memcpy(p, t, q - t);
+		p += q - t;
+		*p++ = '\n';
+	}
+
+	p = putStr(p, "lat ");
+	p = putFixed(p, pt->lat);
+	p = putStr(p, "\nlng ");
+	p = putFixed(p, pt->lng);
+	p = putStr(p, "\nelv ");
+	p = putFixed(p, pt->elv);
+	p = putStr(p, "\ntz  ");
+	p = putFixed(p, pt->tz);
+	p = putStr(p, "\n------------------\n");
+
+	for (f = 0; f < PT_FIELDS; f++)
+	{
+		p = putStr(p, labels[f]);
+		p = putTime(p, ptTime(pt, f));
+		*p++ = '\n';
+	}
+
+	return p;
+}
+
+// Start formatting into *buf* of *size* bytes, at least PTFMT_MAX_RECORD,
+// to be written to file descriptor *fd*.
+void ptFmtInit(struct _ptfmt *f, char *buf, size_t size, int fd)
+{
+	f->buf = buf;
+	f->size = size;
+	f->len = 0;
+	f->fd = fd;
+	f->error = 0;
+}
+
+// Write out the buffer. Return 0 on success, -1 on failure.
+int ptFmtFlush(struct _ptfmt *f)
+{
+	size_t done = 0;
+	ssize_t n;
+
+	while (done < f->len && !f->error)
+	{
+		n = write(f->fd, f->buf + done, f->len - done);
+
+		if (n > 0)
+			done += (size_t)n;
+		else if (n == 0 || errno != EINTR) // no progress is a failure too
+			f->error = 1;
+	}
+
+	f->len = 0;
+
+	return f->error ? -1 : 0;
+}
+
+// Format the prayer times of *pt* in *out*put type, with the location *id*
+// when given.
+void ptFmtTimes(struct _ptfmt *f, struct _ptimes *pt, short out, long *id)
+{
+	char *p;
+
+	if (f->size - f->len < PTFMT_MAX_RECORD)
+		ptFmtFlush(f);
+
+	p = f->buf + f->len;
+
+	if (out == PTFMT_CSV)
+		p = putCsv(p, pt, id);
+	else if (out == PTFMT_JSON)
+		p = putJson(p, pt, id);
+	else if (out == PTFMT_UNIX)
+		p = putUnix(p, pt, id);
+	else
+		p = putText(p, pt, id);
+
+	f->len = (size_t)(p - f->buf);
+}
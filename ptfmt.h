@@ -0,0 +1,33 @@
+// ptfmt.h
+
+#ifndef __PTFMT_H__
+#define __PTFMT_H__
+
+#include <stddef.h>
+#include "prayertimes.h"
+
+// Output types as of the "o" option of pt.
+#define PTFMT_TEXT 0
+#define PTFMT_CSV 1
+#define PTFMT_JSON 2
+#define PTFMT_UNIX 5 // CSV of ptUnixSeconds()
+
+// Room kept in the buffer for a record of any output type.
+#define PTFMT_MAX_RECORD 512
+
+// Buffered output of prayer times into a caller-owned buffer, written to
+// a file descriptor in large blocks.
+struct _ptfmt
+{
+	char *buf;
+	size_t size;
+	size_t len;
+	int fd;
+	int error; // a write() failed
+};
+
+void ptFmtInit(struct _ptfmt *f, char *buf, size_t size, int fd);
+int ptFmtFlush(struct _ptfmt *f);
+void ptFmtTimes(struct _ptfmt *f, struct _ptimes *pt, short out, long *id);
+
+#endif
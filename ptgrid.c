@@ -0,0 +1,141 @@
+// ptgrid.c
+// Parallel prayer times calendar of many locations
+// Splits the locations x dates space into tiles and calculates them on a
+// work-stealing thread pool.
+
+#include "ptgrid.h"
+
+// Notes:
+// 1. Every tile writes to its own part of the output, which is allocated
+//     by the caller beforehand. Hence no lock is taken and the output is
+//     the same whatever the number of threads.
+// 2. The position of the Sun depends on the date only, so a tile computes
+//     it once per day for all its locations. That is about half of the
+//     work of ptCalc() for a location.
+// 3. Likewise the horizon adjustment depends on the elevation only and is
+//     set once for every location before the tiles.
+// 4. When all the locations have the same settings, a tile is calculated
+//     a day at a time by the vectorized kernels of ptkern.c, which write
+//     down a column of the output. The times are the same.
+// 5. Compact results are packed a day of a tile at a time, so the times
+//     as doubles never take more than a tile of memory.
+//
+
+static void gridTile(void *arg, long task, int worker)
+{
+	struct _ptgrid *g = arg;
+	struct _ptsun sun;
+	struct _ptimes pt;
+	float lat[PTGRID_TILE_LOCS], lng[PTGRID_TILE_LOCS], elv[PTGRID_TILE_LOCS], tz[PTGRID_TILE_LOCS];
+	double t[PTGRID_TILE_LOCS * PT_FIELDS], *o;
+	short adj[PTGRID_TILE_LOCS];
+	long d0, d1, l0, l1, d, l;
+	short y, m, dd, f;
+
+	d0 = (task % g->tiles_days) * PTGRID_TILE_DAYS;
+	l0 = (task / g->tiles_days) * PTGRID_TILE_LOCS;
+	d1 = d0 + PTGRID_TILE_DAYS < g->ndays ? d0 + PTGRID_TILE_DAYS : g->ndays;
+	l1 = l0 + PTGRID_TILE_LOCS < g->nloc ? l0 + PTGRID_TILE_LOCS : g->nloc;
+
+	for (l = l0; g->kern != 0 && l < l1; l++)
+	{
+		lat[l - l0] = g->loc[l].lat;
+		lng[l - l0] = g->loc[l].lng;
+		elv[l - l0] = g->loc[l].elv;
+		tz[l - l0] = g->loc[l].tz;
+	}
+
+	for (d = d0; d < d1; d++)
+	{
+		gregorian(g->jd + (double)d, &y, &m, &dd);
+		ptSunInit(&sun, julian(y, m, dd), g->loc[l0].sun_model);
+
+		if (g->kern != 0 && g->res == 0)
+		{
+			g->kern->times(&(g->loc[l0]), &sun, lat, lng, elv, tz, l1 - l0, g->out + (l0 * g->ndays + d) * PT_FIELDS,
+				g->ndays * PT_FIELDS, 0);
+			continue;
+		}
+
+		if (g->kern != 0)
+		{
+			g->kern->times(&(g->loc[l0]), &sun, lat, lng, elv, tz, l1 - l0, t, PT_FIELDS, adj);
+
+			for (l = l0; l < l1; l++)
+				ptResPack(&(g->res[l * g->ndays + d]), t + (l - l0) * PT_FIELDS, adj[l - l0]);
+
+			continue;
+		}
+
+		for (l = l0; l < l1; l++)
+		{
+			pt = g->loc[l];
+			pt.sun = &sun;
+			pt.phase = 0;
+			ptSetDate(&pt, y, m, dd);
+
+			while (ptCalc(&pt) != 0);
+
+			if (g->res != 0)
+			{
+				ptResSet(&(g->res[l * g->ndays + d]), &pt);
+				continue;
+			}
+
+			o = g->out + (l * g->ndays + d) * PT_FIELDS;
+
+			for (f = 0; f < PT_FIELDS; f++)
+				o[f] = ptTime(&pt, f);
+		}
+	}
+}
+
+static void gridRun(struct _ptpool *pool, struct _ptgrid *g, struct _ptimes *loc, long nloc, short year, short month,
+	short day, long ndays)
+{
+	long i;
+
+	for (i = 0; i < nloc; i++)
+	{
+		if (loc[i].horz_elv != loc[i].elv)
+			ptSetElevation(&(loc[i]), loc[i].elv);
+	}
+
+	g->loc = loc;
+	g->nloc = nloc;
+	g->jd = julian(year, month, day);
+	g->ndays = ndays;
+	g->tiles_days = (ndays + PTGRID_TILE_DAYS - 1) / PTGRID_TILE_DAYS;
+	g->kern = ptKern();
+
+	for (i = 1; i < nloc && g->kern != 0; i++)
+	{
+		if (!ptKernSame(&(loc[0]), &(loc[i])))
+			g->kern = 0;
+	}
+
+	ptPoolRun(pool, g->tiles_days * ((nloc + PTGRID_TILE_LOCS - 1) / PTGRID_TILE_LOCS), gridTile, g);
+}
+
+// Calculate the prayer times of *nloc* locations *loc* for *ndays* days
+// from *year*-*month*-*day* into *out* of nloc * ndays * PT_FIELDS times.
+void ptGridRun(struct _ptpool *pool, struct _ptimes *loc, long nloc, short year, short month, short day, long ndays, double *out)
+{
+	struct _ptgrid g;
+
+	g.out = out;
+	g.res = 0;
+	gridRun(pool, &g, loc, nloc, year, month, day, ndays);
+}
+
+// Likewise into the compact results *res* of nloc * ndays, i.e. the r of
+// a struct _ptresset of ptResAlloc().
+void ptGridRunRes(struct _ptpool *pool, struct _ptimes *loc, long nloc, short year, short month, short day, long ndays,
+	struct _ptres *res)
+{
+	struct _ptgrid g;
+
+	g.out = 0;
+	g.res = res;
+	gridRun(pool, &g, loc, nloc, year, month, day, ndays);
+}
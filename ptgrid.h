@@ -0,0 +1,36 @@
+// ptgrid.h
+
+#ifndef __PTGRID_H__
+#define __PTGRID_H__
+
+#include "prayertimes.h"
+#include "ptpool.h"
+#include "ptkern.h"
+#include "ptres.h"
+
+// A tile of the locations x dates space calculated as one task.
+// The days of a tile share the positions of the Sun, and the locations
+// of a tile stay in cache across its days.
+#define PTGRID_TILE_LOCS 64
+#define PTGRID_TILE_DAYS 16
+
+// Prayer times of *nloc* locations for *ndays* days from a date.
+// The times of location i on day d are at
+// out[(i * ndays + d) * PT_FIELDS + PT_IMSAK] and so on.
+struct _ptgrid
+{
+	struct _ptimes *loc; // locations with their settings
+	long nloc;
+	double jd;           // Julian date of the first day
+	long ndays;
+	double *out;
+	struct _ptres *res;  // compact output instead of out, or 0
+	long tiles_days;     // tiles along the days
+	const struct _ptkern *kern; // of all the locations, 0 when their settings differ
+};
+
+void ptGridRun(struct _ptpool *pool, struct _ptimes *loc, long nloc, short year, short month, short day, long ndays, double *out);
+void ptGridRunRes(struct _ptpool *pool, struct _ptimes *loc, long nloc, short year, short month, short day, long ndays,
+	struct _ptres *res);
+
+#endif
@@ -0,0 +1,267 @@
+// ptindex.c
+// Reverse index of prayer times
+// Answers which locations enter a prayer time within a time window
+// from the bulk results of a day, instead of scanning every location.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "ptindex.h"
+
+#define PTINDEX_MAX_THREADS 64
+
+// Notes:
+// 1. The events of a field are kept sorted by (time, id). Hence a query
+//     is a binary search for the start of the window followed by the
+//     matching entries, and a sweep cursor walks forward from where the
+//     previous sweep stopped.
+// 2. Sorting is done in parallel. The entries are split into one chunk
+//     per thread, the chunks are sorted concurrently, and then merged
+//     pairwise in rounds with one thread per pair.
+//
+
+static int cmpEntry(const void *a, const void *b)
+{
+	const struct _ptindex_entry *x = a, *y = b;
+
+	if (x->t != y->t)
+		return x->t < y->t ? -1 : 1;
+
+	if (x->id != y->id)
+		return x->id < y->id ? -1 : 1;
+
+	return 0;
+}
+
+struct _sortjob
+{
+	struct _ptindex_entry *src;
+	struct _ptindex_entry *dst;
+	long lo;
+	long mid;
+	long hi;
+};
+
+static void *sortChunk(void *arg)
+{
+	struct _sortjob *j = arg;
+
+	qsort(j->src + j->lo, j->hi - j->lo, sizeof(struct _ptindex_entry), cmpEntry);
+	return 0;
+}
+
+// Merge the sorted runs src[lo, mid) and src[mid, hi) into dst[lo, hi).
+static void *mergeChunk(void *arg)
+{
+	struct _sortjob *j = arg;
+	long a = j->lo, b = j->mid, k = j->lo;
+
+	while (a < j->mid && b < j->hi)
+		j->dst[k++] = cmpEntry(&j->src[b], &j->src[a]) < 0 ? j->src[b++] : j->src[a++];
+
+	while (a < j->mid)
+		j->dst[k++] = j->src[a++];
+
+	while (b < j->hi)
+		j->dst[k++] = j->src[b++];
+
+	return 0;
+}
+
+// Run *fn* on every job, one thread each, the first on the calling thread.
+static void runJobs(void *(*fn)(void *), struct _sortjob *jobs, int count)
+{
+	pthread_t th[PTINDEX_MAX_THREADS];
+	int i, started[PTINDEX_MAX_THREADS];
+
+	for (i = 1; i < count; i++)
+		started[i] = pthread_create(&th[i], 0, fn, &jobs[i]) == 0;
+
+	fn(&jobs[0]);
+
+	for (i = 1; i < count; i++)
+	{
+		if (started[i])
+			pthread_join(th[i], 0);
+		else
+			fn(&jobs[i]);
+	}
+}
+
+// Sort *n* entries of *e* using *tmp* as the merge buffer.
+static void sortEntries(struct _ptindex_entry *e, struct _ptindex_entry *tmp, long n, int threads)
+{
+	struct _sortjob jobs[PTINDEX_MAX_THREADS];
+	long b[PTINDEX_MAX_THREADS + 1];
+	struct _ptindex_entry *src = e, *dst = tmp, *x;
+	int i, k = threads;
+
+	if ((long)k > n / 4096)
+		k = (int)(n / 4096); // not worth a thread
+
+	if (k < 1)
+		k = 1;
+
+	for (i = 0; i <= k; i++)
+		b[i] = n * i / k;
+
+	for (i = 0; i < k; i++)
+	{
+		jobs[i].src = src;
+		jobs[i].lo = b[i];
+		jobs[i].hi = b[i + 1];
+	}
+
+	runJobs(sortChunk, jobs, k);
+
+	while (k > 1)
+	{
+		for (i = 0; i < k; i += 2)
+		{
+			jobs[i / 2].src = src;
+			jobs[i / 2].dst = dst;
+			jobs[i / 2].lo = b[i];
+			jobs[i / 2].mid = b[i + 1];
+			jobs[i / 2].hi = i + 1 < k ? b[i + 2] : b[i + 1]; // odd run is copied
+			b[i / 2] = b[i];
+		}
+
+		b[(k + 1) / 2] = n;
+		k = (k + 1) / 2;
+		runJobs(mergeChunk, jobs, k);
+
+		x = src;
+		src = dst;
+		dst = x;
+	}
+
+	if (src != e)
+		memcpy(e, src, n * sizeof(struct _ptindex_entry));
+}
+
+// First entry in e[lo, hi) at or after time *t*.
+static long lowerBound(struct _ptindex_entry *e, long lo, long hi, int64_t t)
+{
+	long m;
+
+	while (lo < hi)
+	{
+		m = lo + (hi - lo) / 2;
+
+		if (e[m].t < t)
+			lo = m + 1;
+		else
+			hi = m;
+	}
+
+	return lo;
+}
+
+// Build the index of *n* calculated prayer times *res* of locations *ids*.
+// *threads* is the number of sorting threads, 0 for every online CPU.
+// Return 0 on success, -1 when out of memory.
+int ptIndexBuild(struct _ptindex *ix, struct _ptimes *res, const long *ids, long n, int threads)
+{
+	struct _ptindex_entry *tmp;
+	double t;
+	long i, k;
+	short f;
+
+	memset(ix, 0, sizeof(struct _ptindex));
+
+	if (threads <= 0)
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (threads < 1)
+		threads = 1;
+	else if (threads > PTINDEX_MAX_THREADS)
+		threads = PTINDEX_MAX_THREADS;
+
+	tmp = malloc((n > 0 ? n : 1) * sizeof(struct _ptindex_entry));
+
+	if (tmp == 0)
+		return -1;
+
+	for (f = 0; f < PT_FIELDS; f++)
+	{
+		ix->e[f] = malloc((n > 0 ? n : 1) * sizeof(struct _ptindex_entry));
+
+		if (ix->e[f] == 0)
+		{
+			free(tmp);
+			ptIndexFree(ix);
+			return -1;
+		}
+
+		for (i = 0, k = 0; i < n; i++)
+		{
+			t = ptTime(&res[i], f);
+
+			if (t != t) // NaN
+				continue;
+
+			ix->e[f][k].t = (int64_t)ptUnixTime(&res[i], t);
+			ix->e[f][k].id = ids[i];
+			++k;
+		}
+
+		ix->n[f] = k;
+		sortEntries(ix->e[f], tmp, k, threads);
+	}
+
+	free(tmp);
+	return 0;
+}
+
+void ptIndexFree(struct _ptindex *ix)
+{
+	short f;
+
+	for (f = 0; f < PT_FIELDS; f++)
+	{
+		free(ix->e[f]);
+		ix->e[f] = 0;
+		ix->n[f] = 0;
+	}
+}
+
+// Get the locations entering prayer time *field* within [*t0*, *t1*).
+// Return the first matching entry and set *count* to the number of them.
+struct _ptindex_entry *ptIndexRange(struct _ptindex *ix, short field, int64_t t0, int64_t t1, long *count)
+{
+	long a, b;
+
+	a = lowerBound(ix->e[field], 0, ix->n[field], t0);
+	b = lowerBound(ix->e[field], a, ix->n[field], t1);
+	*count = b - a;
+
+	return ix->e[field] + a;
+}
+
+// Position the sweep cursor *cur* at time *t* for every field.
+void ptIndexSeek(struct _ptindex *ix, struct _ptindex_cursor *cur, int64_t t)
+{
+	short f;
+
+	for (f = 0; f < PT_FIELDS; f++)
+		cur->pos[f] = lowerBound(ix->e[f], 0, ix->n[f], t);
+}
+
+// Get the locations entering prayer time *field* from the cursor up to,
+// but not including, time *t1*, and move the cursor past them.
+// Return the first matching entry and set *count* to the number of them.
+struct _ptindex_entry *ptIndexSweep(struct _ptindex *ix, struct _ptindex_cursor *cur, short field, int64_t t1, long *count)
+{
+	long a = cur->pos[field], b = a;
+
+	while (b < ix->n[field] && ix->e[field][b].t < t1)
+		++b;
+
+	cur->pos[field] = b;
+	*count = b - a;
+
+	return ix->e[field] + a;
+}
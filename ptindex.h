@@ -0,0 +1,36 @@
+// ptindex.h
+
+#ifndef __PTINDEX_H__
+#define __PTINDEX_H__
+
+#include <stdint.h>
+#include "prayertimes.h"
+
+// A prayer time event of a location.
+struct _ptindex_entry
+{
+	int64_t t; // UTC time in seconds since 1970-01-01
+	long id;   // location id
+};
+
+// Reverse index of a day of prayer times. For every prayer time field
+// the locations are sorted by the UTC time of the event.
+struct _ptindex
+{
+	long n[PT_FIELDS]; // events per field, NaN times are left out
+	struct _ptindex_entry *e[PT_FIELDS];
+};
+
+// A sweep through the index as time passes.
+struct _ptindex_cursor
+{
+	long pos[PT_FIELDS];
+};
+
+int ptIndexBuild(struct _ptindex *ix, struct _ptimes *res, const long *ids, long n, int threads);
+void ptIndexFree(struct _ptindex *ix);
+struct _ptindex_entry *ptIndexRange(struct _ptindex *ix, short field, int64_t t0, int64_t t1, long *count);
+void ptIndexSeek(struct _ptindex *ix, struct _ptindex_cursor *cur, int64_t t);
+struct _ptindex_entry *ptIndexSweep(struct _ptindex *ix, struct _ptindex_cursor *cur, short field, int64_t t1, long *count);
+
+#endif
@@ -0,0 +1,583 @@
+// ptkern.c
+// Kernels over many locations for several instruction sets
+// The same C code of the kernels is built for the baseline of the target
+// and, on x86-64, for AVX2 and AVX-512. The compiler vectorizes every
+// build for its set, and the one of the best set the CPU has is chosen
+// once at run time.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ptkern.h"
+
+// Notes:
+// 1. The math follows the routines of prayertimes.c and atan.c operation
+//     by operation, with the branches turned into selects so that a loop
+//     over the lanes vectorizes. FMA contraction is off (see makefile), so
+//     every build gives the same results as ptCalc() bit for bit with the
+//     default PT_TRIG_TIER. Other tiers get the full precision here.
+// 2. A call is done in blocks of KERN_BLOCK lanes. Every step of ptCalc()
+//     is a loop over the block into an array of the block, and the settings
+//     which ptCalc() tests are tested once per block, so the loops have no
+//     branches. The times are written out to the rows of the caller last.
+// 3. The positions of the Sun and everything depending on the date or the
+//     settings alone are taken once per call with the scalar routines.
+// 4. The choice is kept in an atomic pointer. Threads racing for the first
+//     call each make the same choice, so no lock is taken.
+//
+
+#define KERN_BLOCK 64
+
+#define KI static inline __attribute__((always_inline))
+
+#define PIO2_HI 1.57079632679489655800e+00
+#define PIO2_LO 6.12323399573676603587e-17
+#define DTR     1.74532925199432957692e-02
+
+// Settings and date of a call, as the scalars of ptCalc().
+struct _kset
+{
+	double noon[PT_FIELDS]; // dm_fixHour(12 - eqt)
+	double sd[PT_FIELDS];   // dm_sin(decl)
+	double cd[PT_FIELDS];   // dm_cos(decl)
+	double decl_asr;
+	double dhuhr;
+	double sa_fajr;         // dm_sin() of the angles of the settings
+	double sa_imsak;
+	double sa_maghrib;
+	double sa_isha;
+	double hl[4];           // high latitude portions: imsak, fajr, maghrib, isha
+};
+
+KI double kNan(void)
+{
+	return __builtin_nan("");
+}
+
+// Floor of *x* for |x| below 2^51, else *x* itself, NAN too. Rounded by
+// the magic number of 1.5 * 2^52 with no conversion to an integer.
+KI double kFloor(double x)
+{
+	double t = (x + 0x1.8p52) - 0x1.8p52;
+
+	t -= t > x ? 1.0 : 0.0;
+
+	return (x > -0x1p51) & (x < 0x1p51) ? t : x;
+}
+
+// nearest() of prayertimes.c, halves away from 0, and 0 for a NAN or |x|
+// from 2^31 on, as floor(|x| + 0.5) with the sign of *x*.
+KI double kNearest(double x)
+{
+	double a = x < 0.0 ? -x : x, r = kFloor(a + 0.5);
+
+	r = a < 2147483647.0 ? r : 0.0;
+
+	return x < 0.0 ? 0.0 - r : r;
+}
+
+KI double kFixHour(double a)
+{
+	a = a - 24.0 * kFloor(a / 24.0);
+
+	return a < 0.0 ? a + 24.0 : a;
+}
+
+KI double kSin(double r)
+{
+	double z = r * r;
+
+	return r + r * z * (-1.66666666666666324348e-01 + z * (8.33333333332248946124e-03
+		+ z * (-1.98412698298579493134e-04 + z * (2.75573137070700676789e-06
+		+ z * (-2.50507602534068634195e-08 + z * 1.58969099521155010221e-10)))));
+}
+
+KI double kCos(double r)
+{
+	double z = r * r;
+
+	return 1.0 - 0.5 * z + z * z * (4.16666666666666019037e-02 + z * (-1.38888888888741095749e-03
+		+ z * (2.48015872894767294178e-05 + z * (-2.75573143513906633035e-07
+		+ z * (2.08757232129817482790e-09 + z * -1.13596475577881948265e-11)))));
+}
+
+// sin(r + q * pi/2) of sin(r) *s* and cos(r) *c*.
+KI double kQuad(double s, double c, int q)
+{
+	double v = q & 1 ? c : s;
+
+	return q & 2 ? -v : v;
+}
+
+// dm_sin() and dm_cos() of *d* degrees.
+KI void kSinCos(double d, double *s, double *c)
+{
+	double k = kNearest(d / 90.0), r, ks, kc;
+
+	r = (d - k * 90.0) * DTR;
+	ks = kSin(r);
+	kc = kCos(r);
+	*s = kQuad(ks, kc, (int)k);
+	*c = kQuad(ks, kc, (int)k + 1);
+}
+
+KI double kSinDeg(double d)
+{
+	double s, c;
+
+	kSinCos(d, &s, &c);
+
+	return s;
+}
+
+KI double kTanDeg(double d)
+{
+	double s, c;
+
+	kSinCos(d, &s, &c);
+
+	return s / c;
+}
+
+// p_sqrt()
+KI double kSqrt(double v)
+{
+	uint64_t i;
+	double r;
+
+	memcpy(&i, &v, sizeof(i));
+	i = (i >> 1) + (0x3FF0000000000000ULL >> 1);
+	memcpy(&r, &i, sizeof(r));
+	r = 0.5 * (r + v / r);
+	r = 0.5 * (r + v / r);
+	r = 0.5 * (r + v / r);
+	r = 0.5 * (r + v / r);
+
+	r = v > 0.0 ? r : kNan();
+
+	return v == 0.0 ? 0.0 : r;
+}
+
+KI double kAsinR(double z)
+{
+	double p, q;
+
+	p = z * (1.66666666666666657415e-01 + z * (-3.25565818622400915405e-01
+		+ z * (2.01212532134862925881e-01 + z * (-4.00555345006794114027e-02
+		+ z * (7.91534994289814532176e-04 + z * 3.47933107596021167570e-05)))));
+	q = 1.0 + z * (-2.40339491173441421878e+00 + z * (2.02094576023350569471e+00
+		+ z * (-6.88283971605453293030e-01 + z * 7.70381505559019352791e-02)));
+
+	return p / q;
+}
+
+// dm_arccos()
+KI double kAcosDeg(double x)
+{
+	double a = x < 0.0 ? -x : x, t, z, R, s, r;
+
+	t = 0.5 * (1.0 - a);
+	z = a <= 0.5 ? x * x : t;
+	R = kAsinR(z);
+	s = kSqrt(t);
+	s += s * R;
+
+	r = a <= 0.5 ? PIO2_HI - (x - (PIO2_LO - x * R))
+		: x < 0.0 ? 2.0 * (PIO2_HI - s) + 2.0 * PIO2_LO : 2.0 * s;
+	r = a <= 1.0 ? r : kNan();
+
+	return (r * 180.0) / P_PI;
+}
+
+// p_atan() of atan.c
+KI double kAtan(double x)
+{
+	double a = x < 0.0 ? -x : x, t, z, w, s1, s2, hi, lo, r, num, den;
+
+	// the reductions of atan.c as one division of selected terms
+	num = a < 0.6875 ? 2.0 * a - 1.0 : a < 1.1875 ? a - 1.0 : a < 2.4375 ? a - 1.5 : -1.0;
+	den = a < 0.6875 ? 2.0 + a : a < 1.1875 ? a + 1.0 : a < 2.4375 ? 1.0 + 1.5 * a : a;
+	t = a < 0.4375 ? x : num / den;
+	hi = a < 0.6875 ? 4.63647609000806093515e-01 : a < 1.1875 ? 7.85398163397448278999e-01
+		: a < 2.4375 ? 9.82793723247329054082e-01 : 1.57079632679489655800e+00;
+	lo = a < 0.6875 ? 2.26987774529616870924e-17 : a < 1.1875 ? 3.06161699786838301793e-17
+		: a < 2.4375 ? 1.39033110312309984516e-17 : 6.12323399573676603587e-17;
+
+	z = t * t;
+	w = z * z;
+	s1 = z * (3.33333333333329318027e-01 + w * (1.42857142725034663711e-01 + w * (9.09088713343650656196e-02
+		+ w * (6.66107313738753120669e-02 + w * (4.97687799461593236017e-02 + w * 1.62858201153657823623e-02)))));
+	s2 = w * (-1.99999999998764832476e-01 + w * (-1.11111104054623557880e-01 + w * (-7.69187620504482999495e-02
+		+ w * (-5.83357013379057348645e-02 + w * -3.65315727442169155270e-02))));
+
+	r = hi - ((t * (s1 + s2) - lo) - t);
+	r = x < 0.0 ? -r : r;
+	r = a < 0.4375 ? t - t * (s1 + s2) : r;
+	r = a < 0x1p-27 ? x : r;
+
+	return a >= 0x1p66 ? (x < 0.0 ? -1.57079632679489655800e+00 : 1.57079632679489655800e+00) : r;
+}
+
+// _sunAngleTimeRel() of sin(lat) *sl*, cos(lat) *cl*, sin(angle) *sa*,
+// sin(decl) *sd* and cos(decl) *cd*.
+KI double kAngleTime(double sl, double cl, double sa, double sd, double cd)
+{
+	return 1.0 / 15.0 * kAcosDeg((-sa - sd * sl) / (cd * cl));
+}
+
+// highLatTime() for the portion *p* of the night.
+KI double kHighLat(double t, double base, double p, double night, int ccw)
+{
+	double td;
+
+	p *= night;
+	td = ccw ? kFixHour(base - t) : kFixHour(t - base);
+
+	return t != t || td > p ? base + (ccw ? -p : p) : t;
+}
+
+// highLatBit() of prayertimes.c as a double.
+KI double kHighLatBit(double t, double h, double bit)
+{
+	return t == h || (t != t && h != h) ? 0.0 : bit;
+}
+
+// Portion of the night of highLatTime() for *angle*, 0 for none.
+static double highLatPortion(const struct _ptimes *set, float angle)
+{
+	if (set->high_lats == HIGHLAT_NONE)
+		return 0.0;
+
+	if (set->high_lats == HIGHLAT_ANGLE_BASED && angle != 0.0)
+		return 1.0 / 60.0 * angle;
+
+	if (set->high_lats == HIGHLAT_ONE_SEVEN)
+		return 1.0 / 7.0;
+
+	return 0.5;
+}
+
+static void ksetInit(struct _kset *k, const struct _ptimes *set, const struct _ptsun *sun)
+{
+	short f;
+
+	for (f = 0; f < PT_FIELDS; f++)
+	{
+		k->noon[f] = dm_fixHour(12.0 - sun->eqt[f]);
+		k->sd[f] = dm_sin(sun->decl[f]);
+		k->cd[f] = dm_cos(sun->decl[f]);
+	}
+
+	k->decl_asr = sun->decl[PT_ASR];
+	k->dhuhr = dm_fixHour(12.0 - sun->eqt[PT_DHUHR]) + set->dhuhr_rel_m / 60.0;
+	k->sa_fajr = dm_sin(set->fajr_rel_d);
+	k->sa_imsak = dm_sin(set->imsak_rel_d);
+	k->sa_maghrib = dm_sin(set->maghrib_rel_d);
+	k->sa_isha = dm_sin(set->isha_rel_d);
+	k->hl[0] = highLatPortion(set, 0.0);
+	k->hl[1] = highLatPortion(set, set->fajr_rel_d);
+	k->hl[2] = highLatPortion(set, set->maghrib_rel_d);
+	k->hl[3] = highLatPortion(set, set->isha_rel_d);
+}
+
+// ptUnixSeconds() of time *t* of a row of zone *tz*, on the date of Unix
+// time *day*.
+KI int64_t kUnix(double t, double day, double tz)
+{
+	double u = day + (t - tz) * 3600.0 + 0.5, v, r;
+	int ok = u > -PT_UNIX_MAX && u < PT_UNIX_MAX; // false for NAN
+	int64_t i;
+
+	// The shift to 1.5 * 2^52 rounds to the nearest integer, which is then
+	// the low bits of the mantissa, taken as they are since AVX2 and below
+	// convert no doubles to 64-bit integers.
+	v = ok ? u : 0.0;
+	r = v + 0x1.8p52;
+	memcpy(&i, &r, sizeof(i));
+	i -= 0x4338000000000000LL;
+	i -= r - 0x1.8p52 > v; // floor
+
+	return ok ? i : PT_NO_TIME;
+}
+
+// Times of a block of *n* lanes, see struct _ptkern.
+KI void kernBlock(const struct _ptimes *set, const struct _kset *k, const float *lat, const float *lng,
+	const float *elv, const float *tz, long n, double *out, long stride, short *adj)
+{
+	double sl[KERN_BLOCK], cl[KERN_BLOCK], t[PT_FIELDS][KERN_BLOCK], night[KERN_BLOCK], a[KERN_BLOCK];
+	double h, td, *m;
+	float angle;
+	long i;
+	short f;
+
+	for (i = 0; i < n; i++)
+		kSinCos(lat[i], &sl[i], &cl[i]);
+
+	for (i = 0; i < n; i++)
+	{
+		h = elv[i] > 0.0 ? 0.0347 * kSqrt(elv[i]) : 0.0;
+		angle = (float)(0.833 + h);
+		h = kSinDeg(angle);
+		t[PT_SUNRISE][i] = k->noon[PT_SUNRISE] - kAngleTime(sl[i], cl[i], h, k->sd[PT_SUNRISE], k->cd[PT_SUNRISE]);
+		t[PT_SUNSET][i] = k->noon[PT_SUNSET] + kAngleTime(sl[i], cl[i], h, k->sd[PT_SUNSET], k->cd[PT_SUNSET]);
+		night[i] = kFixHour(t[PT_SUNRISE][i] - t[PT_SUNSET][i]);
+	}
+
+	if (set->fajr_rel_d != 0.0)
+	{
+		for (i = 0; i < n; i++)
+			t[PT_FAJR][i] = k->noon[PT_FAJR] - kAngleTime(sl[i], cl[i], k->sa_fajr, k->sd[PT_FAJR], k->cd[PT_FAJR]);
+	}
+	else
+	{
+		for (i = 0; i < n; i++)
+			t[PT_FAJR][i] = t[PT_SUNRISE][i] - set->fajr_rel_m / 60.0;
+	}
+
+	if (set->imsak_rel_d != 0.0)
+	{
+		for (i = 0; i < n; i++)
+			t[PT_IMSAK][i] = k->noon[PT_IMSAK] - kAngleTime(sl[i], cl[i], k->sa_imsak, k->sd[PT_IMSAK], k->cd[PT_IMSAK]);
+	}
+	else
+	{
+		for (i = 0; i < n; i++)
+			t[PT_IMSAK][i] = t[PT_FAJR][i] - set->imsak_rel_m / 60.0;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		t[PT_DHUHR][i] = k->dhuhr;
+		h = lat[i] - k->decl_asr;
+		h = set->asr_factor + kTanDeg(h < 0.0 ? -h : h);
+		angle = (float)-((kAtan(1.0 / h) * 180.0) / P_PI);
+		t[PT_ASR][i] = k->noon[PT_ASR] + kAngleTime(sl[i], cl[i], kSinDeg(angle), k->sd[PT_ASR], k->cd[PT_ASR])
+			+ set->asr_rel_m / 60.0;
+	}
+
+	if (set->maghrib_rel_d != 0.0)
+	{
+		for (i = 0; i < n; i++)
+			t[PT_MAGHRIB][i] = k->noon[PT_MAGHRIB] + kAngleTime(sl[i], cl[i], k->sa_maghrib, k->sd[PT_MAGHRIB], k->cd[PT_MAGHRIB]);
+	}
+	else
+	{
+		for (i = 0; i < n; i++)
+			t[PT_MAGHRIB][i] = t[PT_SUNSET][i] + (set->maghrib_rel_m / 60.0);
+	}
+
+	if (set->isha_rel_d != 0.0)
+	{
+		for (i = 0; i < n; i++)
+			t[PT_ISHA][i] = k->noon[PT_ISHA] + kAngleTime(sl[i], cl[i], k->sa_isha, k->sd[PT_ISHA], k->cd[PT_ISHA]);
+	}
+	else
+	{
+		for (i = 0; i < n; i++)
+			t[PT_ISHA][i] = t[PT_MAGHRIB][i] + (set->isha_rel_m / 60.0);
+	}
+
+	if (set->high_lats != HIGHLAT_NONE)
+	{
+		for (i = 0; i < n; i++)
+		{
+			h = kHighLat(t[PT_IMSAK][i], t[PT_SUNRISE][i], k->hl[0], night[i], 1);
+			a[i] = kHighLatBit(t[PT_IMSAK][i], h, PT_HL_IMSAK);
+			t[PT_IMSAK][i] = h;
+			h = kHighLat(t[PT_FAJR][i], t[PT_SUNRISE][i], k->hl[1], night[i], 1);
+			a[i] += kHighLatBit(t[PT_FAJR][i], h, PT_HL_FAJR);
+			t[PT_FAJR][i] = h;
+			h = kHighLat(t[PT_MAGHRIB][i], t[PT_SUNSET][i], k->hl[2], night[i], 0);
+			a[i] += kHighLatBit(t[PT_MAGHRIB][i], h, PT_HL_MAGHRIB);
+			t[PT_MAGHRIB][i] = h;
+			h = kHighLat(t[PT_ISHA][i], t[PT_SUNSET][i], k->hl[3], night[i], 0);
+			a[i] += kHighLatBit(t[PT_ISHA][i], h, PT_HL_ISHA);
+			t[PT_ISHA][i] = h;
+		}
+	}
+	else
+	{
+		for (i = 0; i < n; i++)
+			a[i] = 0.0;
+	}
+
+	m = set->midnight_type == MIDNIGHT_JAFARI ? t[PT_FAJR] : t[PT_SUNRISE];
+
+	for (i = 0; i < n; i++)
+		t[PT_MIDNIGHT][i] = t[PT_SUNSET][i] + kFixHour(m[i] - t[PT_SUNSET][i]) / 2.0;
+
+	for (i = 0; i < n; i++)
+	{
+		td = tz[i] - lng[i] / 15.0;
+
+		for (f = 0; f < PT_FIELDS; f++)
+			out[i * stride + f] = t[f][i] + td;
+	}
+
+	if (adj != 0)
+	{
+		for (i = 0; i < n; i++)
+			adj[i] = (short)a[i];
+	}
+}
+
+// The kernels of every build, of name *S* for the target *T*.
+#define KERN_BUILD(S, T) \
+	T static void times_##S(const struct _ptimes *set, const struct _ptsun *sun, const float *lat, const float *lng, \
+		const float *elv, const float *tz, long n, double *out, long stride, short *adj) \
+	{ \
+		struct _kset k; \
+		long i; \
+		ksetInit(&k, set, sun); \
+		for (i = 0; i < n; i += KERN_BLOCK) \
+			kernBlock(set, &k, lat + i, lng + i, elv + i, tz + i, n - i < KERN_BLOCK ? n - i : KERN_BLOCK, \
+				out + i * stride, stride, adj != 0 ? adj + i : 0); \
+	} \
+	T static void utc_##S(const double *t, const double *jd, const float *tz, long n, int64_t *out) \
+	{ \
+		double day[KERN_BLOCK * PT_FIELDS], z[KERN_BLOCK * PT_FIELDS], d; \
+		long i, j, m; \
+		short f; \
+		for (i = 0; i < n; i += KERN_BLOCK) \
+		{ \
+			m = n - i < KERN_BLOCK ? n - i : KERN_BLOCK; \
+			for (j = 0; j < m; j++) \
+			{ \
+				d = (jd[i + j] - 2440587.5) * 86400.0; \
+				for (f = 0; f < PT_FIELDS; f++) \
+				{ \
+					day[j * PT_FIELDS + f] = d; \
+					z[j * PT_FIELDS + f] = tz[i + j]; \
+				} \
+			} \
+			for (j = 0; j < m * PT_FIELDS; j++) \
+				out[i * PT_FIELDS + j] = kUnix(t[i * PT_FIELDS + j], day[j], z[j]); \
+		} \
+	} \
+	T static void dsin_##S(const double *x, double *out, long n) \
+	{ \
+		long i; \
+		for (i = 0; i < n; i++) \
+			out[i] = kSinDeg(x[i]); \
+	} \
+	T static void dcos_##S(const double *x, double *out, long n) \
+	{ \
+		long i; \
+		double s; \
+		for (i = 0; i < n; i++) \
+			kSinCos(x[i], &s, &out[i]); \
+	} \
+	T static void dacos_##S(const double *x, double *out, long n) \
+	{ \
+		long i; \
+		for (i = 0; i < n; i++) \
+			out[i] = kAcosDeg(x[i]); \
+	}
+
+KERN_BUILD(generic, )
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define KERN_X86
+KERN_BUILD(avx2, __attribute__((target("avx2"))))
+KERN_BUILD(avx512, __attribute__((target("avx512f,avx512dq,avx512vl"))))
+#endif
+
+static const struct _ptkern kerns[] =
+{
+#ifdef KERN_X86
+	{"avx512", times_avx512, utc_avx512, dsin_avx512, dcos_avx512, dacos_avx512},
+	{"avx2", times_avx2, utc_avx2, dsin_avx2, dcos_avx2, dacos_avx2},
+#endif
+	{"generic", times_generic, utc_generic, dsin_generic, dcos_generic, dacos_generic}
+};
+
+#define KERNS (sizeof(kerns) / sizeof(kerns[0]))
+
+static const struct _ptkern *kern;
+
+// Whether the CPU runs kernels *k*.
+static int supported(const struct _ptkern *k)
+{
+#ifdef KERN_X86
+	__builtin_cpu_init();
+
+	if (strcmp(k->name, "avx512") == 0)
+		return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")
+			&& __builtin_cpu_supports("avx512vl");
+
+	if (strcmp(k->name, "avx2") == 0)
+		return __builtin_cpu_supports("avx2");
+#endif
+
+	return 1;
+}
+
+// Use the kernels of *name*. Return 0, or -1 when there are none of the
+// name or the CPU cannot run them.
+int ptKernSelect(const char *name)
+{
+	unsigned i;
+
+	for (i = 0; i < KERNS; i++)
+	{
+		if (strcmp(kerns[i].name, name) != 0)
+			continue;
+
+		if (!supported(&kerns[i]))
+			return -1;
+
+		__atomic_store_n(&kern, &kerns[i], __ATOMIC_RELEASE);
+		return 0;
+	}
+
+	return -1;
+}
+
+// The kernels in use, of PT_KERN or else of the best set of the CPU,
+// also when PT_KERN names none it runs. The caller tells of that.
+const struct _ptkern *ptKern(void)
+{
+	const struct _ptkern *k = __atomic_load_n(&kern, __ATOMIC_ACQUIRE);
+	const char *env;
+	unsigned i;
+
+	if (k != 0)
+		return k;
+
+	env = getenv("PT_KERN");
+
+	if (env == 0 || ptKernSelect(env) != 0)
+	{
+		for (i = 0; i < KERNS && !supported(&kerns[i]); i++);
+
+		__atomic_store_n(&kern, &kerns[i < KERNS ? i : KERNS - 1], __ATOMIC_RELEASE);
+	}
+
+	return __atomic_load_n(&kern, __ATOMIC_ACQUIRE);
+}
+
+const struct _ptkern *ptKernAt(int i)
+{
+	unsigned k;
+
+	for (k = 0; k < KERNS; k++)
+	{
+		if (supported(&kerns[k]) && i-- == 0)
+			return &kerns[k];
+	}
+
+	return 0;
+}
+
+int ptKernSame(const struct _ptimes *a, const struct _ptimes *b)
+{
+	return a->imsak_rel_d == b->imsak_rel_d && a->imsak_rel_m == b->imsak_rel_m
+		&& a->fajr_rel_d == b->fajr_rel_d && a->fajr_rel_m == b->fajr_rel_m
+		&& a->dhuhr_rel_m == b->dhuhr_rel_m && a->asr_factor == b->asr_factor
+		&& a->asr_rel_m == b->asr_rel_m && a->maghrib_rel_d == b->maghrib_rel_d
+		&& a->maghrib_rel_m == b->maghrib_rel_m && a->isha_rel_d == b->isha_rel_d
+		&& a->isha_rel_m == b->isha_rel_m && a->midnight_type == b->midnight_type
+		&& a->high_lats == b->high_lats && a->sun_model == b->sun_model;
+}
@@ -0,0 +1,42 @@
+// ptkern.h
+
+#ifndef __PTKERN_H__
+#define __PTKERN_H__
+
+#include "prayertimes.h"
+
+// Kernels over many locations at once, built for several instruction
+// sets. The one of the best set the CPU has is chosen once, or the one
+// named by the PT_KERN environment variable or ptKernSelect().
+struct _ptkern
+{
+	const char *name; // "generic", "avx2" or "avx512"
+
+	// Prayer times of *n* locations *lat*, *lng*, *elv* and *tz* on the date
+	// of *sun*, with the settings of *set* and its model of the Sun. The
+	// times of location i are at out[i * stride + PT_x], and the high_lat_adj
+	// bits of ptCalc() at adj[i] unless *adj* is 0.
+	void (*times)(const struct _ptimes *set, const struct _ptsun *sun, const float *lat, const float *lng,
+		const float *elv, const float *tz, long n, double *out, long stride, short *adj);
+
+	// ptUnixSeconds() of the times *t* of *n* rows of PT_FIELDS, row i of
+	// Julian date jd[i] and time zone tz[i], into *out* of as many.
+	void (*utc)(const double *t, const double *jd, const float *tz, long n, int64_t *out);
+
+	// dm_sin(), dm_cos() and dm_arccos() of *n* values *x* into *out*.
+	void (*dsin)(const double *x, double *out, long n);
+	void (*dcos)(const double *x, double *out, long n);
+	void (*dacos)(const double *x, double *out, long n);
+};
+
+const struct _ptkern *ptKern(void);
+int ptKernSelect(const char *name);
+
+// The *i*-th kernels the CPU runs, of the best set first, 0 past the last.
+const struct _ptkern *ptKernAt(int i);
+
+// Whether *a* and *b* have the same settings, so that ptKern()->times()
+// calculates them together.
+int ptKernSame(const struct _ptimes *a, const struct _ptimes *b);
+
+#endif
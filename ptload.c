@@ -0,0 +1,614 @@
+// ptload.c
+// Prayer times load generator
+// Replays a mix of prayer time queries against the library or a pt
+// server on a Unix domain socket, and reports the throughput and the
+// latency percentiles.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "prayertimes.h"
+#include "ptparse.h"
+#include "ptmethod.h"
+#include "ptfmt.h"
+
+// Notes:
+// 1. A query is a batch record line as of the b option of pt, so the
+//     same queries go to the library or to a server, and a query log is
+//     a batch input file.
+// 2. Locations are drawn from a Zipf distribution over a fixed set of
+//     locations made from the seed. A query is for a day, or for a month
+//     with a given probability, with one of the seven methods.
+// 3. Latencies are counted in a log-linear histogram as of HdrHistogram:
+//     2^LOAD_SUB_BITS buckets for every power of two of nanoseconds, so a
+//     percentile is within 1/2^(LOAD_SUB_BITS - 1) of the latency
+//     measured, from 1ns to over an hour, in fixed memory.
+// 4. On a socket, every thread has a connection with up to a depth of
+//     queries in flight. The latency of a query is from its send() to the
+//     end of its reply, an empty line.
+// 5. The days of a reply from a socket are counted by the lines that start
+//     a record in any output type of the server: a CSV or Unix times line
+//     starts with the id or the date, a JSON line with {, and a text record
+//     with ----yyyy-mm-dd----. Error replies, lines that start with !, are
+//     counted as errors and not as days. The library refuses the records
+//     the server does, so both count the same days and errors.
+//
+
+#define LOAD_SUB_BITS 7
+#define LOAD_SUB (1 << LOAD_SUB_BITS)
+#define LOAD_BUCKETS ((42 - LOAD_SUB_BITS + 1) * (LOAD_SUB / 2) + LOAD_SUB / 2)
+#define LOAD_MAX_THREADS 256
+#define LOAD_MAX_DEPTH 1024
+#define LOAD_LINE 128
+#define LOAD_REPLY (256 << 10)
+#define LOAD_MAX_DAYS 500 // longest date range answered, as SERVE_MAX_DAYS of pt
+
+struct _hist
+{
+	uint64_t n;
+	uint64_t max;
+	uint64_t count[LOAD_BUCKETS];
+};
+
+struct _load
+{
+	long nq;
+	char (*q)[LOAD_LINE];      // queries
+	long nloc;
+	double zipf;
+	double month;    // share of month queries
+	uint64_t seed;
+	int threads;
+	int depth;
+	short out;
+	char *sock;
+	char *record;
+	char *replay;
+};
+
+struct _worker
+{
+	struct _load *l;
+	int k;
+	long days;
+	long errors;
+	struct _hist h;
+};
+
+static uint64_t rnd(uint64_t *s)
+{
+	*s ^= *s >> 12;
+	*s ^= *s << 25;
+	*s ^= *s >> 27;
+
+	return *s * 2685821657736338717ULL;
+}
+
+static double uniform(uint64_t *s)
+{
+	return (double)(rnd(s) >> 11) / 9007199254740992.0;
+}
+
+static uint64_t now(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+static int bucket(uint64_t v)
+{
+	int e = 0;
+
+	while ((v >> e) >= LOAD_SUB)
+		++e;
+
+	return e == 0 ? (int)v : e * (LOAD_SUB / 2) + (int)(v >> e);
+}
+
+// Lowest value of bucket *b*.
+static uint64_t bucketValue(int b)
+{
+	int e = b < LOAD_SUB ? 0 : (b - LOAD_SUB / 2) / (LOAD_SUB / 2);
+
+	return e == 0 ? (uint64_t)b : (uint64_t)(b - e * (LOAD_SUB / 2)) << e;
+}
+
+static void histAdd(struct _hist *h, uint64_t v)
+{
+	int b = bucket(v);
+
+	h->count[b < LOAD_BUCKETS ? b : LOAD_BUCKETS - 1]++;
+	h->n++;
+
+	if (v > h->max)
+		h->max = v;
+}
+
+static void histMerge(struct _hist *h, struct _hist *o)
+{
+	int b;
+
+	for (b = 0; b < LOAD_BUCKETS; b++)
+		h->count[b] += o->count[b];
+
+	h->n += o->n;
+
+	if (o->max > h->max)
+		h->max = o->max;
+}
+
+// Latency at percentile *p*.
+static uint64_t histAt(struct _hist *h, double p)
+{
+	uint64_t want = (uint64_t)(p / 100.0 * (double)h->n + 0.5), sum = 0;
+	int b;
+
+	if (want < 1)
+		want = 1;
+
+	for (b = 0; b < LOAD_BUCKETS; b++)
+	{
+		sum += h->count[b];
+
+		if (sum >= want)
+			return bucketValue(b);
+	}
+
+	return h->max;
+}
+
+// Make the query mix of *l*, written to the query log when asked for.
+static int generate(struct _load *l)
+{
+	static const short mdays[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31}; // of 2024, a leap year
+	uint64_t s = l->seed, ls;
+	double *cdf, sum = 0.0, u, lat, lng;
+	long i, lo, hi, mid, loc;
+	short m, d;
+
+	cdf = malloc(sizeof(double) * l->nloc);
+
+	if (cdf == 0)
+		return -1;
+
+	for (i = 0; i < l->nloc; i++)
+	{
+		sum += 1.0 / pow((double)(i + 1), l->zipf);
+		cdf[i] = sum;
+	}
+
+	for (i = 0; i < l->nq; i++)
+	{
+		u = uniform(&s) * sum;
+
+		for (lo = 0, hi = l->nloc - 1; lo < hi;)
+		{
+			mid = (lo + hi) / 2;
+
+			if (cdf[mid] < u)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		// the location of a rank is the same for a seed
+		loc = lo;
+		ls = l->seed ^ ((uint64_t)(loc + 1) * 0x9E3779B97F4A7C15ULL);
+		rnd(&ls);
+		lat = uniform(&ls) * 120.0 - 60.0;
+		lng = uniform(&ls) * 360.0 - 180.0;
+
+		m = (short)(rnd(&s) % 12);
+
+		if (uniform(&s) < l->month)
+			snprintf(l->q[i], LOAD_LINE, "%ld,%.4f,%.4f,0,%d,%d,2024-%02d-01,2024-%02d-%02d",
+				loc, lat, lng, (int)(lng / 15.0), (int)(rnd(&s) % 7) + 1, m + 1, m + 1, mdays[m]);
+		else
+		{
+			d = (short)(rnd(&s) % mdays[m]) + 1;
+			snprintf(l->q[i], LOAD_LINE, "%ld,%.4f,%.4f,0,%d,%d,2024-%02d-%02d",
+				loc, lat, lng, (int)(lng / 15.0), (int)(rnd(&s) % 7) + 1, m + 1, d);
+		}
+	}
+
+	free(cdf);
+
+	return 0;
+}
+
+// Write the queries of *l* to *path*.
+static int record(struct _load *l, const char *path)
+{
+	FILE *f = fopen(path, "w");
+	long i;
+
+	if (f == 0)
+		return -1;
+
+	for (i = 0; i < l->nq; i++)
+		fprintf(f, "%s\n", l->q[i]);
+
+	return fclose(f);
+}
+
+// Read the queries of *l* from *path*, every line a query.
+static int replay(struct _load *l, const char *path)
+{
+	FILE *f = fopen(path, "r");
+	char line[LOAD_LINE];
+	long n = 0, size = 1024;
+	size_t k;
+	void *p;
+
+	if (f == 0)
+		return -1;
+
+	l->q = malloc(sizeof(*(l->q)) * size);
+
+	while (l->q != 0 && fgets(line, sizeof(line), f) != 0)
+	{
+		k = strcspn(line, "\r\n");
+
+		if (line[k] == '\0' && !feof(f)) // too long, drop the rest
+		{
+			while (fgets(line, sizeof(line), f) != 0 && line[strlen(line) - 1] != '\n');
+			continue;
+		}
+
+		line[k] = '\0';
+
+		if (n == size)
+		{
+			size *= 2;
+			p = realloc(l->q, sizeof(*(l->q)) * size);
+
+			if (p == 0)
+			{
+				free(l->q);
+				l->q = 0;
+				break;
+			}
+
+			l->q = p;
+		}
+
+		memcpy(l->q[n++], line, k + 1);
+	}
+
+	fclose(f);
+	l->nq = n;
+
+	return l->q == 0 ? -1 : 0;
+}
+
+// Answer query *q* with the library into *out*, as the server would.
+// Return the number of days.
+static long answer(struct _load *l, const char *q, char *out, struct _ptimes *def)
+{
+	struct _ptrec r;
+	struct _ptimes pt;
+	struct _ptfmt f;
+	double jd, last;
+	long days = 0;
+	short y, m, d;
+
+	if (ptParseRecord(q, q + strlen(q), &r) != 1)
+		return -1;
+
+	pt = *def;
+
+	// a range the server refuses is an error here too
+	if (ptSetRecord(&pt, &r, LOAD_MAX_DAYS, &last) != 0 || last - pt.jd + 1.0 > LOAD_MAX_DAYS)
+		return -1;
+
+	ptFmtInit(&f, out, LOAD_REPLY, -1);
+
+	for (jd = pt.jd; jd <= last; jd += 1.0, ++days)
+	{
+		gregorian(jd, &y, &m, &d);
+		ptSetDate(&pt, y, m, d);
+		pt.phase = 0;
+
+		while (ptCalc(&pt) != 0);
+
+		ptFmtTimes(&f, &pt, l->out, r.has & PTREC_ID ? &(r.id) : 0);
+	}
+
+	return days;
+}
+
+// Run the queries of worker *arg* on the library.
+static void *runLibrary(void *arg)
+{
+	struct _worker *w = arg;
+	struct _load *l = w->l;
+	struct _ptimes def;
+	char *out = malloc(LOAD_REPLY);
+	uint64_t t;
+	long i, n;
+
+	ptInit(&def);
+	ptSetDate(&def, 2024, 1, 1);
+
+	for (i = w->k; out != 0 && i < l->nq; i += l->threads)
+	{
+		t = now();
+		n = answer(l, l->q[i], out, &def);
+		histAdd(&(w->h), now() - t);
+
+		if (n < 0)
+			w->errors++;
+		else
+			w->days += n;
+	}
+
+	free(out);
+
+	return 0;
+}
+
+// Run the queries of worker *arg* on a connection to the server, keeping
+// up to the depth of queries in flight.
+// Whether a reply line starting with the *n* bytes of *s*, up to 5, starts
+// a record, see note 5.
+static int dayLine(const char *s, long n)
+{
+	if (n > 0 && (*s == '{' || (*s >= '0' && *s <= '9')))
+		return 1;
+
+	if (n > 1 && *s == '-' && s[1] >= '0' && s[1] <= '9') // a negative id
+		return 1;
+
+	return n > 4 && memcmp(s, "----", 4) == 0 && s[4] >= '0' && s[4] <= '9';
+}
+
+static void *runSocket(void *arg)
+{
+	struct _worker *w = arg;
+	struct _load *l = w->l;
+	struct sockaddr_un a;
+	uint64_t sent[LOAD_MAX_DEPTH];
+	char buf[1 << 16], req[LOAD_LINE + 1], first[5];
+	long next = w->k, head = 0, tail = 0, line = 0;
+	ssize_t n, k, i;
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	memset(&a, 0, sizeof(a));
+	a.sun_family = AF_UNIX;
+	strncpy(a.sun_path, l->sock, sizeof(a.sun_path) - 1);
+
+	if (fd < 0 || connect(fd, (struct sockaddr *)&a, sizeof(a)) != 0)
+	{
+		fprintf(stderr, "ptload: cannot connect to %s\n", l->sock);
+		w->errors += l->nq;
+		return 0;
+	}
+
+	while (next < l->nq || head < tail)
+	{
+		// send up to the depth
+		while (next < l->nq && tail - head < l->depth)
+		{
+			k = (ssize_t)strlen(l->q[next]);
+			memcpy(req, l->q[next], k);
+			req[k++] = '\n';
+			sent[tail % l->depth] = now();
+
+			for (i = 0; i < k; i += n)
+			{
+				n = send(fd, req + i, k - i, MSG_NOSIGNAL);
+
+				if (n <= 0 && errno != EINTR)
+					goto lost;
+
+				if (n < 0)
+					n = 0;
+			}
+
+			++tail;
+			next += l->threads;
+		}
+
+		n = read(fd, buf, sizeof(buf));
+
+		if (n < 0 && errno == EINTR)
+			continue;
+
+		if (n <= 0)
+			goto lost;
+
+		// a reply ends with an empty line
+		for (i = 0; i < n; i++)
+		{
+			if (buf[i] != '\n')
+			{
+				if (line < (long)sizeof(first))
+					first[line] = buf[i];
+
+				if (line++ == 0 && buf[i] == '!')
+					w->errors++;
+
+				continue;
+			}
+
+			if (line > 0)
+			{
+				w->days += dayLine(first, line < (long)sizeof(first) ? line : (long)sizeof(first));
+				line = 0;
+				continue;
+			}
+
+			histAdd(&(w->h), now() - sent[head % l->depth]);
+			++head;
+		}
+	}
+
+	close(fd);
+
+	return 0;
+
+lost:
+	fprintf(stderr, "ptload: connection lost\n");
+	w->errors += tail - head;
+	close(fd);
+
+	return 0;
+}
+
+static void help(void)
+{
+	printf("PRAYER TIMES LOAD GENERATOR\n\n");
+	printf("USAGE:\n");
+	printf("\tptload <options>\n\n");
+	printf("\toptions:\n");
+	printf("\tn <queries>      100000 by default\n");
+	printf("\tl <locations>    10000 by default\n");
+	printf("\tz <zipf>         Zipf exponent of the locations, 1.0 by default\n");
+	printf("\tm <share>        share of month queries, 0.2 by default\n");
+	printf("\ts <seed>         of the query mix\n");
+	printf("\tt <threads>      1 by default\n");
+	printf("\tu <socket>       query a pt server, the library by default\n");
+	printf("\td <depth>        queries in flight a connection, 1 by default\n");
+	printf("\to <output type>  of the library, as of pt, 1 by default\n");
+	printf("\tw <file>         record the queries to a log\n");
+	printf("\tr <file>         replay the queries of a log\n");
+	printf("\n");
+	printf("\tExample: pt u /tmp/pt.sock j 2 &\n");
+	printf("\t         ptload u /tmp/pt.sock t 4 d 8 n 1000000\n\n");
+}
+
+int main(int argc, char *argv[])
+{
+	static const double pcts[] = {50.0, 90.0, 99.0, 99.9};
+	static const char *names[] = {"p50", "p90", "p99", "p999"};
+	static struct _load l;
+	struct _worker *w;
+	pthread_t th[LOAD_MAX_THREADS];
+	struct _hist *h;
+	uint64_t t0, el;
+	long errors = 0, days = 0;
+	int i, started;
+
+	l.nq = 100000;
+	l.nloc = 10000;
+	l.zipf = 1.0;
+	l.month = 0.2;
+	l.seed = 88172645463325252ULL;
+	l.threads = 1;
+	l.depth = 1;
+	l.out = PTFMT_CSV;
+
+	if (argc < 2)
+	{
+		help();
+		return 0;
+	}
+
+	for (i = 1; i + 1 < argc; i += 2)
+	{
+		switch (argv[i][0] != '\0' && argv[i][1] == '\0' ? argv[i][0] : 0)
+		{
+			case 'n': l.nq = atol(argv[i + 1]); break;
+			case 'l': l.nloc = atol(argv[i + 1]); break;
+			case 'z': l.zipf = atof(argv[i + 1]); break;
+			case 'm': l.month = atof(argv[i + 1]); break;
+			case 's': l.seed = strtoull(argv[i + 1], 0, 10) | 1; break;
+			case 't': l.threads = atoi(argv[i + 1]); break;
+			case 'u': l.sock = argv[i + 1]; break;
+			case 'd': l.depth = atoi(argv[i + 1]); break;
+			case 'o': l.out = (short)atoi(argv[i + 1]); break;
+			case 'w': l.record = argv[i + 1]; break;
+			case 'r': l.replay = argv[i + 1]; break;
+			default: help(); return 1;
+		}
+	}
+
+	if (l.nq < 1 || l.nloc < 1 || l.threads < 1 || l.threads > LOAD_MAX_THREADS
+		|| l.depth < 1 || l.depth > LOAD_MAX_DEPTH || l.out < 0 || l.out > PTFMT_JSON)
+	{
+		help();
+		return 1;
+	}
+
+	if (l.replay != 0)
+	{
+		if (replay(&l, l.replay) != 0)
+		{
+			fprintf(stderr, "ptload: cannot read %s\n", l.replay);
+			return 1;
+		}
+	}
+	else
+	{
+		l.q = malloc(sizeof(*(l.q)) * l.nq);
+
+		if (l.q == 0 || generate(&l) != 0)
+		{
+			fprintf(stderr, "ptload: out of memory\n");
+			return 1;
+		}
+	}
+
+	if (l.record != 0 && record(&l, l.record) != 0)
+	{
+		fprintf(stderr, "ptload: cannot write %s\n", l.record);
+		return 1;
+	}
+
+	w = calloc(l.threads, sizeof(struct _worker));
+	h = calloc(1, sizeof(struct _hist));
+
+	if (w == 0 || h == 0)
+	{
+		fprintf(stderr, "ptload: out of memory\n");
+		return 1;
+	}
+
+	t0 = now();
+
+	for (started = 0; started < l.threads; started++)
+	{
+		w[started].l = &l;
+		w[started].k = started;
+
+		if (pthread_create(&th[started], 0, l.sock != 0 ? runSocket : runLibrary, &w[started]) != 0)
+			break;
+	}
+
+	for (i = 0; i < started; i++)
+	{
+		pthread_join(th[i], 0);
+		histMerge(h, &(w[i].h));
+		errors += w[i].errors;
+		days += w[i].days;
+	}
+
+	el = now() - t0;
+
+	printf("queries  %ld\n", l.nq);
+	printf("days     %ld\n", days);
+	printf("errors   %ld\n", errors);
+	printf("threads  %d%s\n", started, l.sock != 0 ? " (socket)" : " (library)");
+	printf("seconds  %.3f\n", (double)el / 1e9);
+	printf("rate     %.0f queries/s\n", (double)h->n / ((double)el / 1e9));
+
+	for (i = 0; i < 4; i++)
+		printf("%-8s %.3f us\n", names[i], (double)histAt(h, pcts[i]) / 1e3);
+
+	printf("max      %.3f us\n", (double)h->max / 1e3);
+
+	return errors > 0;
+}
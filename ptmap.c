@@ -0,0 +1,151 @@
+// ptmap.c
+// Memory-mapped batch input
+// Maps a file of batch records and parses it in place, a window of
+// newline-aligned chunks at a time on the threads of a pool.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ptmap.h"
+
+// Notes:
+// 1. A chunk ends at the end of the line PTMAP_CHUNK bytes from its start,
+//     so no line is split and no line is copied. A line longer than the
+//     chunk makes a longer chunk.
+// 2. The records of every chunk of a window are parsed in parallel into
+//     the chunk, then taken by the caller in the order of the file. The
+//     caller parses the rest of a chunk past *stop* itself, which only
+//     happens for lines shorter than PTMAP_CHUNK / PTMAP_CHUNK_RECS bytes
+//     on average.
+// 3. The kernel is told the mapping is read in sequence and the window
+//     after the current one is asked for ahead, so the disk keeps reading
+//     while the threads parse.
+//
+
+// Parse chunk *task* of the window of *arg*.
+static void parseTask(void *arg, long task, int worker)
+{
+	struct _ptmap *m = arg;
+	struct _ptmap_chunk *c = &(m->chunk[task]);
+	struct _ptmap_rec *r;
+	const char *s = c->s, *eol;
+
+	c->lines = 0;
+	c->n = 0;
+
+	while (s < c->e && c->n < PTMAP_CHUNK_RECS)
+	{
+		eol = memchr(s, '\n', c->e - s);
+
+		if (eol == 0)
+			eol = c->e;
+
+		++(c->lines);
+		r = &(c->rec[c->n]);
+		r->ok = (short)ptParseRecord(s, eol, &(r->r));
+
+		if (r->ok != 0)
+		{
+			r->line = c->lines;
+			++(c->n);
+		}
+
+		s = eol + 1;
+	}
+
+	c->stop = s < c->e ? s : c->e;
+}
+
+// Map batch input *path*. Return 0 on success, -1 when it cannot be opened
+// or is not a regular file, i.e. a pipe to be read instead.
+int ptMapOpen(struct _ptmap *m, const char *path)
+{
+	struct stat st;
+	void *p;
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+	{
+		close(fd);
+		return -1;
+	}
+
+	m->p = 0;
+	m->size = (size_t)st.st_size;
+	m->nchunks = 0;
+
+	if (m->size > 0)
+	{
+		p = mmap(0, m->size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (p == MAP_FAILED)
+		{
+			close(fd);
+			return -1;
+		}
+
+		m->p = p;
+		posix_madvise(p, m->size, POSIX_MADV_SEQUENTIAL);
+	}
+
+	close(fd); // the mapping stays
+
+	m->at = m->p;
+
+	return 0;
+}
+
+// Parse the next window of the mapping on *pool*.
+// Return its number of chunks, 0 at the end.
+long ptMapParse(struct _ptmap *m, struct _ptpool *pool)
+{
+	const char *e = m->p + m->size, *s = m->at, *c;
+	size_t ahead;
+	long n = 0;
+
+	while (s < e && n < PTMAP_TASKS)
+	{
+		c = (size_t)(e - s) > PTMAP_CHUNK ? s + PTMAP_CHUNK : e;
+
+		if (c < e)
+		{
+			c = memchr(c - 1, '\n', e - (c - 1));
+			c = c == 0 ? e : c + 1;
+		}
+
+		m->chunk[n].s = s;
+		m->chunk[n].e = c;
+		++n;
+		s = c;
+	}
+
+	m->at = s;
+	m->nchunks = n;
+
+	if (s < e) // read the next window ahead
+	{
+		ahead = (size_t)(e - s) < (size_t)PTMAP_CHUNK * PTMAP_TASKS ? (size_t)(e - s) : (size_t)PTMAP_CHUNK * PTMAP_TASKS;
+		posix_madvise((void *)((size_t)s & ~(size_t)(sysconf(_SC_PAGESIZE) - 1)), ahead, POSIX_MADV_WILLNEED);
+	}
+
+	if (n > 0)
+		ptPoolRun(pool, n, parseTask, m);
+
+	return n;
+}
+
+void ptMapClose(struct _ptmap *m)
+{
+	if (m->p != 0)
+		munmap((void *)m->p, m->size);
+
+	m->p = 0;
+	m->size = 0;
+}
@@ -0,0 +1,49 @@
+// ptmap.h
+
+#ifndef __PTMAP_H__
+#define __PTMAP_H__
+
+#include <stddef.h>
+#include "ptparse.h"
+#include "ptpool.h"
+
+// A window of the mapping is parsed as PTMAP_TASKS chunks in parallel.
+#define PTMAP_CHUNK (32 << 10) // bytes of a chunk, up to the end of its last line
+#define PTMAP_CHUNK_RECS 1024  // records of a chunk parsed in parallel
+#define PTMAP_TASKS 32
+
+// A parsed line of a chunk.
+struct _ptmap_rec
+{
+	struct _ptrec r;
+	long line;  // line number in the chunk, from 1
+	short ok;   // 1 for a record, -1 when not valid
+};
+
+// Lines [s, e) of the mapping. Lines from *stop* on did not fit *rec* and
+// are left to the caller.
+struct _ptmap_chunk
+{
+	const char *s;
+	const char *e;
+	const char *stop;
+	long lines; // lines before *stop*
+	long n;
+	struct _ptmap_rec rec[PTMAP_CHUNK_RECS];
+};
+
+// A file of batch records mapped into memory and parsed in place.
+struct _ptmap
+{
+	const char *p;
+	size_t size;
+	const char *at; // start of the next window
+	long nchunks;
+	struct _ptmap_chunk chunk[PTMAP_TASKS];
+};
+
+int ptMapOpen(struct _ptmap *m, const char *path);
+long ptMapParse(struct _ptmap *m, struct _ptpool *pool);
+void ptMapClose(struct _ptmap *m);
+
+#endif
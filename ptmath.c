@@ -0,0 +1,1508 @@
+// ptmath.c
+// Math routines benchmark
+// Sweeps every math routine of the library over its domain, measures its
+// error against long double libm and its speed, with the hardware
+// counters of the CPU where the kernel allows.
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE // syscall()
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#include "prayertimes.h"
+#include "ptkern.h"
+#include "ptgrid.h"
+#include "ptres.h"
+#include "ptindex.h"
+#include "ptsched.h"
+#include "ptfmt.h"
+#include "ptsnap.h"
+#include "suncurve.h"
+
+// Notes:
+// 1. The inputs of a routine are spread evenly over its domain with a
+//     random jitter inside each step, from a fixed seed, so runs compare.
+// 2. The error of a result is in ulps of the reference rounded to double,
+//     the distance to the next double away from zero. A NAN where the
+//     reference has none, or the other way round, is counted on its own
+//     and reported as the worst input.
+// 3. The timing calls a routine over the inputs in a loop a few times
+//     and keeps the fastest pass, so page faults and the first cache
+//     misses are left out. The loop and the sum kept of the results are
+//     counted in, the same for every routine.
+// 4. Cycles, instructions and branch misses are read from
+//     perf_event_open() for user space only. They are shown as - when the
+//     kernel refuses, i.e. in a container or for perf_event_paranoid > 2.
+// 5. The models of the position of the Sun are swept over the Julian dates
+//     of 1950 to 2050 against the NOAA series in long double. That is the
+//     error of each model against the best one of the library, whose own
+//     error against the ephemerides is about 0.01 degree (Meeus ch. 25).
+// 6. The kernels of ptkern.c are timed over locations spread over the
+//     globe on one date, against ptCalc() of every location, and every
+//     time they give is compared to the one of ptCalc() bit for bit.
+// 7. The compact results of ptGridRunRes() are checked against ptCalc()
+//     over locations spread over the globe for RES_DAYS days: every
+//     result the same as ptResSet() of ptCalc() gives, every time within
+//     half a unit, 15 seconds by default, and a high latitude bit set
+//     exactly for the times that ptCalc() with HIGHLAT_NONE gives
+//     otherwise. ptmath fails when any is not.
+// 8. The Sun curve of suncurve.c is sampled every minute of a day at
+//     locations and dates spread over the globe and the years, against
+//     dm_cos() and dm_sin() of the hour angle of every sample. ptmath
+//     fails when a sample is off by more than CURVE_BOUND, the drift of
+//     note 2 of suncurve.c with the error of the anchors.
+// 9. The reverse index of ptindex.c is built from a day of ptGridRun()
+//     over locations spread over the globe, and every range query and
+//     every step of a sweep through the day is compared to a linear scan
+//     of the times: the same count, every entry in the window, with the
+//     time of its location, and in (time, id) order. ptmath fails when
+//     any is not.
+// 10. The scheduler of ptsched.c replays SCHED_DAYS days of subscribers
+//     spread over the globe on its simulated clock, the first hours paced
+//     by ptSchedRun() and the rest in steps of ptSchedAdvance(). Every
+//     enabled event of ptCalc() for the dates of a subscriber has to fire
+//     exactly once, at its time, and in time and field order. Every tenth
+//     subscriber removes itself from the callback after a few events and
+//     must not fire again. ptmath fails when any is not so.
+// 11. The numbers of the text output of ptfmt.c are compared to snprintf()
+//     %14.6f for random float bit patterns below PTFMT_FIXED_MAX, NAN and
+//     infinity included, and for random multiples of 2^-7, ties of the six
+//     decimals half of the time. ptmath fails on any difference.
+// 12. The snapshots of ptsnap.c are read by SNAP_READERS threads while
+//     the main thread rolls them over SNAP_DAYS days, with the manager
+//     thread calculating ahead. Every lookup is compared to ptCalc() of
+//     its location for the date of the day the reader entered, once right
+//     away and again after a lookup of another location, so a day freed
+//     under a reader shows. At the end, with no reader left, every day
+//     retired has to be freed. ptmath fails when any is not so.
+//
+
+#define MATH_BUCKETS 24 // of the ulp histogram: 0, 0.5, 1, 2, 4 ... 2^20, more
+#define RES_DAYS 40 // of the compact results check
+#define CURVE_SAMPLES 1440 // of a day of the Sun curve check, every minute
+#define CURVE_BOUND 2e-14
+#define INDEX_QUERIES 1000 // windows of the index check per field
+#define INDEX_PER_LOC 100 // points of n per location of the index check
+#define INDEX_THREADS 4 // sorting threads, merged even on one CPU
+#define SCHED_DAYS 30 // replayed by the scheduler check
+#define SCHED_PER_SUB 1000 // points of n per subscriber of the scheduler check
+#define SCHED_KEEP 5 // events before a removed subscriber removes itself
+#define FMT_PER_REC 4 // numbers of a record of the text output
+#define SNAP_DAYS 60 // rolled over by the snapshot check
+#define SNAP_READERS 4
+#define SNAP_PER_LOC 1000 // points of n per location of the snapshot check
+
+typedef double (*math_fn1)(double x);
+typedef double (*math_fn2)(double y, double x);
+typedef long double (*math_ref1)(long double x);
+typedef long double (*math_ref2)(long double y, long double x);
+
+struct _routine
+{
+	const char *name;
+	math_fn1 fn1;
+	math_fn2 fn2; // of two arguments, y in [lo, hi], x in [lo2, hi2]
+	math_ref1 ref1;
+	math_ref2 ref2;
+	double lo;
+	double hi;
+	double lo2;
+	double hi2;
+};
+
+struct _result
+{
+	long count[MATH_BUCKETS];
+	long nan; // NAN against a number or the other way round
+	double max_ulp;
+	double max_abs;
+	double worst;  // input of max_ulp
+	double worst2;
+	double ns;     // per call
+	double cycles; // per call, below 0 when not counted
+	double instructions;
+	double branch_misses;
+};
+
+static volatile double sink; // of the timed results
+
+// Sine of *d* degrees plus *q* quarter turns. The degrees are reduced to
+// [-45, 45] first, exactly, as the radians of a large *d* would be off.
+static long double dmRef(long double d, int q)
+{
+	long double k = nearbyintl(d / 90.0L);
+
+	d = (d - k * 90.0L) * 3.14159265358979323846264338327950288L / 180.0L;
+
+	switch (((long)k + q) & 3)
+	{
+		case 0: return sinl(d);
+		case 1: return cosl(d);
+		case 2: return -sinl(d);
+	}
+
+	return -cosl(d);
+}
+
+static long double dmSinRef(long double d)
+{
+	return dmRef(d, 0);
+}
+
+static long double dmCosRef(long double d)
+{
+	return dmRef(d, 1);
+}
+
+static const struct _routine routines[] =
+{
+	{"p_sin", p_sin, 0, sinl, 0, -1e4, 1e4, 0.0, 0.0},
+	{"p_cos", p_cos, 0, cosl, 0, -1e4, 1e4, 0.0, 0.0},
+	{"p_tan", p_tan, 0, tanl, 0, -1e4, 1e4, 0.0, 0.0},
+	{"p_asin", p_asin, 0, asinl, 0, -1.0, 1.0, 0.0, 0.0},
+	{"p_acos", p_acos, 0, acosl, 0, -1.0, 1.0, 0.0, 0.0},
+	{"p_atan", p_atan, 0, atanl, 0, -1e3, 1e3, 0.0, 0.0},
+	{"p_atan2", 0, p_atan2, 0, atan2l, -10.0, 10.0, -10.0, 10.0},
+	{"p_sqrt", p_sqrt, 0, sqrtl, 0, 0.0, 1e6, 0.0, 0.0},
+	{"p_floor", p_floor, 0, floorl, 0, -1e6, 1e6, 0.0, 0.0},
+	{"dm_sin", dm_sin, 0, dmSinRef, 0, -1e5, 1e5, 0.0, 0.0},
+	{"dm_cos", dm_cos, 0, dmCosRef, 0, -1e5, 1e5, 0.0, 0.0},
+};
+
+#define ROUTINES (sizeof(routines) / sizeof(routines[0]))
+
+static uint64_t rnd(uint64_t *s)
+{
+	*s ^= *s >> 12;
+	*s ^= *s << 25;
+	*s ^= *s >> 27;
+
+	return *s * 2685821657736338717ULL;
+}
+
+static double uniform(uint64_t *s)
+{
+	return (double)(rnd(s) >> 11) / 9007199254740992.0;
+}
+
+static uint64_t now(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+// Counters of the calling thread, a group led by the cycles.
+struct _counters
+{
+	int fd[3];
+};
+
+static void countersOpen(struct _counters *c)
+{
+#ifdef __linux__
+	static const uint64_t config[3] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES};
+	struct perf_event_attr a;
+	int i;
+
+	for (i = 0; i < 3; i++)
+	{
+		memset(&a, 0, sizeof(a));
+		a.type = PERF_TYPE_HARDWARE;
+		a.size = sizeof(a);
+		a.config = config[i];
+		a.disabled = i == 0;
+		a.exclude_kernel = 1;
+		a.exclude_hv = 1;
+		a.read_format = PERF_FORMAT_GROUP;
+		c->fd[i] = (int)syscall(__NR_perf_event_open, &a, 0, -1, i == 0 ? -1 : c->fd[0], 0);
+
+		if (c->fd[i] < 0)
+			break;
+	}
+
+	for (; i < 3; i++)
+		c->fd[i] = -1;
+#else
+	c->fd[0] = c->fd[1] = c->fd[2] = -1;
+#endif
+}
+
+static void countersStart(struct _counters *c)
+{
+#ifdef __linux__
+	if (c->fd[0] >= 0)
+	{
+		ioctl(c->fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(c->fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+#endif
+}
+
+// Stop the counters and read them into *v*. Return how many were read.
+static int countersStop(struct _counters *c, uint64_t *v)
+{
+	uint64_t g[4];
+	int n = 0;
+
+#ifdef __linux__
+	if (c->fd[0] >= 0)
+	{
+		ioctl(c->fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+		if (read(c->fd[0], g, sizeof(g)) >= (ssize_t)sizeof(uint64_t))
+		{
+			for (n = 0; n < (int)g[0] && n < 3; n++)
+				v[n] = g[n + 1];
+		}
+	}
+#endif
+
+	return n;
+}
+
+// Ulps of double *x* from *ref*.
+static double ulps(double x, long double ref)
+{
+	double r = (double)ref, u;
+
+	if (isinf(r))
+		return x == r ? 0.0 : INFINITY;
+
+	u = nextafter(fabs(r), INFINITY) - fabs(r);
+
+	return (double)(fabsl((long double)x - ref) / (long double)u);
+}
+
+static int bucket(double e)
+{
+	int b = 1;
+
+	if (e == 0.0)
+		return 0;
+
+	for (e *= 2.0; e > 1.0 && b < MATH_BUCKETS - 1; e /= 2.0)
+		++b;
+
+	return b;
+}
+
+// Measure the error of routine *r* at the *n* inputs *x*, *y*.
+static void accuracy(const struct _routine *r, const double *x, const double *y, long n, struct _result *res)
+{
+	long double ref;
+	double v, e;
+	long i;
+
+	for (i = 0; i < n; i++)
+	{
+		if (r->fn1 != 0)
+		{
+			v = r->fn1(x[i]);
+			ref = r->ref1(x[i]);
+		}
+		else
+		{
+			v = r->fn2(y[i], x[i]);
+			ref = r->ref2(y[i], x[i]);
+		}
+
+		if (isnan(v) || isnan((double)ref))
+		{
+			if (isnan(v) != isnan((double)ref))
+			{
+				if (res->nan++ == 0)
+				{
+					res->worst = r->fn1 != 0 ? x[i] : y[i];
+					res->worst2 = x[i];
+				}
+
+				res->max_ulp = INFINITY;
+			}
+			else
+				res->count[0]++;
+
+			continue;
+		}
+
+		e = ulps(v, ref);
+		res->count[bucket(e)]++;
+
+		if (e > res->max_ulp)
+		{
+			res->max_ulp = e;
+			res->worst = r->fn1 != 0 ? x[i] : y[i];
+			res->worst2 = x[i];
+		}
+
+		if (fabs((double)((long double)v - ref)) > res->max_abs)
+			res->max_abs = fabs((double)((long double)v - ref));
+	}
+}
+
+// Time routine *r* over the *n* inputs *x*, *y*, best of *repeats* passes.
+static void speed(const struct _routine *r, const double *x, const double *y, long n, int repeats, struct _result *res)
+{
+	struct _counters c;
+	uint64_t t, best = UINT64_MAX, v[3], bv[3];
+	double s;
+	long i;
+	int k, got = 0, best_got = 0;
+
+	countersOpen(&c);
+
+	for (k = 0; k < repeats; k++)
+	{
+		s = 0.0;
+		countersStart(&c);
+		t = now();
+
+		if (r->fn1 != 0)
+		{
+			for (i = 0; i < n; i++)
+				s += r->fn1(x[i]);
+		}
+		else
+		{
+			for (i = 0; i < n; i++)
+				s += r->fn2(y[i], x[i]);
+		}
+
+		t = now() - t;
+		got = countersStop(&c, v);
+		sink = s;
+
+		if (t < best)
+		{
+			best = t;
+			best_got = got;
+			memcpy(bv, v, sizeof(v));
+		}
+	}
+
+	for (k = 0; k < 3; k++)
+	{
+		if (c.fd[k] >= 0)
+			close(c.fd[k]);
+	}
+
+	res->ns = (double)best / (double)n;
+	res->cycles = best_got > 0 ? (double)bv[0] / (double)n : -1.0;
+	res->instructions = best_got > 1 ? (double)bv[1] / (double)n : -1.0;
+	res->branch_misses = best_got > 2 ? (double)bv[2] / (double)n : -1.0;
+}
+
+#define SUN_JD0 2433282.5 // 1950-01-01
+#define SUN_JD1 2469807.5 // 2050-01-01
+
+struct _model
+{
+	const char *name;
+	short model;
+};
+
+static const struct _model models[] =
+{
+	{"NOAA", PT_SUN_NOAA},
+	{"USNO", PT_SUN_USNO},
+	{"LITE", PT_SUN_LITE},
+};
+
+#define MODELS (sizeof(models) / sizeof(models[0]))
+
+// Declination and equation of time at *jd*, as of sunPositionNoaa().
+static void sunRef(long double jd, long double *decl, long double *eqt)
+{
+	const long double dtr = 3.14159265358979323846264338327950288L / 180.0L;
+	long double T, L0, M, ecc, C, omega, L, e, y, E;
+
+	T = (jd - 2451545.0L) / 36525.0L;
+	L0 = fmodl(280.46646L + T * (36000.76983L + T * 0.0003032L), 360.0L) * dtr;
+	M = fmodl(357.52911L + T * (35999.05029L - T * 0.0001537L), 360.0L) * dtr;
+	ecc = 0.016708634L - T * (0.000042037L + T * 0.0000001267L);
+	C = sinl(M) * (1.914602L - T * (0.004817L + T * 0.000014L))
+		+ sinl(2.0L * M) * (0.019993L - T * 0.000101L) + sinl(3.0L * M) * 0.000289L;
+	omega = (125.04L - 1934.136L * T) * dtr;
+	L = L0 + (C - 0.00569L - 0.00478L * sinl(omega)) * dtr;
+	e = (23.0L + (26.0L + (21.448L - T * (46.815L + T * (0.00059L - T * 0.001813L))) / 60.0L) / 60.0L
+		+ 0.00256L * cosl(omega)) * dtr;
+
+	*decl = asinl(sinl(e) * sinl(L)) / dtr;
+
+	y = tanl(e / 2.0L);
+	y *= y;
+	E = y * sinl(2.0L * L0) - 2.0L * ecc * sinl(M) + 4.0L * ecc * y * sinl(M) * cosl(2.0L * L0)
+		- 0.5L * y * y * sinl(4.0L * L0) - 1.25L * ecc * ecc * sinl(2.0L * M);
+	*eqt = E / dtr / 15.0L;
+}
+
+// Measure Sun position *model* over the *n* Julian dates *x*, its error
+// against sunRef() and its speed, best of *repeats* passes.
+static void sunModel(pt_sun_model model, const double *x, long n, int repeats, struct _result *res)
+{
+	struct _counters c;
+	uint64_t t, best = UINT64_MAX, v[3], bv[3];
+	long double rd, re;
+	double decl, eqt, s;
+	long i;
+	int k, got = 0, best_got = 0;
+
+	for (i = 0; i < n; i++)
+	{
+		model(x[i], &decl, &eqt);
+		sunRef(x[i], &rd, &re);
+
+		if (fabs((double)(decl - rd)) * 3600.0 > res->max_ulp) // arcseconds
+		{
+			res->max_ulp = fabs((double)(decl - rd)) * 3600.0;
+			res->worst = x[i];
+		}
+
+		if (fabs((double)(eqt - re)) * 3600.0 > res->max_abs) // seconds
+		{
+			res->max_abs = fabs((double)(eqt - re)) * 3600.0;
+			res->worst2 = x[i];
+		}
+	}
+
+	countersOpen(&c);
+
+	for (k = 0; k < repeats; k++)
+	{
+		s = 0.0;
+		countersStart(&c);
+		t = now();
+
+		for (i = 0; i < n; i++)
+		{
+			model(x[i], &decl, &eqt);
+			s += decl + eqt;
+		}
+
+		t = now() - t;
+		got = countersStop(&c, v);
+		sink = s;
+
+		if (t < best)
+		{
+			best = t;
+			best_got = got;
+			memcpy(bv, v, sizeof(v));
+		}
+	}
+
+	for (k = 0; k < 3; k++)
+	{
+		if (c.fd[k] >= 0)
+			close(c.fd[k]);
+	}
+
+	res->ns = (double)best / (double)n;
+	res->cycles = best_got > 0 ? (double)bv[0] / (double)n : -1.0;
+	res->instructions = best_got > 1 ? (double)bv[1] / (double)n : -1.0;
+	res->branch_misses = best_got > 2 ? (double)bv[2] / (double)n : -1.0;
+}
+
+// Measure kernels *k* over the *n* locations *lat*, *lng* and *elv* of
+// *set* against the times *ref* of ptCalc(), best of *repeats* passes.
+static void kernel(const struct _ptkern *k, const struct _ptimes *set, const struct _ptsun *sun, const float *lat,
+	const float *lng, const float *elv, const float *tz, const double *ref, double *out, long n, int repeats,
+	struct _result *res)
+{
+	struct _counters c;
+	uint64_t t, best = UINT64_MAX, v[3], bv[3];
+	long i;
+	int j, got = 0, best_got = 0;
+
+	countersOpen(&c);
+
+	for (j = 0; j < repeats; j++)
+	{
+		countersStart(&c);
+		t = now();
+		k->times(set, sun, lat, lng, elv, tz, n, out, PT_FIELDS, 0);
+		t = now() - t;
+		got = countersStop(&c, v);
+
+		if (t < best)
+		{
+			best = t;
+			best_got = got;
+			memcpy(bv, v, sizeof(v));
+		}
+	}
+
+	for (j = 0; j < 3; j++)
+	{
+		if (c.fd[j] >= 0)
+			close(c.fd[j]);
+	}
+
+	for (i = 0; i < n * PT_FIELDS; i++)
+	{
+		if (memcmp(&out[i], &ref[i], sizeof(double)) != 0 && (out[i] == out[i] || ref[i] == ref[i]))
+		{
+			if (res->nan++ == 0)
+				res->worst = (double)(i / PT_FIELDS);
+		}
+	}
+
+	res->ns = (double)best / (double)n;
+	res->cycles = best_got > 0 ? (double)bv[0] / (double)n : -1.0;
+	res->instructions = best_got > 1 ? (double)bv[1] / (double)n : -1.0;
+	res->branch_misses = best_got > 2 ? (double)bv[2] / (double)n : -1.0;
+}
+
+// Whether *a* and *b* are the same time, NAN too.
+static int sameTime(double a, double b)
+{
+	return a == b || (a != a && b != b);
+}
+
+// Check the compact results of *nloc* locations for RES_DAYS days against
+// ptCalc(), see note 7. Return the number of failures.
+static long results(long nloc, int repeats, uint64_t seed)
+{
+	static const short hl_fields[4] = {PT_IMSAK, PT_FAJR, PT_MAGHRIB, PT_ISHA};
+	static const short hl_bits[4] = {PT_HL_IMSAK, PT_HL_FAJR, PT_HL_MAGHRIB, PT_HL_ISHA};
+	struct _ptimes *loc = malloc(sizeof(struct _ptimes) * nloc), pt, raw;
+	double *out = malloc(sizeof(double) * nloc * RES_DAYS * PT_FIELDS), t, e, max = 0.0, ns[2] = {INFINITY, INFINITY};
+	struct _ptarena arena;
+	struct _ptresset *set;
+	struct _ptpool pool;
+	struct _ptres r;
+	uint64_t s = seed, t0;
+	long i, d, differ = 0, over = 0, nan = 0, hl = 0, moved = 0;
+	short f, k, y, m, dd;
+	int j;
+
+	if (loc == 0 || out == 0 || ptPoolInit(&pool, 1) != 0
+		|| ptArenaInit(&arena, sizeof(struct _ptresset) + sizeof(struct _ptres) * nloc * RES_DAYS + PTARENA_ALIGN) != 0)
+	{
+		fprintf(stderr, "ptmath: out of memory\n");
+		return 1;
+	}
+
+	set = ptResAlloc(&arena, nloc, RES_DAYS, julian(2024, 6, 1));
+	ptInit(&pt);
+
+	for (i = 0; i < nloc; i++)
+	{
+		loc[i] = pt;
+		ptSetLocation(&(loc[i]), (float)(-90.0 + 180.0 * uniform(&s)), (float)(-180.0 + 360.0 * uniform(&s)),
+			(float)(3000.0 * uniform(&s)), 0.0f);
+		loc[i].tz = (float)(int)(loc[i].lng / 15.0f);
+	}
+
+	for (j = 0; j < repeats; j++)
+	{
+		t0 = now();
+		ptGridRun(&pool, loc, nloc, 2024, 6, 1, RES_DAYS, out);
+		t = (double)(now() - t0);
+		ns[0] = t < ns[0] ? t : ns[0];
+		t0 = now();
+		ptGridRunRes(&pool, loc, nloc, 2024, 6, 1, RES_DAYS, set->r);
+		t = (double)(now() - t0);
+		ns[1] = t < ns[1] ? t : ns[1];
+	}
+
+	for (i = 0; i < nloc; i++)
+	{
+		for (d = 0; d < RES_DAYS; d++)
+		{
+			gregorian(set->jd + (double)d, &y, &m, &dd);
+			pt = loc[i];
+			ptSetDate(&pt, y, m, dd);
+			raw = pt;
+			raw.high_lats = HIGHLAT_NONE;
+
+			while (ptCalc(&pt) != 0);
+			while (ptCalc(&raw) != 0);
+
+			ptResSet(&r, &pt);
+			differ += memcmp(&r, &(set->r[i * RES_DAYS + d]), sizeof(r)) != 0;
+
+			for (f = 0; f < PT_FIELDS; f++)
+			{
+				t = ptTime(&pt, f);
+
+				if (r.flags & PT_RES_NAN(f))
+				{
+					nan++;
+					over += t == t && t * PT_RES_UNIT + PT_RES_BIAS > PT_RES_MIN
+						&& t * PT_RES_UNIT + PT_RES_BIAS < PT_RES_MAX; // a time that fits
+					continue;
+				}
+
+				e = fabs(ptResTime(&r, f) - t) * 3600.0;
+				max = e > max ? e : max;
+				over += e > 1800.0 / PT_RES_UNIT + 1e-6;
+			}
+
+			for (k = 0; k < 4; k++)
+			{
+				j = !sameTime(ptTime(&pt, hl_fields[k]), ptTime(&raw, hl_fields[k])); // moved
+				moved += j;
+				hl += ((r.flags & PT_RES_HL(hl_bits[k])) != 0) != j;
+			}
+		}
+	}
+
+	printf("\n%-8s %-22s %8s %8s %12s %10s %10s %10s %10s\n", "results", "location-days", "ns/call", "bytes",
+		"differ", "max sec", "over", "none", "hl wrong");
+	printf("%-8s %-22ld %8.2f %8d\n", "double", nloc * RES_DAYS, ns[0] / (double)(nloc * RES_DAYS),
+		(int)(sizeof(double) * PT_FIELDS));
+	printf("%-8s %-22ld %8.2f %8d %12ld %10.3f %10ld %10ld %10ld  of %ld moved\n", "compact", nloc * RES_DAYS,
+		ns[1] / (double)(nloc * RES_DAYS), (int)sizeof(struct _ptres), differ, max, over, nan, hl, moved);
+
+	ptArenaFree(&arena);
+	ptPoolFree(&pool);
+	free(loc);
+	free(out);
+
+	return differ + over + hl;
+}
+
+// Check the Sun curves of *ndays* location-days against direct dm_cos()
+// and dm_sin(), see note 8. Return the number of samples over the bound.
+static long curve(long ndays, int repeats, uint64_t seed)
+{
+	double *v = malloc(sizeof(double) * CURVE_SAMPLES * 6), *up = v, *east = v + CURVE_SAMPLES;
+	double *north = v + 2 * CURVE_SAMPLES, *ref = v + 3 * CURVE_SAMPLES, h, dh, x, e, max = 0.0, ns[2] = {0.0, 0.0};
+	struct _suncurve sc;
+	struct _ptimes pt;
+	uint64_t s = seed, t0;
+	long d, over = 0;
+	int i, j;
+
+	if (v == 0)
+	{
+		fprintf(stderr, "ptmath: out of memory\n");
+		return 1;
+	}
+
+	ptInit(&pt);
+	dh = 15.0 / 60.0;
+
+	for (d = 0; d < ndays; d++)
+	{
+		ptSetLocation(&pt, (float)(-90.0 + 180.0 * uniform(&s)), (float)(-180.0 + 360.0 * uniform(&s)), 0.0f, 0.0f);
+		pt.tz = (float)(int)(pt.lng / 15.0f);
+		pt.jd = julian(1950, 1, 1) + (double)(long)(36525.0 * uniform(&s));
+		sunCurveInit(&sc, &pt);
+
+		for (j = 0, x = INFINITY; j < repeats; j++)
+		{
+			t0 = now();
+			sunCurve(&sc, 0.0, 1.0 / 60.0, CURVE_SAMPLES, up, east, north);
+			h = (double)(now() - t0);
+			x = h < x ? h : x;
+		}
+
+		ns[0] += x;
+		t0 = now();
+		h = 15.0 * (0.0 - sc.noon);
+
+		for (i = 0; i < CURVE_SAMPLES; i++)
+		{
+			x = dm_fixAngle(h + i * dh);
+			ref[i] = dm_cos(x);
+			ref[CURVE_SAMPLES + i] = dm_sin(x);
+		}
+
+		ns[1] += (double)(now() - t0);
+
+		for (i = 0; i < CURVE_SAMPLES; i++)
+		{
+			e = fabs(up[i] - (sc.up0 + sc.up1 * ref[i]));
+			x = fabs(east[i] - sc.east1 * ref[CURVE_SAMPLES + i]);
+			e = x > e ? x : e;
+			x = fabs(north[i] - (sc.north0 + sc.north1 * ref[i]));
+			e = x > e ? x : e;
+			max = e > max ? e : max;
+			over += !(e <= CURVE_BOUND); // NAN too
+		}
+	}
+
+	printf("\n%-8s %-22s %8s %12s %10s %10s\n", "curve", "samples", "ns/call", "max error", "bound", "over");
+	printf("%-8s %-22ld %8.2f\n", "direct", ndays * CURVE_SAMPLES, ns[1] / (double)(ndays * CURVE_SAMPLES));
+	printf("%-8s %-22ld %8.2f %12.3g %10.3g %10ld\n", "sunCurve", ndays * CURVE_SAMPLES,
+		ns[0] / (double)(ndays * CURVE_SAMPLES), max, CURVE_BOUND, over);
+
+	free(v);
+
+	return over;
+}
+
+// Compare the *count* entries *e* of the index for *field* to a linear scan
+// of the times *u* of the locations over [*t0*, *t1*), see note 9. The id
+// of location i is i. Return the number of failures.
+static long indexCheck(const struct _ptindex_entry *e, long count, const int64_t *u, long nloc, short field,
+	int64_t t0, int64_t t1)
+{
+	long i, k = 0, fail = 0;
+	int64_t t;
+
+	for (i = 0; i < nloc; i++)
+	{
+		t = u[i * PT_FIELDS + field];
+		k += t != PT_NO_TIME && t >= t0 && t < t1;
+	}
+
+	fail += k != count;
+
+	for (i = 0; i < count; i++)
+	{
+		fail += e[i].id < 0 || e[i].id >= nloc || e[i].t != u[e[i].id * PT_FIELDS + field]
+			|| e[i].t < t0 || e[i].t >= t1;
+		fail += i > 0 && (e[i].t < e[i - 1].t || (e[i].t == e[i - 1].t && e[i].id <= e[i - 1].id));
+	}
+
+	return fail;
+}
+
+// Check the reverse index of a day of *nloc* locations against linear scans,
+// see note 9. Return the number of failures.
+static long reverseIndex(long nloc, uint64_t seed)
+{
+	struct _ptimes *loc = malloc(sizeof(struct _ptimes) * nloc), pt;
+	double *out = malloc(sizeof(double) * nloc * PT_FIELDS);
+	int64_t *u = malloc(sizeof(int64_t) * nloc * PT_FIELDS), t0, t1, day0, day1;
+	long *ids = malloc(sizeof(long) * nloc), i, count, queries = 0, sweeps = 0, events = 0, fail = 0;
+	struct _ptindex_cursor cur;
+	struct _ptindex_entry *e;
+	struct _ptindex ix;
+	struct _ptpool pool;
+	uint64_t s = seed, t;
+	double ns[2];
+	short f;
+
+	if (loc == 0 || out == 0 || u == 0 || ids == 0 || ptPoolInit(&pool, 1) != 0)
+	{
+		fprintf(stderr, "ptmath: out of memory\n");
+		return 1;
+	}
+
+	ptInit(&pt);
+
+	for (i = 0; i < nloc; i++)
+	{
+		loc[i] = pt;
+		ptSetLocation(&(loc[i]), (float)(-90.0 + 180.0 * uniform(&s)), (float)(-180.0 + 360.0 * uniform(&s)), 0.0f, 0.0f);
+		loc[i].tz = (float)(int)(loc[i].lng / 15.0f);
+		ids[i] = i;
+	}
+
+	ptGridRun(&pool, loc, nloc, 2024, 3, 20, 1, out);
+
+	// the results of the day as ptCalc() leaves them, fields first
+	for (i = 0; i < nloc; i++)
+	{
+		ptSetDate(&(loc[i]), 2024, 3, 20);
+		memcpy(&(loc[i]), out + i * PT_FIELDS, sizeof(double) * PT_FIELDS);
+
+		for (f = 0; f < PT_FIELDS; f++)
+			u[i * PT_FIELDS + f] = ptUnixSeconds(&(loc[i]), f);
+	}
+
+	t = now();
+
+	if (ptIndexBuild(&ix, loc, ids, nloc, INDEX_THREADS) != 0)
+	{
+		fprintf(stderr, "ptmath: out of memory\n");
+		return 1;
+	}
+
+	ns[0] = (double)(now() - t);
+	day0 = (int64_t)ptUnixTime(&(loc[0]), 0.0) - 86400;
+	day1 = day0 + 3 * 86400;
+	ns[1] = 0.0;
+
+	for (f = 0; f < PT_FIELDS; f++)
+	{
+		for (i = 0, count = 0; i < nloc; i++)
+			count += u[i * PT_FIELDS + f] != PT_NO_TIME;
+
+		fail += count != ix.n[f];
+
+		for (i = 0; i < INDEX_QUERIES; i++)
+		{
+			t0 = day0 + (int64_t)((double)(day1 - day0) * uniform(&s));
+			t1 = t0 + (int64_t)(i % 4 == 0 ? 60.0 : 7200.0 * uniform(&s)); // minutes, and up to 2 hours
+			t = now();
+			e = ptIndexRange(&ix, f, t0, t1, &count);
+			ns[1] += (double)(now() - t);
+			fail += indexCheck(e, count, u, nloc, f, t0, t1);
+			queries++;
+		}
+	}
+
+	// sweep through the days half an hour or less at a time
+	ptIndexSeek(&ix, &cur, day0);
+
+	for (t0 = day0; t0 < day1; t0 = t1)
+	{
+		t1 = t0 + 1 + (int64_t)(1800.0 * uniform(&s));
+
+		for (f = 0; f < PT_FIELDS; f++)
+		{
+			e = ptIndexSweep(&ix, &cur, f, t1, &count);
+			fail += indexCheck(e, count, u, nloc, f, t0, t1);
+			events += count;
+		}
+
+		sweeps++;
+	}
+
+	for (f = 0; f < PT_FIELDS; f++)
+		fail += cur.pos[f] != ix.n[f]; // every event swept
+
+	printf("\n%-8s %-22s %12s %12s %10s %10s\n", "index", "locations", "build ms", "ns/query", "queries", "failed");
+	printf("%-8s %-22ld %12.2f %12.2f %10ld %10ld  %ld sweeps of %ld events\n", "ptIndex", nloc, ns[0] / 1e6,
+		ns[1] / (double)queries, queries, fail, sweeps, events);
+
+	ptIndexFree(&ix);
+	ptPoolFree(&pool);
+	free(loc);
+	free(out);
+	free(u);
+	free(ids);
+
+	return fail;
+}
+
+// An event expected of the scheduler.
+struct _schedevent
+{
+	int64_t t;
+	short field;
+};
+
+// The events expected of every subscriber, next[id] up to end[id].
+struct _schedcheck
+{
+	struct _schedevent *ev;
+	long *next;
+	long *end;
+	int64_t last; // tick of the last event fired
+	long fail;
+};
+
+static int cmpSchedEvent(const void *a, const void *b)
+{
+	const struct _schedevent *x = a, *y = b;
+
+	if (x->t != y->t)
+		return x->t < y->t ? -1 : 1;
+
+	return x->field - y->field;
+}
+
+// Callback of the scheduler check, see note 10.
+static void schedFired(struct _ptsched *s, struct _ptsched_sub *sub, void *arg)
+{
+	struct _schedcheck *c = arg;
+	long i = c->next[sub->id];
+
+	c->fail += i >= c->end[sub->id] || c->ev[i].t != sub->due || c->ev[i].field != sub->field
+		|| sub->due != s->tick || s->tick < c->last;
+	c->last = s->tick;
+	c->next[sub->id] = ++i;
+
+	if (sub->id % 10 == 0 && i == c->end[sub->id])
+		ptSchedRemove(s, sub);
+}
+
+// Replay SCHED_DAYS days of *nsub* subscribers with the scheduler and check
+// every event against ptCalc(), see note 10. Return the number of failures.
+static long schedule(long nsub, uint64_t seed)
+{
+	static const short masks[2] = {PTSCHED_ALL, (1 << PT_FAJR) | (1 << PT_DHUHR) | (1 << PT_MAGHRIB) | (1 << PT_MIDNIGHT)};
+	long per = (SCHED_DAYS + 2) * PT_FIELDS, i, k, fail = 0, events = 0, fired = 0;
+	struct _ptsched_sub *sub = malloc(sizeof(struct _ptsched_sub) * nsub);
+	struct _schedevent *ev = malloc(sizeof(struct _schedevent) * nsub * per);
+	long *next = malloc(sizeof(long) * nsub), *end = malloc(sizeof(long) * nsub);
+	int64_t start = 1704067200, until = start + SCHED_DAYS * 86400 - 1, t; // from 2024-01-01 UTC
+	struct _ptsched *s = malloc(sizeof(struct _ptsched));
+	struct _schedcheck c;
+	struct _ptimes pt;
+	uint64_t r = seed, t0;
+	short y, m, d, f, j;
+	double ns = 0.0;
+
+	if (sub == 0 || ev == 0 || next == 0 || end == 0 || s == 0)
+	{
+		fprintf(stderr, "ptmath: out of memory\n");
+		return 1;
+	}
+
+	c.ev = ev;
+	c.next = next;
+	c.end = end;
+
+	for (j = 0; j < 2; j++)
+	{
+		ptSchedInit(s, start, masks[j], schedFired, &c);
+		c.last = start;
+		c.fail = 0;
+		ptInit(&pt);
+
+		for (i = 0; i < nsub; i++)
+		{
+			// the local date at the start
+			ptSetLocation(&pt, (float)(-90.0 + 180.0 * uniform(&r)), (float)(-180.0 + 360.0 * uniform(&r)), 0.0f, 0.0f);
+			pt.tz = (float)(int)(pt.lng / 15.0f);
+			gregorian(julian(2024, 1, 1) - (pt.tz < 0.0f ? 1.0 : 0.0), &y, &m, &d);
+			ptSetDate(&pt, y, m, d);
+
+			sub[i].id = i;
+			sub[i].pt = pt;
+			sub[i].active = 0;
+			next[i] = end[i] = i * per;
+
+			// the events of ptCalc() from that date on
+			for (k = 0; k < SCHED_DAYS + 2; k++)
+			{
+				while (ptCalc(&pt) != 0);
+
+				for (f = 0; f < PT_FIELDS; f++)
+				{
+					t = ptUnixSeconds(&pt, f);
+
+					if ((masks[j] & (1 << f)) == 0 || t == PT_NO_TIME || t < start || t > until)
+						continue;
+
+					ev[end[i]].t = t;
+					ev[end[i]].field = f;
+					end[i]++;
+				}
+
+				gregorian(pt.jd + 1.0, &y, &m, &d);
+				ptSetDate(&pt, y, m, d);
+				pt.phase = 0;
+			}
+
+			qsort(ev + next[i], end[i] - next[i], sizeof(struct _schedevent), cmpSchedEvent);
+
+			if (i % 10 == 0 && end[i] > next[i] + SCHED_KEEP)
+				end[i] = next[i] + SCHED_KEEP;
+
+			events += end[i] - next[i];
+			pt = sub[i].pt;
+			ptSchedAdd(s, &(sub[i]));
+		}
+
+		// paced first, then in steps of up to a few hours as fast as it goes
+		t0 = now();
+		fired += ptSchedRun(s, start + 7199, 1e6);
+
+		for (t = start + 7200; t <= until; t += 1 + (int64_t)(14400.0 * uniform(&r)))
+			fired += ptSchedAdvance(s, t < until ? t : until);
+
+		fired += ptSchedAdvance(s, until);
+		ns += (double)(now() - t0);
+
+		for (i = 0; i < nsub; i++)
+			c.fail += next[i] != end[i]; // missed
+
+		fail += c.fail;
+	}
+
+	printf("\n%-8s %-22s %12s %12s %10s %10s\n", "sched", "subscribers", "events", "ns/event", "fired", "failed");
+	printf("%-8s %-22ld %12ld %12.2f %10ld %10ld  over %d days, twice\n", "ptSched", nsub, events,
+		ns / (double)(fired > 0 ? fired : 1), fired, fail, SCHED_DAYS);
+
+	free(sub);
+	free(ev);
+	free(next);
+	free(end);
+	free(s);
+
+	return fail;
+}
+
+// A random float of note 11.
+static float fmtFloat(uint64_t *s)
+{
+	uint64_t r = rnd(s);
+	uint32_t b = (uint32_t)r;
+	float v;
+
+	if ((r >> 32) & 1) // a multiple of 2^-7 up to about 2^24
+	{
+		v = (float)((int32_t)b >> 1) / 128.0f;
+		return v;
+	}
+
+	do
+	{
+		memcpy(&v, &b, sizeof(v));
+		b = (uint32_t)rnd(s);
+	}
+	while (v == v && fabsf(v) != INFINITY && fabsf(v) > 1e12f);
+
+	return v;
+}
+
+// Check the numbers of *nrec* records of text output against snprintf(),
+// see note 11. Return the number of differences.
+static long format(long nrec, uint64_t seed)
+{
+	static char buf[PTFMT_MAX_RECORD * 2];
+	char want[4 * 32], *line;
+	struct _ptfmt f;
+	struct _ptimes pt;
+	uint64_t s = seed;
+	long i, differ = 0;
+
+	ptInit(&pt);
+	ptSetDate(&pt, 2024, 1, 1);
+
+	for (i = 0; i < nrec; i++)
+	{
+		pt.lat = fmtFloat(&s);
+		pt.lng = fmtFloat(&s);
+		pt.elv = fmtFloat(&s);
+		pt.tz = fmtFloat(&s);
+
+		ptFmtInit(&f, buf, sizeof(buf) - 1, -1);
+		ptFmtTimes(&f, &pt, PTFMT_TEXT, 0);
+		buf[f.len] = '\0';
+		snprintf(want, sizeof(want), "lat %14.6f\nlng %14.6f\nelv %14.6f\ntz  %14.6f\n", pt.lat, pt.lng, pt.elv, pt.tz);
+		line = strstr(buf, "lat ");
+
+		if (line == 0 || strncmp(line, want, strlen(want)) != 0)
+		{
+			if (differ++ == 0)
+				printf("\nfirst difference:\n%s%.*s", want, (int)strlen(want), line != 0 ? line : "");
+		}
+	}
+
+	printf("\n%-8s %-22s %12s\n", "fmt", "records", "differ");
+	printf("%-8s %-22ld %12ld  of %d numbers each\n", "%14.6f", nrec, differ, FMT_PER_REC);
+
+	return differ;
+}
+
+// A reader of the snapshot check.
+struct _snapreader
+{
+	struct _ptsnap *s;
+	const double *ref; // ptCalc() of location i on day k at (k * nloc + i) * PT_FIELDS
+	const long *id;
+	long nloc;
+	double jd;         // of day 0
+	short r;           // reader slot
+	int *stop;
+	uint64_t seed;
+	long lookups;
+	long fail;
+	long days;         // seen
+};
+
+// Whether the times *t* of location *i* are those of day *d*, see note 12.
+static int snapSame(struct _snapreader *c, struct _ptsnap_day *d, const double *t, long i)
+{
+	long k = (long)(d->jd - c->jd);
+	short f;
+
+	if (t == 0 || k < 0 || k >= SNAP_DAYS)
+		return 0;
+
+	for (f = 0; f < PT_FIELDS; f++)
+	{
+		if (!sameTime(t[f], c->ref[(k * c->nloc + i) * PT_FIELDS + f]))
+			return 0;
+	}
+
+	return 1;
+}
+
+static void *snapRead(void *arg)
+{
+	struct _snapreader *c = arg;
+	struct _ptsnap_day *d;
+	uint64_t s = c->seed;
+	double last = 0.0;
+	long i, j;
+
+	while (!__atomic_load_n(c->stop, __ATOMIC_ACQUIRE))
+	{
+		d = ptSnapEnter(c->s, c->r);
+		i = (long)(rnd(&s) % (uint64_t)c->nloc);
+		j = (long)(rnd(&s) % (uint64_t)c->nloc);
+		c->fail += !snapSame(c, d, ptSnapFind(d, c->id[i]), i);
+		c->fail += !snapSame(c, d, ptSnapFind(d, c->id[j]), j);
+		c->fail += !snapSame(c, d, ptSnapFind(d, c->id[i]), i); // still there
+		c->days += d->jd != last;
+		last = d->jd;
+		ptSnapLeave(c->s, c->r);
+		c->lookups += 3;
+	}
+
+	return 0;
+}
+
+// Read snapshots of *nloc* locations on threads while they roll over,
+// see note 12. Return the number of failures.
+static long snapshots(long nloc, uint64_t seed)
+{
+	struct _ptimes *loc = malloc(sizeof(struct _ptimes) * nloc), pt;
+	double *ref = malloc(sizeof(double) * nloc * SNAP_DAYS * PT_FIELDS), jd = julian(2099, 12, 1);
+	long *id = malloc(sizeof(long) * nloc), i, k, fail = 0, lookups = 0, days = 0;
+	struct _snapreader c[SNAP_READERS];
+	pthread_t th[SNAP_READERS];
+	struct timespec pause = {0, 2000000};
+	struct _ptsnap *s = malloc(sizeof(struct _ptsnap));
+	uint64_t r = seed;
+	short y, m, d, f, started;
+	int stop = 0;
+
+	if (loc == 0 || ref == 0 || id == 0 || s == 0)
+	{
+		fprintf(stderr, "ptmath: out of memory\n");
+		return 1;
+	}
+
+	ptInit(&pt);
+
+	for (i = 0; i < nloc; i++)
+	{
+		loc[i] = pt;
+		ptSetLocation(&(loc[i]), (float)(-90.0 + 180.0 * uniform(&r)), (float)(-180.0 + 360.0 * uniform(&r)), 0.0f, 0.0f);
+		loc[i].tz = (float)(int)(loc[i].lng / 15.0f);
+		id[i] = (long)((uint64_t)(i + 1) * 0x9E3779B97F4A7C15ULL >> 34); // unsorted, unique
+
+		for (k = 0; k < SNAP_DAYS; k++)
+		{
+			pt = loc[i];
+			gregorian(jd + (double)k, &y, &m, &d);
+			ptSetDate(&pt, y, m, d);
+
+			while (ptCalc(&pt) != 0);
+
+			for (f = 0; f < PT_FIELDS; f++)
+				ref[(k * nloc + i) * PT_FIELDS + f] = ptTime(&pt, f);
+		}
+	}
+
+	gregorian(jd, &y, &m, &d);
+
+	if (ptSnapInit(s, loc, id, nloc, 0.0f, 1, y, m, d) != 0 || ptSnapStart(s) != 0)
+	{
+		fprintf(stderr, "ptmath: cannot start the snapshots\n");
+		return 1;
+	}
+
+	for (started = 0; started < SNAP_READERS; started++)
+	{
+		c[started].s = s;
+		c[started].ref = ref;
+		c[started].id = id;
+		c[started].nloc = nloc;
+		c[started].jd = jd;
+		c[started].r = started;
+		c[started].stop = &stop;
+		c[started].seed = seed + (uint64_t)started * 2;
+		c[started].lookups = 0;
+		c[started].fail = 0;
+		c[started].days = 0;
+
+		if (pthread_create(&(th[started]), 0, snapRead, &(c[started])) != 0)
+			break;
+	}
+
+	for (k = 1; k < SNAP_DAYS; k++)
+	{
+		nanosleep(&pause, 0);
+		fail += ptSnapRoll(s) != 0;
+	}
+
+	nanosleep(&pause, 0);
+	__atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+
+	for (i = 0; i < started; i++)
+	{
+		pthread_join(th[i], 0);
+		fail += c[i].fail;
+		lookups += c[i].lookups;
+		days += c[i].days;
+	}
+
+	// with no reader left, a roll frees every day retired, itself included
+	pthread_mutex_lock(&(s->lock));
+	fail += s->cur->jd != jd + (double)(SNAP_DAYS - 1);
+	pthread_mutex_unlock(&(s->lock));
+	fail += ptSnapRoll(s) != 0;
+	pthread_mutex_lock(&(s->lock));
+	fail += s->retired != 0 || s->freed != s->days - 1;
+	printf("\n%-8s %-22s %12s %10s %10s %10s\n", "snap", "locations", "lookups", "days", "freed", "failed");
+	printf("%-8s %-22ld %12ld %10ld %10ld %10ld  %d readers saw %ld days\n", "ptSnap", nloc, lookups, s->days,
+		s->freed, fail, started, days);
+	pthread_mutex_unlock(&(s->lock));
+
+	ptSnapFree(s);
+	free(s);
+	free(loc);
+	free(ref);
+	free(id);
+
+	return fail;
+}
+
+static void printCount(double v)
+{
+	if (v < 0.0)
+		printf(" %8s", "-");
+	else
+		printf(" %8.2f", v);
+}
+
+static void help(void)
+{
+	printf("PRAYER TIMES MATH BENCHMARK\n\n");
+	printf("USAGE:\n");
+	printf("\tptmath <options>\n\n");
+	printf("\toptions:\n");
+	printf("\tn <points>       inputs a routine, 1000000 by default\n");
+	printf("\tr <repeats>      timed passes, the best kept, 5 by default\n");
+	printf("\tf <routine>      only this routine, i.e. p_asin, or one of\n");
+	printf("\t                  sun    models of the position of the Sun\n");
+	printf("\t                  kern   kernels over many locations\n");
+	printf("\t                  res    compact results against ptCalc()\n");
+	printf("\t                  curve  Sun curve against dm_sin()/dm_cos()\n");
+	printf("\t                  index  reverse index against a linear scan\n");
+	printf("\t                  sched  scheduler against ptCalc() over days\n");
+	printf("\t                  fmt    text output against snprintf()\n");
+	printf("\t                  snap   snapshots read across roll overs\n");
+	printf("\th 1              print the ulp histograms\n");
+	printf("\ts <seed>         of the inputs\n");
+	printf("\n");
+	printf("\tExample: ptmath n 100000 f p_sin h 1\n\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct _result res;
+	const struct _routine *r;
+	uint64_t seed = 88172645463325252ULL, s;
+	double *x, *y, step;
+	long n = 1000000, i;
+	int repeats = 5, hist = 0, fail = 0, b, k;
+	char *only = 0;
+
+	for (k = 1; k + 1 < argc; k += 2)
+	{
+		switch (argv[k][0] != '\0' && argv[k][1] == '\0' ? argv[k][0] : 0)
+		{
+			case 'n': n = atol(argv[k + 1]); break;
+			case 'r': repeats = atoi(argv[k + 1]); break;
+			case 'f': only = argv[k + 1]; break;
+			case 'h': hist = atoi(argv[k + 1]); break;
+			case 's': seed = strtoull(argv[k + 1], 0, 10) | 1; break;
+			default: help(); return 1;
+		}
+	}
+
+	if (n < 1 || repeats < 1 || k < argc)
+	{
+		help();
+		return 1;
+	}
+
+	x = malloc(sizeof(double) * n);
+	y = malloc(sizeof(double) * n);
+
+	if (x == 0 || y == 0)
+	{
+		fprintf(stderr, "ptmath: out of memory\n");
+		return 1;
+	}
+
+	printf("%-8s %-22s %8s %8s %8s %8s %12s %10s  %s\n", "routine", "domain", "ns/call", "cycles",
+		"instr", "br-miss", "max ulp", "max abs", "worst input");
+
+	for (r = routines; r < routines + ROUTINES; r++)
+	{
+		if (only != 0 && strcmp(only, r->name) != 0)
+			continue;
+
+		s = seed;
+		step = (r->hi - r->lo) / (double)n;
+
+		for (i = 0; i < n; i++)
+		{
+			x[i] = r->lo + step * ((double)i + uniform(&s));
+
+			if (r->fn2 != 0) // y in [lo, hi], x at random in [lo2, hi2]
+			{
+				y[i] = x[i];
+				x[i] = r->lo2 + (r->hi2 - r->lo2) * uniform(&s);
+			}
+		}
+
+		if (r->lo == -1.0 && r->hi == 1.0) // the ends of asin and acos
+		{
+			x[0] = -1.0;
+			x[n - 1] = 1.0;
+		}
+
+		memset(&res, 0, sizeof(res));
+		accuracy(r, x, y, n, &res);
+		speed(r, x, y, n, repeats, &res);
+
+		printf("%-8s [%9.3g, %9.3g] %8.2f", r->name, r->lo, r->hi, res.ns);
+		printCount(res.cycles);
+		printCount(res.instructions);
+		printCount(res.branch_misses);
+		printf(" %12.3g %10.3g  ", res.max_ulp, res.max_abs);
+
+		if (r->fn2 != 0)
+			printf("%.17g, %.17g", res.worst, res.worst2);
+		else
+			printf("%.17g", res.worst);
+
+		printf(res.nan > 0 ? " (%ld NAN mismatches)\n" : "\n", res.nan);
+
+		if (hist)
+		{
+			for (b = 0; b < MATH_BUCKETS; b++)
+			{
+				if (res.count[b] == 0)
+					continue;
+
+				if (b == 0)
+					printf("\t%12s %10ld\n", "0", res.count[b]);
+				else if (b == MATH_BUCKETS - 1)
+					printf("\t%12s %10ld\n", "more", res.count[b]);
+				else
+					printf("\t<= %9g %10ld\n", ldexp(1.0, b - 2), res.count[b]);
+			}
+		}
+	}
+
+	if (only == 0 || strcmp(only, "sun") == 0)
+	{
+		printf("\n%-8s %-22s %8s %8s %8s %8s %12s %10s  %s\n", "model", "years", "ns/call", "cycles",
+			"instr", "br-miss", "decl arcsec", "eqt sec", "worst dates");
+
+		for (k = 0; k < (int)MODELS; k++)
+		{
+			s = seed;
+			step = (SUN_JD1 - SUN_JD0) / (double)n;
+
+			for (i = 0; i < n; i++)
+				x[i] = SUN_JD0 + step * ((double)i + uniform(&s));
+
+			memset(&res, 0, sizeof(res));
+			sunModel(ptSunModel(models[k].model), x, n, repeats, &res);
+
+			printf("%-8s %-22s %8.2f", models[k].name, "[1950, 2050]", res.ns);
+			printCount(res.cycles);
+			printCount(res.instructions);
+			printCount(res.branch_misses);
+			printf(" %12.3g %10.3g  %.1f, %.1f\n", res.max_ulp, res.max_abs, res.worst, res.worst2);
+		}
+	}
+
+	if (only == 0 || strcmp(only, "kern") == 0)
+	{
+		struct _ptimes set, pt;
+		struct _ptsun sun;
+		const struct _ptkern *kp;
+		float *lat = malloc(sizeof(float) * n * 4), *lng = lat + n, *elv = lat + 2 * n, *tz = lat + 3 * n;
+		double *ref = malloc(sizeof(double) * n * PT_FIELDS * 2), *out = ref + n * PT_FIELDS, calc;
+		uint64_t t;
+		short f;
+
+		if (lat == 0 || ref == 0)
+		{
+			fprintf(stderr, "ptmath: out of memory\n");
+			return 1;
+		}
+
+		ptInit(&set);
+		ptSetDate(&set, 2024, 3, 20);
+		ptSunInit(&sun, set.jd, set.sun_model);
+		s = seed;
+
+		for (i = 0; i < n; i++)
+		{
+			lat[i] = (float)(-90.0 + 180.0 * uniform(&s));
+			lng[i] = (float)(-180.0 + 360.0 * uniform(&s));
+			elv[i] = (float)(3000.0 * uniform(&s));
+			tz[i] = (float)(int)(lng[i] / 15.0f);
+		}
+
+		t = now();
+
+		for (i = 0; i < n; i++)
+		{
+			pt = set;
+			pt.sun = &sun;
+			ptSetLocation(&pt, lat[i], lng[i], elv[i], tz[i]);
+
+			while (ptCalc(&pt) != 0);
+
+			for (f = 0; f < PT_FIELDS; f++)
+				ref[i * PT_FIELDS + f] = ptTime(&pt, f);
+		}
+
+		calc = (double)(now() - t) / (double)n;
+
+		printf("\n%-8s %-22s %8s %8s %8s %8s %12s %10s  %s\n", "kernels", "locations", "ns/call", "cycles",
+			"instr", "br-miss", "differ", "speedup", "first differing");
+		printf("%-8s %-22s %8.2f\n", "ptCalc", "lat [-90, 90]", calc);
+
+		for (k = 0; (kp = ptKernAt(k)) != 0; k++)
+		{
+			memset(&res, 0, sizeof(res));
+			kernel(kp, &set, &sun, lat, lng, elv, tz, ref, out, n, repeats, &res);
+
+			printf("%-8s %-22s %8.2f", kp->name, "lat [-90, 90]", res.ns);
+			printCount(res.cycles);
+			printCount(res.instructions);
+			printCount(res.branch_misses);
+			printf(" %12ld %9.1fx  ", res.nan, calc / res.ns);
+			printf(res.nan > 0 ? "%.0f\n" : "-\n", res.worst);
+		}
+
+		free(lat);
+		free(ref);
+	}
+
+	if (only == 0 || strcmp(only, "res") == 0)
+		fail |= results(n / RES_DAYS > 0 ? n / RES_DAYS : 1, repeats, seed) > 0;
+
+	if (only == 0 || strcmp(only, "curve") == 0)
+		fail |= curve(n / CURVE_SAMPLES > 0 ? n / CURVE_SAMPLES : 1, repeats, seed) > 0;
+
+	if (only == 0 || strcmp(only, "index") == 0)
+		fail |= reverseIndex(n / INDEX_PER_LOC > 0 ? n / INDEX_PER_LOC : 1, seed) > 0;
+
+	if (only == 0 || strcmp(only, "sched") == 0)
+		fail |= schedule(n / SCHED_PER_SUB > 0 ? n / SCHED_PER_SUB : 1, seed) > 0;
+
+	if (only == 0 || strcmp(only, "fmt") == 0)
+		fail |= format(n / FMT_PER_REC > 0 ? n / FMT_PER_REC : 1, seed) > 0;
+
+	if (only == 0 || strcmp(only, "snap") == 0)
+		fail |= snapshots(n / SNAP_PER_LOC > 0 ? n / SNAP_PER_LOC : 1, seed) > 0;
+
+	free(x);
+	free(y);
+
+	return fail;
+}
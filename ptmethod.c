@@ -0,0 +1,291 @@
+// ptmethod.c
+// Calculation methods and settings
+// The parameters of the prayer time methods, and the settings of the
+// adjustments and batch records on top of them.
+
+#include "ptmethod.h"
+
+const struct _pt_method pt_methods[] PT_ROM =
+{
+#if PT_METHOD_MASK & (1 << METHOD_MWL)
+	{
+		.id = METHOD_MWL,
+		.name = "MWL",
+		.desc = "Muslim World League",
+		.params =
+		{
+			.fajr_rel_d = 18.0,
+			.isha_rel_d = 17.0,
+			.isha_rel_m = 0.0,
+			.maghrib_rel_d = 0,
+			.maghrib_rel_m = 0,
+			.midnight_type = MIDNIGHT_STANDARD
+		}
+	},
+#endif
+#if PT_METHOD_MASK & (1 << METHOD_ISNA)
+	{
+		.id = METHOD_ISNA,
+		.name = "ISNA",
+		.desc = "Islamic Society of North America (ISNA)",
+		.params =
+		{
+			.fajr_rel_d = 15.0,
+			.isha_rel_d = 15.0,
+			.isha_rel_m = 0.0,
+			.maghrib_rel_d = 0,
+			.maghrib_rel_m = 0,
+			.midnight_type = MIDNIGHT_STANDARD
+		}
+	},
+#endif
+#if PT_METHOD_MASK & (1 << METHOD_EGYPT)
+	{
+		.id = METHOD_EGYPT,
+		.name = "Egypt",
+		.desc = "Egyptian General Authority of Survey",
+		.params =
+		{
+			.fajr_rel_d = 19.5,
+			.isha_rel_d = 17.5, 
+			.isha_rel_m = 0.0,
+			.maghrib_rel_d = 0,
+			.maghrib_rel_m = 0,
+			.midnight_type = MIDNIGHT_STANDARD
+		}
+	},
+#endif
+#if PT_METHOD_MASK & (1 << METHOD_MAKKAH)
+	{
+		.id = METHOD_MAKKAH,
+		.name = "Makkah",
+		.desc = "Umm Al-Qura University, Makkah",
+		.params =
+		{
+			.fajr_rel_d = 18.5, // fajr was 19 degrees before 1430 hijri
+			.isha_rel_d = 0.0,
+			.isha_rel_m = 90.0, 
+			.maghrib_rel_d = 0.0,
+			.maghrib_rel_m = 0,
+			.midnight_type = MIDNIGHT_STANDARD
+		}
+	},
+#endif
+#if PT_METHOD_MASK & (1 << METHOD_KARACHI)
+	{
+		.id = METHOD_KARACHI,
+		.name = "Karachi",
+		.desc = "University of Islamic Sciences, Karachi",
+		.params =
+		{
+			.fajr_rel_d = 18.0,
+			.isha_rel_d = 18.0,
+			.isha_rel_m = 0.0,
+			.maghrib_rel_d = 0.0,
+			.maghrib_rel_m = 0,
+			.midnight_type = MIDNIGHT_STANDARD
+		}
+	},
+#endif
+#if PT_METHOD_MASK & (1 << METHOD_TEHRAN)
+	{
+		.id = METHOD_TEHRAN,
+		.name = "Tehran",
+		.desc = "Institute of Geophysics, University of Tehran",
+		.params =
+		{
+			.fajr_rel_d = 17.7,
+			.isha_rel_d = 14.0, // isha was not explicitly specified in this method
+			.isha_rel_m = 0.0,
+			.maghrib_rel_d = 4.5,
+			.maghrib_rel_m = 0,
+			.midnight_type = MIDNIGHT_JAFARI
+		}
+	},
+#endif
+#if PT_METHOD_MASK & (1 << METHOD_JAFARI)
+	{
+		.id = METHOD_JAFARI,
+		.name = "Jafari",
+		.desc = "Shia Ithna-Ashari, Leva Institute, Qum",
+		.params =
+		{
+			.fajr_rel_d = 16.0,
+			.isha_rel_d = 14.0,
+			.isha_rel_m = 0.0,
+			.maghrib_rel_d = 4.0,
+			.maghrib_rel_m = 0,
+			.midnight_type = MIDNIGHT_JAFARI
+		}
+	},
+#endif
+};
+
+// Return *method*, METHOD_x, or 0 when it is not built.
+const struct _pt_method *ptMethod(short method)
+{
+	short i, n = (short)(sizeof(pt_methods) / sizeof(pt_methods[0]));
+
+	if (method >= 0 && method < n && pt_methods[method].id == method) // all built
+		return &(pt_methods[method]);
+
+	for (i = 0; i < n; i++)
+	{
+		if (pt_methods[i].id == method)
+			return &(pt_methods[i]);
+	}
+
+	return 0;
+}
+
+void ptSetMethod(struct _ptimes *pt, short method)
+{
+	const struct _pt_method *m = ptMethod(method);
+
+	if (m == 0)
+		return;
+	
+	pt->fajr_rel_d = m->params.fajr_rel_d;
+	pt->maghrib_rel_d = m->params.maghrib_rel_d;
+	pt->maghrib_rel_m = m->params.maghrib_rel_m;
+	pt->isha_rel_d = m->params.isha_rel_d;
+	pt->isha_rel_m = m->params.isha_rel_m;
+	pt->midnight_type = m->params.midnight_type;
+}
+
+// Adjust *prayer* time with *type* 'm'inutes or 'd'egrees of value *v*.
+void ptAdjust(struct _ptimes *pt, short prayer, char type, float v)
+{
+	if (type == 'm')
+		switch (prayer)
+		{
+			case 1: pt->imsak_rel_m = v; break;
+			case 2: pt->fajr_rel_m = v; break;
+			case 3: pt->dhuhr_rel_m = v; break;
+			case 4: pt->asr_rel_m = v; break;
+			case 5: pt->maghrib_rel_m = v; break;
+			case 6: pt->isha_rel_m = v; break;
+		}
+	else if (type == 'd')
+		switch (prayer)
+		{
+			case 1: pt->imsak_rel_d = v; break;
+			case 2: pt->fajr_rel_d = v; break;
+			case 5: pt->maghrib_rel_d = v; break;
+			case 6: pt->isha_rel_d = v; break;
+		}
+}
+
+// Set the fields given in batch record *r* to *pt*, and *last* to the
+// Julian date of the last date of its range, at most *max_days* days on.
+// Return 0 on success, -1 when the method is not built or the range ends
+// before its date.
+int ptSetRecord(struct _ptimes *pt, struct _ptrec *r, long max_days, double *last)
+{
+	short i;
+
+	if ((r->has & PTREC_METHOD) && ptMethod(r->method - 1) == 0)
+		return -1;
+
+	if (r->has & PTREC_LAT)
+		pt->lat = r->lat;
+
+	if (r->has & PTREC_LNG)
+		pt->lng = r->lng;
+
+	if (r->has & PTREC_ELV)
+		ptSetElevation(pt, r->elv);
+
+	if (r->has & PTREC_TZ)
+		pt->tz = r->tz;
+
+	if (r->has & PTREC_METHOD)
+		ptSetMethod(pt, r->method - 1);
+
+	for (i = 0; i < r->nadj; i++)
+		ptAdjust(pt, r->adj[i].prayer, r->adj[i].type, r->adj[i].v);
+
+	if (r->has & PTREC_DATE)
+		ptSetDate(pt, r->year, r->month, r->day);
+
+	*last = r->has & PTREC_TO ? julian(r->to_year, r->to_month, r->to_day) : pt->jd;
+
+	if (*last < pt->jd)
+		return -1;
+
+	if (*last - pt->jd > max_days)
+		*last = pt->jd + max_days;
+
+	return 0;
+}
+
+// *v* in units of 1 / *scale* rounded, within [*lo*, *hi*].
+static int16_t cfgFixed(float v, float scale, int16_t lo, int16_t hi)
+{
+	float f = v * scale;
+
+	if (f != f)
+		return 0;
+
+	if (f < lo)
+		return lo;
+
+	if (f > hi)
+		return hi;
+
+	return (int16_t)(f < 0.0f ? f - 0.5f : f + 0.5f);
+}
+
+// Pack the settings and location of *pt* to *cfg*.
+void ptCfgGet(const struct _ptimes *pt, struct _ptcfg *cfg)
+{
+	short i;
+
+	cfg->lat = pt->lat;
+	cfg->lng = pt->lng;
+	cfg->elv = cfgFixed(pt->elv, 1.0f, -32767, 32767);
+	cfg->tz = cfgFixed(pt->tz, 60.0f, -32767, 32767);
+	cfg->imsak_rel_d = cfgFixed(pt->imsak_rel_d, 100.0f, -32767, 32767);
+	cfg->imsak_rel_m = cfgFixed(pt->imsak_rel_m, 10.0f, -32767, 32767);
+	cfg->fajr_rel_d = cfgFixed(pt->fajr_rel_d, 100.0f, -32767, 32767);
+	cfg->fajr_rel_m = cfgFixed(pt->fajr_rel_m, 10.0f, -32767, 32767);
+	cfg->dhuhr_rel_m = cfgFixed(pt->dhuhr_rel_m, 10.0f, -32767, 32767);
+	cfg->asr_factor = (uint8_t)cfgFixed(pt->asr_factor, 10.0f, 0, 255);
+	cfg->asr_rel_m = cfgFixed(pt->asr_rel_m, 10.0f, -32767, 32767);
+	cfg->maghrib_rel_d = cfgFixed(pt->maghrib_rel_d, 100.0f, -32767, 32767);
+	cfg->maghrib_rel_m = cfgFixed(pt->maghrib_rel_m, 10.0f, -32767, 32767);
+	cfg->isha_rel_d = cfgFixed(pt->isha_rel_d, 100.0f, -32767, 32767);
+	cfg->isha_rel_m = cfgFixed(pt->isha_rel_m, 10.0f, -32767, 32767);
+	cfg->midnight_type = (uint8_t)pt->midnight_type;
+	cfg->high_lats = (uint8_t)pt->high_lats;
+	cfg->sun_model = PT_SUN_USNO;
+
+	for (i = 0; i < PT_SUN_MODELS; i++)
+	{
+		if (pt->sun_model == ptSunModel(i))
+		{
+			cfg->sun_model = (uint8_t)i;
+			break;
+		}
+	}
+}
+
+// Set the settings and location of *pt* from *cfg*, leaving its date.
+void ptCfgSet(struct _ptimes *pt, const struct _ptcfg *cfg)
+{
+	ptSetLocation(pt, cfg->lat, cfg->lng, cfg->elv, cfg->tz / 60.0f);
+	pt->imsak_rel_d = cfg->imsak_rel_d / 100.0f;
+	pt->imsak_rel_m = cfg->imsak_rel_m / 10.0f;
+	pt->fajr_rel_d = cfg->fajr_rel_d / 100.0f;
+	pt->fajr_rel_m = cfg->fajr_rel_m / 10.0f;
+	pt->dhuhr_rel_m = cfg->dhuhr_rel_m / 10.0f;
+	pt->asr_factor = cfg->asr_factor / 10.0f;
+	pt->asr_rel_m = cfg->asr_rel_m / 10.0f;
+	pt->maghrib_rel_d = cfg->maghrib_rel_d / 100.0f;
+	pt->maghrib_rel_m = cfg->maghrib_rel_m / 10.0f;
+	pt->isha_rel_d = cfg->isha_rel_d / 100.0f;
+	pt->isha_rel_m = cfg->isha_rel_m / 10.0f;
+	pt->midnight_type = cfg->midnight_type;
+	pt->high_lats = cfg->high_lats;
+	ptSetSunModel(pt, cfg->sun_model);
+}
@@ -0,0 +1,92 @@
+// ptmethod.h
+
+#ifndef __PTMETHOD_H__
+#define __PTMETHOD_H__
+
+#include "prayertimes.h"
+#include "ptparse.h"
+
+#define METHOD_MWL 0
+#define METHOD_ISNA 1
+#define METHOD_EGYPT 2
+#define METHOD_MAKKAH 3
+#define METHOD_KARACHI 4
+#define METHOD_TEHRAN 5
+#define METHOD_JAFARI 6
+#define METHODS 7
+
+// Bits of the methods built in pt_methods[], all by default.
+#ifndef PT_METHOD_MASK
+#define PT_METHOD_MASK 0x7F
+#endif
+
+#if !(PT_METHOD_MASK & ((1 << METHODS) - 1))
+#error "PT_METHOD_MASK builds no method"
+#endif
+
+struct _pt_method_params
+{
+	float fajr_rel_d;
+	float isha_rel_d;
+	float isha_rel_m;
+	float maghrib_rel_d;
+	float maghrib_rel_m;
+	short midnight_type;
+};
+
+struct _pt_method
+{
+	short id; // METHOD_x
+	const char *name;
+	const char *desc;
+	struct _pt_method_params params;
+};
+
+// Settings and location of struct _ptimes packed for keeping, i.e. in the
+// flash or RTC memory of a board, with struct _ptimes only while
+// calculating. 36 bytes, of fixed point:
+//  x_rel_d    hundredths of a degree
+//  x_rel_m    tenths of a minute
+//  asr_factor tenths
+//  elv        meters
+//  tz         minutes
+// so a 0:20 minute adjustment comes back as 0.3 min. Over the corpus of
+// ptref, with adjustments off these steps, the times of a round trip
+// through ptCfgGet() and ptCfgSet() move by under 8 seconds up to 45
+// degrees of latitude, and under PTCFG_BOUND where fajr and isha come near
+// the edge of twilight, i.e. 110 seconds at 65 degrees. make pareto fails
+// beyond it.
+#define PTCFG_BOUND 150.0 // seconds
+
+struct _ptcfg
+{
+	float lat;
+	float lng;
+	int16_t elv;
+	int16_t tz;
+	int16_t imsak_rel_d;
+	int16_t imsak_rel_m;
+	int16_t fajr_rel_d;
+	int16_t fajr_rel_m;
+	int16_t dhuhr_rel_m;
+	int16_t asr_rel_m;
+	int16_t maghrib_rel_d;
+	int16_t maghrib_rel_m;
+	int16_t isha_rel_d;
+	int16_t isha_rel_m;
+	uint8_t asr_factor;
+	uint8_t midnight_type;
+	uint8_t high_lats;
+	uint8_t sun_model; // PT_SUN_x
+};
+
+extern const struct _pt_method pt_methods[];
+
+const struct _pt_method *ptMethod(short method);
+void ptSetMethod(struct _ptimes *pt, short method);
+void ptAdjust(struct _ptimes *pt, short prayer, char type, float v);
+int ptSetRecord(struct _ptimes *pt, struct _ptrec *r, long max_days, double *last);
+void ptCfgGet(const struct _ptimes *pt, struct _ptcfg *cfg);
+void ptCfgSet(struct _ptimes *pt, const struct _ptcfg *cfg);
+
+#endif
@@ -0,0 +1,345 @@
+// ptparse.c
+// Batch input parser
+// Parses location records in place from a buffer. Every routine works on
+// a [s, e) range, stops at the first character it does not accept and
+// returns where it stopped, so nothing is copied, terminated or allocated.
+
+#include "ptparse.h"
+
+// Notes:
+// 1. A CSV record is:
+//      id,lat,lng,elv,tz,method,date[,to[,adjustments]]
+//     Any field may be left empty for the defaults. A line starting with
+//     a letter, i.e. a header, or with # is skipped.
+// 2. A JSON Lines record is a flat object with the same keys:
+//      {"id":1,"lat":"1:43","lng":103.53,"tz":8,"method":3,
+//       "date":"2018-10-01","to":"2018-10-31","adj":"2d18.5 6m90"}
+//     Values may be numbers or strings.
+// 3. Numbers are decimal or in clock/compass notation [+/-]deg:min:sec,
+//     where each part may have a decimal fraction.
+// 4. Adjustments are separated by spaces or semicolons. Each one is
+//     <prayer time><m|d><value> as of the "a" option of pt, i.e. 6m90
+//     for isha 90 minutes after maghrib.
+// 5. A date that is not in the Gregorian calendar, i.e. 2024-02-30, is not
+//     valid. A method that is not built and a range that ends before its
+//     date are left to ptSetRecord(), which knows the defaults.
+//
+
+static int isdig(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+// Days of *month* of *year* in the Gregorian calendar.
+static short monthDays(short year, short month)
+{
+	static const short days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+	if (month == 2 && year % 4 == 0 && (year % 100 != 0 || year % 400 == 0))
+		return 29;
+
+	return days[month - 1];
+}
+
+static const char *skip(const char *s, const char *e)
+{
+	while (s < e && (*s == ' ' || *s == '\t' || *s == '\r'))
+		++s;
+
+	return s;
+}
+
+// Parse an unsigned decimal number into *v*.
+static const char *decimal(const char *s, const char *e, double *v)
+{
+	double q = 0.0, dp = 1.0;
+
+	*v = 0.0;
+
+	while (s < e && isdig(*s))
+		*v = *v * 10.0 + (double)(*s++ - '0');
+
+	if (s < e && *s == '.')
+	{
+		++s;
+
+		while (s < e && isdig(*s))
+		{
+			q = q * 10.0 + (double)(*s++ - '0');
+			dp *= 10.0;
+		}
+
+		*v += q / dp;
+	}
+
+	return s;
+}
+
+// Parse a number, decimal or [+/-]deg:min:sec, into *v*.
+// Return *s* when there is no number.
+const char *ps_num(const char *s, const char *e, double *v)
+{
+	const char *b = s, *p;
+	double m = 1.0, sc = 1.0, x;
+	short i;
+
+	*v = 0.0;
+	s = skip(s, e);
+
+	if (s < e && (*s == '-' || *s == '+'))
+	{
+		if (*s == '-')
+			m = -1.0;
+
+		++s;
+	}
+
+	if (s >= e || (!isdig(*s) && *s != '.'))
+		return b;
+
+	for (i = 0; i < 3; i++)
+	{
+		p = s;
+		s = decimal(s, e, &x);
+
+		if (s == p)
+			break;
+
+		*v += x * sc;
+		sc /= 60.0;
+
+		if (s + 1 < e && *s == ':' && isdig(s[1]))
+			++s;
+		else
+			break;
+	}
+
+	*v *= m;
+
+	return s;
+}
+
+// Parse a date yyyy-mm-dd. Return *s* when there is no date, or when it
+// is not a day of the calendar.
+const char *ps_date(const char *s, const char *e, short *y, short *m, short *d)
+{
+	const char *b = s;
+	short *p[3], i;
+
+	p[0] = y;
+	p[1] = m;
+	p[2] = d;
+
+	s = skip(s, e);
+
+	for (i = 0; i < 3; i++)
+	{
+		*(p[i]) = 0;
+
+		if (s >= e || !isdig(*s))
+			return b;
+
+		while (s < e && isdig(*s))
+			*(p[i]) = *(p[i]) * 10 + (short)(*s++ - '0');
+
+		if (i < 2)
+		{
+			if (s >= e || *s != '-')
+				return b;
+
+			++s;
+		}
+	}
+
+	if (*m < 1 || *m > 12 || *d < 1 || *d > monthDays(*y, *m))
+		return b;
+
+	return s;
+}
+
+// Parse adjustments into *r*.
+const char *ps_adj(const char *s, const char *e, struct _ptrec *r)
+{
+	double v;
+	const char *p;
+	short a;
+	char t;
+
+	while (1)
+	{
+		while (s < e && (*s == ' ' || *s == '\t' || *s == ';'))
+			++s;
+
+		if (s + 2 >= e || !isdig(s[0]) || (s[1] != 'm' && s[1] != 'd'))
+			break;
+
+		a = (short)(s[0] - '0');
+		t = s[1];
+		p = s + 2;
+		s = ps_num(p, e, &v);
+
+		if (s == p)
+			break;
+
+		if (r->nadj < PTREC_MAX_ADJ)
+		{
+			r->adj[r->nadj].prayer = a;
+			r->adj[r->nadj].type = t;
+			r->adj[r->nadj].v = (float)v;
+			r->nadj++;
+		}
+	}
+
+	return s;
+}
+
+// Parse field number *i* of a record from the value in [s, e).
+// Return 0 when the value is not valid.
+static int field(short i, const char *s, const char *e, struct _ptrec *r)
+{
+	double v;
+	const char *p;
+
+	s = skip(s, e);
+
+	if (s >= e) // empty, left to the default
+		return 1;
+
+	switch (i)
+	{
+		case 0: p = ps_num(s, e, &v); r->id = (long)v; r->has |= PTREC_ID; break;
+		case 1: p = ps_num(s, e, &v); r->lat = (float)v; r->has |= PTREC_LAT; break;
+		case 2: p = ps_num(s, e, &v); r->lng = (float)v; r->has |= PTREC_LNG; break;
+		case 3: p = ps_num(s, e, &v); r->elv = (float)v; r->has |= PTREC_ELV; break;
+		case 4: p = ps_num(s, e, &v); r->tz = (float)v; r->has |= PTREC_TZ; break;
+		case 5: p = ps_num(s, e, &v); r->method = (short)v; r->has |= PTREC_METHOD; break;
+
+		case 6:
+			p = ps_date(s, e, &(r->year), &(r->month), &(r->day));
+			r->has |= PTREC_DATE;
+			break;
+
+		case 7:
+			p = ps_date(s, e, &(r->to_year), &(r->to_month), &(r->to_day));
+			r->has |= PTREC_TO;
+			break;
+
+		case 8: p = ps_adj(s, e, r); break;
+
+		default: return 1; // ignore extra fields
+	}
+
+	return p != s && skip(p, e) == e;
+}
+
+// Key number of a JSON key in [s, e), -1 if unknown.
+static short key(const char *s, const char *e)
+{
+	static const char *keys[] = {"id", "lat", "lng", "elv", "tz", "method", "date", "to", "adj"};
+	const char *k, *p;
+	short i;
+
+	for (i = 0; i < 9; i++)
+	{
+		for (k = keys[i], p = s; p < e && *k != '\0' && *p == *k; ++p, ++k);
+
+		if (p == e && *k == '\0')
+			return i;
+	}
+
+	return -1;
+}
+
+static int parseJson(const char *s, const char *e, struct _ptrec *r)
+{
+	const char *k, *ke, *v, *ve;
+	short i;
+
+	s = skip(s + 1, e); // after {
+
+	while (s < e && *s != '}')
+	{
+		if (*s != '"')
+			return -1;
+
+		k = ++s;
+
+		while (s < e && *s != '"')
+			++s;
+
+		ke = s++;
+		s = skip(s, e);
+
+		if (s >= e || *s != ':')
+			return -1;
+
+		s = skip(s + 1, e);
+
+		if (s < e && *s == '"') // string
+		{
+			v = ++s;
+
+			while (s < e && *s != '"')
+				++s;
+
+			ve = s++;
+		}
+		else // number
+		{
+			v = s;
+
+			while (s < e && *s != ',' && *s != '}')
+				++s;
+
+			ve = s;
+		}
+
+		i = key(k, ke);
+
+		if (i >= 0 && !field(i, v, ve, r))
+			return -1;
+
+		s = skip(s, e);
+
+		if (s < e && *s == ',')
+			s = skip(s + 1, e);
+	}
+
+	return s < e ? 1 : -1;
+}
+
+static int parseCsv(const char *s, const char *e, struct _ptrec *r)
+{
+	const char *p;
+	short i;
+
+	for (i = 0; s <= e; i++)
+	{
+		for (p = s; p < e && *p != ','; ++p);
+
+		if (!field(i, s, p, r))
+			return -1;
+
+		s = p + 1;
+	}
+
+	return 1;
+}
+
+// Parse a line [s, e) of CSV or JSON Lines into *r*.
+// Return 1 for a record, 0 for a line to skip, and -1 when not valid.
+int ptParseRecord(const char *s, const char *e, struct _ptrec *r)
+{
+	r->has = 0;
+	r->nadj = 0;
+
+	s = skip(s, e);
+
+	if (s >= e || *s == '#' || (*s >= 'a' && *s <= 'z') || (*s >= 'A' && *s <= 'Z'))
+		return 0;
+
+	if (*s == '{')
+		return parseJson(s, e, r);
+
+	return parseCsv(s, e, r);
+}
@@ -0,0 +1,51 @@
+// ptparse.h
+
+#ifndef __PTPARSE_H__
+#define __PTPARSE_H__
+
+#define PTREC_MAX_ADJ 12
+
+// Record fields given in the input. The rest are left to the defaults.
+#define PTREC_ID 0x0001
+#define PTREC_LAT 0x0002
+#define PTREC_LNG 0x0004
+#define PTREC_ELV 0x0008
+#define PTREC_TZ 0x0010
+#define PTREC_METHOD 0x0020
+#define PTREC_DATE 0x0040
+#define PTREC_TO 0x0080
+
+// Prayer time adjustment as of the "a" option of pt.
+struct _ptadj
+{
+	short prayer; // 1 imsak, 2 fajr, 3 dhuhr, 4 asr, 5 maghrib, 6 isha
+	char type;    // 'm'inutes or 'd'egrees
+	float v;
+};
+
+// A batch input record of a location and a date or a date range.
+struct _ptrec
+{
+	unsigned short has; // PTREC_ID etc.
+	long id;
+	float lat;
+	float lng;
+	float elv;
+	float tz;
+	short method; // 1-7 as of the "m" option of pt
+	short year;   // first date
+	short month;
+	short day;
+	short to_year; // last date of a range
+	short to_month;
+	short to_day;
+	short nadj;
+	struct _ptadj adj[PTREC_MAX_ADJ];
+};
+
+const char *ps_num(const char *s, const char *e, double *v);
+const char *ps_date(const char *s, const char *e, short *y, short *m, short *d);
+const char *ps_adj(const char *s, const char *e, struct _ptrec *r);
+int ptParseRecord(const char *s, const char *e, struct _ptrec *r);
+
+#endif
@@ -0,0 +1,300 @@
+// ptpipe.c
+// Pipelined batch calculation
+// Runs the parsing of batch input, the calculation of prayer times and
+// the formatting of output as stages on their own threads, connected by
+// single-producer single-consumer rings of fixed-size batches.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "ptpipe.h"
+
+// Notes:
+// 1. The parse stage runs on the calling thread through ptPipeAdd(). It
+//     hands out full batches to the calculation lanes in turn and the
+//     format stage takes them back in the same turn, so the output keeps
+//     the order of the input with no reordering buffer.
+// 2. Every lane owns PTPIPE_DEPTH batches. A batch goes back to the parse
+//     stage only once formatted, so a slow stage stalls the ones before
+//     it when the batches run out, and memory stays bounded.
+// 3. A stage waiting on a ring yields the CPU. The time it waits is
+//     counted apart from the time it works, so the slowest stage is the
+//     one with the least waiting.
+// 4. At the end, a last empty batch is sent down every lane in turn.
+//
+
+static double now(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+static void push(struct _ptring *r, void *b, struct _ptpipe_stat *st)
+{
+	double t;
+
+	if (ptRingPush(r, b))
+		return;
+
+	t = now();
+
+	while (!ptRingPush(r, b))
+		sched_yield();
+
+	st->wait += now() - t;
+}
+
+static void *pop(struct _ptring *r, struct _ptpipe_stat *st)
+{
+	void *b;
+	double t;
+
+	if ((b = ptRingPop(r)) != 0)
+		return b;
+
+	t = now();
+
+	while ((b = ptRingPop(r)) == 0)
+		sched_yield();
+
+	st->wait += now() - t;
+
+	return b;
+}
+
+// Calculation stage of a lane.
+// Consecutive items of the same date share the positions of the Sun.
+static void *calc(void *arg)
+{
+	struct _ptpipe_lane *l = arg;
+	struct _ptpipe_batch *b;
+	struct _ptsun sun;
+	struct _ptimes *pt;
+	double t;
+	long i;
+
+	sun.jd = 0.0;
+
+	while (1)
+	{
+		b = pop(&(l->in), &(l->stat));
+
+		if (b->last)
+		{
+			push(&(l->out), b, &(l->stat));
+			return 0;
+		}
+
+		t = now();
+
+		for (i = 0; i < b->n; i++)
+		{
+			pt = &(b->item[i].pt);
+
+			if (sun.jd != pt->jd || sun.model != pt->sun_model)
+				ptSunInit(&sun, pt->jd, pt->sun_model);
+
+			pt->sun = &sun;
+			pt->phase = 0;
+
+			while (ptCalc(pt) != 0);
+
+			pt->sun = 0;
+		}
+
+		l->stat.batches++;
+		l->stat.items += b->n;
+		l->stat.busy += now() - t;
+
+		push(&(l->out), b, &(l->stat));
+	}
+}
+
+// Format stage.
+static void *format(void *arg)
+{
+	struct _ptpipe *p = arg;
+	struct _ptpipe_stat *st = &(p->stat[PTPIPE_FORMAT]);
+	struct _ptpipe_batch *b;
+	struct _ptpipe_item *it;
+	double t;
+	long i;
+	int k = 0;
+
+	while (1)
+	{
+		b = pop(&(p->lane[k].out), st);
+
+		if (b->last)
+			return 0;
+
+		t = now();
+
+		for (i = 0; i < b->n; i++)
+		{
+			it = &(b->item[i]);
+			p->fn(p->arg, &(it->pt), it->has_id ? &(it->id) : 0);
+		}
+
+		st->batches++;
+		st->items += b->n;
+		st->busy += now() - t;
+
+		push(&(p->lane[k].free), b, st);
+		k = (k + 1) % p->lanes;
+	}
+}
+
+// Take a free batch of the next lane for the parse stage.
+static void take(struct _ptpipe *p)
+{
+	p->cur = pop(&(p->lane[p->next].free), &(p->stat[PTPIPE_PARSE]));
+	p->cur->n = 0;
+	p->cur->last = 0;
+}
+
+// Send the current batch down its lane.
+static void send(struct _ptpipe *p)
+{
+	struct _ptpipe_stat *st = &(p->stat[PTPIPE_PARSE]);
+
+	st->batches++;
+	st->items += p->cur->n;
+	push(&(p->lane[p->next].in), p->cur, st);
+	p->next = (p->next + 1) % p->lanes;
+}
+
+// Start a pipeline of *lanes* calculation threads, 0 for one per online
+// CPU, giving the prayer times to *fn* in the order they are added.
+// Return 0 on success, -1 on failure.
+int ptPipeInit(struct _ptpipe *p, int lanes, ptpipe_fn fn, void *arg)
+{
+	struct _ptpipe_lane *l;
+	short s;
+	int i, k;
+
+	if (lanes <= 0)
+		lanes = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (lanes < 1)
+		lanes = 1;
+	else if (lanes > PTPIPE_MAX_LANES)
+		lanes = PTPIPE_MAX_LANES;
+
+	p->lane = calloc(lanes, sizeof(struct _ptpipe_lane));
+
+	if (p->lane == 0)
+		return -1;
+
+	p->lanes = lanes;
+	p->fn = fn;
+	p->arg = arg;
+	p->next = 0;
+	p->t0 = now();
+
+	for (s = 0; s < PTPIPE_STAGES; s++)
+	{
+		p->stat[s].batches = 0;
+		p->stat[s].items = 0;
+		p->stat[s].busy = 0.0;
+		p->stat[s].wait = 0.0;
+	}
+
+	for (i = 0; i < lanes; i++)
+	{
+		l = &(p->lane[i]);
+		l->p = p;
+		ptRingInit(&(l->in));
+		ptRingInit(&(l->out));
+		ptRingInit(&(l->free));
+
+		for (k = 0; k < PTPIPE_DEPTH; k++)
+			ptRingPush(&(l->free), &(l->batch[k]));
+	}
+
+	for (i = 0; i < lanes; i++)
+	{
+		if (pthread_create(&(p->lane[i].th), 0, calc, &(p->lane[i])) != 0)
+			break;
+	}
+
+	if (i < lanes || pthread_create(&(p->th), 0, format, p) != 0)
+	{
+		// stop the lanes started
+		for (k = 0; k < i; k++)
+		{
+			p->lane[k].batch[0].n = 0;
+			p->lane[k].batch[0].last = 1;
+			ptRingPush(&(p->lane[k].in), &(p->lane[k].batch[0]));
+			pthread_join(p->lane[k].th, 0);
+		}
+
+		free(p->lane);
+		return -1;
+	}
+
+	take(p);
+
+	return 0;
+}
+
+// Add prayer times *pt* to calculate for location *id*, 0 if none.
+void ptPipeAdd(struct _ptpipe *p, struct _ptimes *pt, long *id)
+{
+	struct _ptpipe_item *it = &(p->cur->item[p->cur->n++]);
+
+	it->pt = *pt;
+	it->has_id = id != 0;
+	it->id = id != 0 ? *id : 0;
+
+	if (p->cur->n == PTPIPE_BATCH)
+	{
+		send(p);
+		take(p);
+	}
+}
+
+// Calculate and output the prayer times added, stop the threads and sum
+// up the counters of the stages in *p->stat*.
+void ptPipeClose(struct _ptpipe *p)
+{
+	struct _ptpipe_stat *st = &(p->stat[PTPIPE_PARSE]);
+	int i;
+
+	if (p->cur->n > 0)
+	{
+		send(p);
+		take(p);
+	}
+
+	for (i = 0; i < p->lanes; i++)
+	{
+		if (i > 0)
+			take(p);
+
+		p->cur->last = 1;
+		push(&(p->lane[p->next].in), p->cur, st);
+		p->next = (p->next + 1) % p->lanes;
+	}
+
+	pthread_join(p->th, 0);
+
+	for (i = 0; i < p->lanes; i++)
+	{
+		pthread_join(p->lane[i].th, 0);
+		p->stat[PTPIPE_CALC].batches += p->lane[i].stat.batches;
+		p->stat[PTPIPE_CALC].items += p->lane[i].stat.items;
+		p->stat[PTPIPE_CALC].busy += p->lane[i].stat.busy;
+		p->stat[PTPIPE_CALC].wait += p->lane[i].stat.wait;
+	}
+
+	st->busy = now() - p->t0 - st->wait;
+
+	free(p->lane);
+}
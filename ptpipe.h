@@ -0,0 +1,79 @@
+// ptpipe.h
+
+#ifndef __PTPIPE_H__
+#define __PTPIPE_H__
+
+#include <pthread.h>
+#include "prayertimes.h"
+#include "ptring.h"
+
+#define PTPIPE_BATCH 256 // prayer times of a batch
+#define PTPIPE_DEPTH 8   // batches of a lane, up to PTRING_SIZE
+#define PTPIPE_MAX_LANES 64
+
+// Stages of a pipeline.
+#define PTPIPE_PARSE 0
+#define PTPIPE_CALC 1
+#define PTPIPE_FORMAT 2
+#define PTPIPE_STAGES 3
+
+// Output the prayer times *pt* of location *id*, 0 if none.
+typedef void (*ptpipe_fn)(void *arg, struct _ptimes *pt, long *id);
+
+struct _ptpipe_item
+{
+	struct _ptimes pt;
+	long id;
+	short has_id;
+};
+
+struct _ptpipe_batch
+{
+	long n;
+	short last; // no more batches
+	struct _ptpipe_item item[PTPIPE_BATCH];
+};
+
+// Throughput counters of a stage.
+struct _ptpipe_stat
+{
+	long batches;
+	long items;
+	double busy; // seconds
+	double wait; // seconds waiting for input or for room for output
+};
+
+struct _ptpipe;
+
+// A calculation thread with its batches, which go around from the parse
+// stage through *in*, *out* and *free* back to the parse stage.
+struct _ptpipe_lane
+{
+	struct _ptring in;
+	struct _ptring out;
+	struct _ptring free;
+	struct _ptpipe *p;
+	pthread_t th;
+	struct _ptpipe_stat stat;
+	struct _ptpipe_batch batch[PTPIPE_DEPTH];
+};
+
+// Parse, calculation and format stages running on their own threads.
+struct _ptpipe
+{
+	int lanes;
+	struct _ptpipe_lane *lane;
+	pthread_t th; // format stage
+	ptpipe_fn fn;
+	void *arg;
+	struct _ptpipe_batch *cur; // being filled by the parse stage
+	int next; // lane of the batch being filled
+	double t0;
+	struct _ptpipe_stat stat[PTPIPE_STAGES];
+};
+
+int ptPipeInit(struct _ptpipe *p, int lanes, ptpipe_fn fn, void *arg);
+void ptPipeAdd(struct _ptpipe *p, struct _ptimes *pt, long *id);
+void ptPipeClose(struct _ptpipe *p);
+
+#endif
@@ -0,0 +1,217 @@
+// ptpool.c
+// Work-stealing thread pool
+// Runs a number of independent tasks on a thread per CPU. Every worker
+// starts with an even share of the tasks and steals half of the tasks
+// left by another worker once it runs out.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <unistd.h>
+#include "ptpool.h"
+
+// Notes:
+// 1. A worker takes its tasks from the low end of its range and a thief
+//     takes the upper half, both with a compare-and-swap of the whole
+//     range. No lock is taken while tasks run.
+// 2. Tasks are only split and never created while running. Hence a
+//     worker which finds every range empty has nothing more to do.
+// 3. The threads wait between runs so that a pool is started once and
+//     reused, i.e. for every block of a batch input.
+// 4. A run has at most 2^31 tasks.
+//
+
+#define RANGE(lo, hi) (((uint64_t)(uint32_t)(hi) << 32) | (uint64_t)(uint32_t)(lo))
+#define LO(r) ((long)(uint32_t)(r))
+#define HI(r) ((long)((r) >> 32))
+
+// Take the next task of worker *w*, -1 when its range is empty.
+static long pop(struct _ptpool *p, int w)
+{
+	uint64_t r = __atomic_load_n(&(p->q[w].r), __ATOMIC_ACQUIRE);
+
+	while (LO(r) < HI(r))
+	{
+		if (__atomic_compare_exchange_n(&(p->q[w].r), &r, RANGE(LO(r) + 1, HI(r)), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			return LO(r);
+	}
+
+	return -1;
+}
+
+// Steal the upper half of the tasks of another worker into the empty
+// range of worker *w*. Return 0 when there is nothing left to steal.
+static int steal(struct _ptpool *p, int w)
+{
+	uint64_t r;
+	long mid;
+	int i, v;
+
+	for (i = 1; i < p->threads; i++)
+	{
+		v = (w + i) % p->threads;
+		r = __atomic_load_n(&(p->q[v].r), __ATOMIC_ACQUIRE);
+
+		while (LO(r) < HI(r))
+		{
+			mid = LO(r) + (HI(r) - LO(r)) / 2;
+
+			if (__atomic_compare_exchange_n(&(p->q[v].r), &r, RANGE(LO(r), mid), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			{
+				__atomic_store_n(&(p->q[w].r), RANGE(mid, HI(r)), __ATOMIC_RELEASE);
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static void work(struct _ptpool *p, int w)
+{
+	long t;
+
+	do
+	{
+		while ((t = pop(p, w)) >= 0)
+			p->fn(p->arg, t, w);
+	}
+	while (steal(p, w));
+}
+
+static void *worker(void *arg)
+{
+	struct _ptpool_worker *q = arg;
+	struct _ptpool *p = q->p;
+	long gen = 0;
+
+	pthread_mutex_lock(&(p->lock));
+
+	while (1)
+	{
+		while (p->gen == gen && !p->quit)
+			pthread_cond_wait(&(p->start), &(p->lock));
+
+		if (p->quit)
+			break;
+
+		gen = p->gen;
+		pthread_mutex_unlock(&(p->lock));
+
+		work(p, q->w);
+
+		pthread_mutex_lock(&(p->lock));
+
+		if (--(p->running) == 0)
+			pthread_cond_signal(&(p->done));
+	}
+
+	pthread_mutex_unlock(&(p->lock));
+	return 0;
+}
+
+// Start a pool of *threads* workers including the calling thread,
+// 0 for one per online CPU. Return 0 on success, -1 on failure.
+int ptPoolInit(struct _ptpool *p, int threads)
+{
+	int i;
+
+	if (threads <= 0)
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (threads < 1)
+		threads = 1;
+	else if (threads > PTPOOL_MAX_THREADS)
+		threads = PTPOOL_MAX_THREADS;
+
+	p->threads = threads;
+	p->gen = 0;
+	p->running = 0;
+	p->quit = 0;
+	p->q = calloc(threads, sizeof(struct _ptpool_worker));
+	p->th = calloc(threads, sizeof(pthread_t));
+
+	if (p->q == 0 || p->th == 0)
+	{
+		free(p->q);
+		free(p->th);
+		return -1;
+	}
+
+	pthread_mutex_init(&(p->lock), 0);
+	pthread_cond_init(&(p->start), 0);
+	pthread_cond_init(&(p->done), 0);
+
+	for (i = 0; i < threads; i++)
+	{
+		p->q[i].p = p;
+		p->q[i].w = i;
+	}
+
+	for (i = 1; i < threads; i++)
+	{
+		if (pthread_create(&(p->th[i]), 0, worker, &(p->q[i])) != 0)
+		{
+			p->threads = i; // run with the threads started
+			break;
+		}
+	}
+
+	return 0;
+}
+
+// Run *tasks* calls of *fn* on the pool and wait for all of them.
+void ptPoolRun(struct _ptpool *p, long tasks, ptpool_fn fn, void *arg)
+{
+	int i;
+
+	if (tasks <= 0)
+		return;
+
+	p->fn = fn;
+	p->arg = arg;
+
+	for (i = 0; i < p->threads; i++)
+		p->q[i].r = RANGE(tasks * i / p->threads, tasks * (i + 1) / p->threads);
+
+	if (p->threads == 1)
+	{
+		work(p, 0);
+		return;
+	}
+
+	pthread_mutex_lock(&(p->lock));
+	p->running = p->threads - 1;
+	p->gen++;
+	pthread_cond_broadcast(&(p->start));
+	pthread_mutex_unlock(&(p->lock));
+
+	work(p, 0);
+
+	pthread_mutex_lock(&(p->lock));
+
+	while (p->running > 0)
+		pthread_cond_wait(&(p->done), &(p->lock));
+
+	pthread_mutex_unlock(&(p->lock));
+}
+
+// Stop the workers and release the pool.
+void ptPoolFree(struct _ptpool *p)
+{
+	int i;
+
+	pthread_mutex_lock(&(p->lock));
+	p->quit = 1;
+	pthread_cond_broadcast(&(p->start));
+	pthread_mutex_unlock(&(p->lock));
+
+	for (i = 1; i < p->threads; i++)
+		pthread_join(p->th[i], 0);
+
+	pthread_mutex_destroy(&(p->lock));
+	pthread_cond_destroy(&(p->start));
+	pthread_cond_destroy(&(p->done));
+	free(p->q);
+	free(p->th);
+}
@@ -0,0 +1,46 @@
+// ptpool.h
+
+#ifndef __PTPOOL_H__
+#define __PTPOOL_H__
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define PTPOOL_MAX_THREADS 256
+
+// Run task number *task* on *worker*, 0 being the calling thread.
+typedef void (*ptpool_fn)(void *arg, long task, int worker);
+
+struct _ptpool;
+
+// A worker and its range of tasks [lo, hi), both halves of one 64-bit word
+// so that the owner and thieves update it with a single compare-and-swap.
+struct _ptpool_worker
+{
+	uint64_t r;
+	struct _ptpool *p;
+	int w;
+	char pad[64 - sizeof(uint64_t) - sizeof(void *) - sizeof(int)]; // a cache line each
+};
+
+// Work-stealing thread pool.
+struct _ptpool
+{
+	int threads;
+	pthread_t *th;
+	struct _ptpool_worker *q;
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	long gen;     // run generation the workers wait for
+	int running;  // workers still in the current run
+	int quit;
+	ptpool_fn fn;
+	void *arg;
+};
+
+int ptPoolInit(struct _ptpool *p, int threads);
+void ptPoolRun(struct _ptpool *p, long tasks, ptpool_fn fn, void *arg);
+void ptPoolFree(struct _ptpool *p);
+
+#endif
@@ -0,0 +1,776 @@
+// ptpy.c
+// Python module of the prayer times library
+// A CPython extension, "import prayertimes", with the times of a single
+// location-day and batch calls that read their inputs from and write
+// their outputs to any buffer, i.e. NumPy arrays, without copying them.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "prayertimes.h"
+#include "ptmethod.h"
+#include "ptpool.h"
+#include "ptgrid.h"
+#include "ptkern.h"
+#include "ptres.h"
+#include "ptarena.h"
+
+// Notes:
+// 1. Buffers are taken with the buffer protocol, C contiguous, of float64
+//     for the coordinates and the times and of int32 or int64 for the
+//     dates. NumPy arrays, array.array and memoryviews all work. An input
+//     of one item is used for every row.
+// 2. Dates are days since 1970-01-01, the integers of NumPy datetime64[D],
+//     i.e. dates.astype("datetime64[D]").astype("int64").
+// 3. Times are in hours of the local time of every row, as ptCalc() gives
+//     them, NAN when there is none. The row i of batch() is at
+//     out[i * 9 : i * 9 + 9], in the order of FIELDS.
+// 4. The GIL is released while calculating, so batch() and grid() run in
+//     parallel on threads of the caller. Their *threads* argument also
+//     spreads one call over a ptpool of as many threads.
+// 5. utc() turns the times of batch() into Unix times, int64 seconds since
+//     1970-01-01 UTC, on the days before or after the date of the row for
+//     hours below 0 or from 24 on, and NO_TIME when there is none.
+// 6. Rows of the same date next to each other share the positions of the
+//     Sun, as in the b option of pt, and are calculated together by the
+//     vectorized kernels of ptkern.c, so sorting by date is faster. A
+//     PT_KERN the CPU cannot run is warned of on import.
+// 7. compact() keeps the times of grid() as the compact results of
+//     ptres.h, taken from one arena, and gives them as a Results buffer
+//     that owns the arena, so a bulk run costs a single allocation and
+//     no copy. The flags word has a bit for every time of none and the
+//     PT_HL_x bits of the times moved for the high latitudes from bit 9.
+//
+
+#define PY_TASK 4096 // rows of a batch task
+#define PY_RUN 256 // rows of a date calculated together
+#define PY_EPOCH 2440587.5 // Julian date of 1970-01-01
+
+// A column of batch input, of one item or one per row.
+struct _pycol
+{
+	Py_buffer view;
+	char type; // 'd' float64, 'i' int32, 'q' int64
+	Py_ssize_t n;
+};
+
+// A batch call.
+struct _pybatch
+{
+	struct _ptimes def; // settings of every row
+	struct _pycol col[5]; // lat, lng, elv, tz, days
+	Py_ssize_t n;
+	double *out;
+};
+
+static const char *fields[PT_FIELDS] =
+{
+	"imsak", "fajr", "sunrise", "dhuhr", "asr", "sunset", "maghrib", "isha", "midnight"
+};
+
+// Type of the items of buffer *b*, 0 for none of ours.
+static char bufType(Py_buffer *b)
+{
+	const char *f = b->format != 0 ? b->format : "B";
+
+	if (*f == '@' || *f == '=')
+		++f;
+
+	if (f[0] == '\0' || f[1] != '\0')
+		return 0;
+
+	if (*f == 'd' && b->itemsize == 8)
+		return 'd';
+
+	if ((*f == 'i' || *f == 'l') && b->itemsize == 4)
+		return 'i';
+
+	if ((*f == 'l' || *f == 'q') && b->itemsize == 8)
+		return 'q';
+
+	return 0;
+}
+
+// Take column *c* of object *o*, of *types*. Return 0, or -1 with the
+// Python error set.
+static int colGet(struct _pycol *c, PyObject *o, const char *types, const char *name)
+{
+	if (PyObject_GetBuffer(o, &(c->view), PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0)
+		return -1;
+
+	c->type = bufType(&(c->view));
+	c->n = c->view.len / (c->view.itemsize > 0 ? c->view.itemsize : 1);
+
+	if (c->type == 0 || strchr(types, c->type) == 0)
+	{
+		PyErr_Format(PyExc_TypeError, "%s must be a buffer of %s", name,
+			types[0] == 'd' ? "float64" : "int32 or int64");
+		PyBuffer_Release(&(c->view));
+		return -1;
+	}
+
+	return 0;
+}
+
+static double colDouble(struct _pycol *c, Py_ssize_t i)
+{
+	return ((double *)c->view.buf)[c->n > 1 ? i : 0];
+}
+
+static long colLong(struct _pycol *c, Py_ssize_t i)
+{
+	if (c->n == 1)
+		i = 0;
+
+	return c->type == 'i' ? (long)((int32_t *)c->view.buf)[i] : (long)((int64_t *)c->view.buf)[i];
+}
+
+// Settings of the keyword arguments on top of the defaults.
+static int settings(struct _ptimes *pt, int method, double asr, int high_lats, int model)
+{
+	ptInit(pt);
+
+	if (ptMethod(method - 1) == 0)
+	{
+		PyErr_Format(PyExc_ValueError, "no method %d", method);
+		return -1;
+	}
+
+	if (model < 1 || model > PT_SUN_MODELS)
+	{
+		PyErr_Format(PyExc_ValueError, "no model %d", model);
+		return -1;
+	}
+
+	ptSetMethod(pt, (short)(method - 1));
+	ptSetSunModel(pt, (short)(model - 1));
+	pt->asr_factor = (float)asr;
+	pt->high_lats = (short)high_lats;
+
+	return 0;
+}
+
+static void batchTask(void *arg, long task, int worker)
+{
+	struct _pybatch *b = arg;
+	const struct _ptkern *k = ptKern();
+	struct _ptimes pt = b->def;
+	struct _ptsun sun;
+	Py_ssize_t i = (Py_ssize_t)task * PY_TASK, e = i + PY_TASK, r;
+	float lat[PY_RUN], lng[PY_RUN], elv[PY_RUN], tz[PY_RUN];
+	short y, m, d;
+	long days;
+	int n;
+
+	sun.jd = 0.0;
+
+	if (e > b->n)
+		e = b->n;
+
+	for (; i < e; i += n)
+	{
+		days = colLong(&(b->col[4]), i);
+
+		for (n = 0, r = i; r < e && n < PY_RUN && colLong(&(b->col[4]), r) == days; r++, n++)
+		{
+			lat[n] = (float)colDouble(&(b->col[0]), r);
+			lng[n] = (float)colDouble(&(b->col[1]), r);
+			elv[n] = (float)colDouble(&(b->col[2]), r);
+			tz[n] = (float)colDouble(&(b->col[3]), r);
+		}
+
+		gregorian((double)days + PY_EPOCH, &y, &m, &d);
+		pt.jd = julian(y, m, d);
+
+		if (sun.jd != pt.jd)
+			ptSunInit(&sun, pt.jd, pt.sun_model);
+
+		k->times(&pt, &sun, lat, lng, elv, tz, n, b->out + i * PT_FIELDS, PT_FIELDS, 0);
+	}
+}
+
+// Run *tasks* of *fn* on *threads*, without the GIL. Return 0, or -1 with
+// the Python error set.
+static int run(long tasks, ptpool_fn fn, void *arg, int threads)
+{
+	struct _ptpool pool;
+	long t;
+	int r = 0;
+
+	Py_BEGIN_ALLOW_THREADS
+
+	if (threads > 1 && tasks > 1)
+	{
+		if (ptPoolInit(&pool, threads) == 0)
+		{
+			ptPoolRun(&pool, tasks, fn, arg);
+			ptPoolFree(&pool);
+		}
+		else
+			r = -1;
+	}
+	else
+	{
+		for (t = 0; t < tasks; t++)
+			fn(arg, t, 0);
+	}
+
+	Py_END_ALLOW_THREADS
+
+	if (r != 0)
+		PyErr_SetString(PyExc_RuntimeError, "cannot start the threads");
+
+	return r;
+}
+
+// Take the writable output *o* of *n* items of *type*, 'd' float64 or 'q'
+// int64. Return 0, or -1 with the Python error set.
+static int outGet(Py_buffer *view, PyObject *o, Py_ssize_t n, char type)
+{
+	if (PyObject_GetBuffer(o, view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | PyBUF_WRITABLE) != 0)
+		return -1;
+
+	if (bufType(view) != type || view->len != n * 8)
+	{
+		PyErr_Format(PyExc_ValueError, "out must be a writable buffer of %zd %s", n, type == 'd' ? "float64" : "int64");
+		PyBuffer_Release(view);
+		return -1;
+	}
+
+	return 0;
+}
+
+PyDoc_STRVAR(times_doc,
+"times(lat, lng, year, month, day, elv=0, tz=0, method=1, asr=1, high_lats=1, model=1)\n"
+"\n"
+"Prayer times of a location-day, a tuple of hours in the order of FIELDS,\n"
+"NAN for none. method, asr, high_lats and model are as of the m, f, h and\n"
+"x options of pt.");
+
+static PyObject *pyTimes(PyObject *self, PyObject *args, PyObject *kw)
+{
+	static char *kwlist[] = {"lat", "lng", "year", "month", "day", "elv", "tz", "method", "asr",
+		"high_lats", "model", 0};
+	struct _ptimes pt;
+	double lat, lng, elv = 0.0, tz = 0.0, asr = ASR_STANDARD;
+	int year, month, day, method = 1, high_lats = HIGHLAT_NIGHT_MIDDLE, model = 1;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kw, "ddiii|ddidii", kwlist, &lat, &lng, &year, &month, &day,
+		&elv, &tz, &method, &asr, &high_lats, &model))
+		return 0;
+
+	if (settings(&pt, method, asr, high_lats, model) != 0)
+		return 0;
+
+	ptSetLocation(&pt, (float)lat, (float)lng, (float)elv, (float)tz);
+	ptSetDate(&pt, (short)year, (short)month, (short)day);
+
+	while (ptCalc(&pt) != 0);
+
+	return Py_BuildValue("(ddddddddd)", pt.imsak, pt.fajr, pt.sunrise, pt.dhuhr, pt.asr,
+		pt.sunset, pt.maghrib, pt.isha, pt.midnight);
+}
+
+PyDoc_STRVAR(batch_doc,
+"batch(lat, lng, elv, tz, days, out, method=1, asr=1, high_lats=1, model=1, threads=1)\n"
+"\n"
+"Prayer times of n location-days into out, n * 9 float64, row i at\n"
+"out[i * 9 : i * 9 + 9]. lat, lng, elv and tz are float64 buffers and days\n"
+"an int32 or int64 buffer of days since 1970-01-01, each of n items or of\n"
+"one for all rows. The GIL is released while calculating.");
+
+static PyObject *pyBatch(PyObject *self, PyObject *args, PyObject *kw)
+{
+	static char *kwlist[] = {"lat", "lng", "elv", "tz", "days", "out", "method", "asr", "high_lats",
+		"model", "threads", 0};
+	static const char *names[5] = {"lat", "lng", "elv", "tz", "days"};
+	struct _pybatch b;
+	PyObject *o[6];
+	Py_buffer out;
+	double asr = ASR_STANDARD;
+	int method = 1, high_lats = HIGHLAT_NIGHT_MIDDLE, model = 1, threads = 1, k, got = 0, r = -1;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kw, "OOOOOO|idiii", kwlist, &o[0], &o[1], &o[2], &o[3],
+		&o[4], &o[5], &method, &asr, &high_lats, &model, &threads))
+		return 0;
+
+	if (settings(&(b.def), method, asr, high_lats, model) != 0)
+		return 0;
+
+	b.n = 1;
+
+	for (got = 0; got < 5; got++)
+	{
+		if (colGet(&(b.col[got]), o[got], got < 4 ? "d" : "iq", names[got]) != 0)
+			goto done;
+
+		if (b.col[got].n > 1 && b.n > 1 && b.col[got].n != b.n)
+		{
+			PyErr_Format(PyExc_ValueError, "%s has %zd items, not %zd", names[got], b.col[got].n, b.n);
+			++got;
+			goto done;
+		}
+
+		if (b.col[got].n > b.n)
+			b.n = b.col[got].n;
+	}
+
+	for (k = 0; k < 5; k++)
+	{
+		if (b.col[k].n == 0)
+			b.n = 0;
+	}
+
+	if (outGet(&out, o[5], b.n * PT_FIELDS, 'd') != 0)
+		goto done;
+
+	b.out = out.buf;
+	r = run((long)((b.n + PY_TASK - 1) / PY_TASK), batchTask, &b, threads);
+	PyBuffer_Release(&out);
+
+done:
+	for (k = 0; k < got; k++)
+		PyBuffer_Release(&(b.col[k].view));
+
+	if (r != 0)
+		return 0;
+
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(utc_doc,
+"utc(times, tz, days, out)\n"
+"\n"
+"Unix times of n rows of times of batch() into out, n * 9 int64 seconds\n"
+"since 1970-01-01 UTC, NO_TIME for none. tz is a float64 buffer and days\n"
+"an int32 or int64 buffer of days since 1970-01-01 of the rows, each of n\n"
+"items or of one for all rows. The GIL is released while converting.");
+
+static PyObject *pyUtc(PyObject *self, PyObject *args, PyObject *kw)
+{
+	static char *kwlist[] = {"times", "tz", "days", "out", 0};
+	static const char *names[3] = {"times", "tz", "days"};
+	const struct _ptkern *k = ptKern();
+	struct _pycol col[3];
+	PyObject *o[4];
+	Py_buffer out;
+	Py_ssize_t n, i, r;
+	double jd[PY_RUN];
+	float tz[PY_RUN];
+	int got, m, e = -1;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kw, "OOOO", kwlist, &o[0], &o[1], &o[2], &o[3]))
+		return 0;
+
+	for (got = 0; got < 3; got++)
+	{
+		if (colGet(&(col[got]), o[got], got < 2 ? "d" : "iq", names[got]) != 0)
+			goto done;
+	}
+
+	if (col[0].n % PT_FIELDS != 0)
+	{
+		PyErr_Format(PyExc_ValueError, "times has %zd items, not rows of %d", col[0].n, PT_FIELDS);
+		goto done;
+	}
+
+	n = col[0].n / PT_FIELDS;
+
+	for (i = 1; i < 3; i++)
+	{
+		if (col[i].n != 1 && col[i].n != n)
+		{
+			PyErr_Format(PyExc_ValueError, "%s has %zd items, not %zd", names[i], col[i].n, n);
+			goto done;
+		}
+	}
+
+	if (outGet(&out, o[3], n * PT_FIELDS, 'q') != 0)
+		goto done;
+
+	Py_BEGIN_ALLOW_THREADS
+
+	for (i = 0; i < n; i += m)
+	{
+		for (m = 0, r = i; r < n && m < PY_RUN; r++, m++)
+		{
+			jd[m] = (double)colLong(&(col[2]), r) + PY_EPOCH;
+			tz[m] = (float)colDouble(&(col[1]), r);
+		}
+
+		k->utc((double *)col[0].view.buf + i * PT_FIELDS, jd, tz, m, (int64_t *)out.buf + i * PT_FIELDS);
+	}
+
+	Py_END_ALLOW_THREADS
+
+	PyBuffer_Release(&out);
+	e = 0;
+
+done:
+	for (i = 0; i < got; i++)
+		PyBuffer_Release(&(col[i].view));
+
+	if (e != 0)
+		return 0;
+
+	Py_RETURN_NONE;
+}
+
+// Compact results of a compact() call, in one arena, see ptres.h.
+typedef struct
+{
+	PyObject_HEAD
+	struct _ptarena arena;
+	struct _ptresset *set;
+} PyResults;
+
+static void resultsFree(PyObject *self)
+{
+	ptArenaFree(&(((PyResults *)self)->arena));
+	PyObject_Del(self);
+}
+
+static int resultsBuffer(PyObject *self, Py_buffer *view, int flags)
+{
+	struct _ptresset *set = ((PyResults *)self)->set;
+
+	return PyBuffer_FillInfo(view, self, set->r, (Py_ssize_t)(sizeof(struct _ptres) * set->nloc * set->ndays), 1, flags);
+}
+
+PyDoc_STRVAR(hours_doc,
+"hours(out)\n"
+"\n"
+"Times of the results in hours of the local time into out, float64 of\n"
+"nloc * ndays * 9 as of grid(), NAN where there is none.");
+
+static PyObject *pyHours(PyObject *self, PyObject *args)
+{
+	struct _ptresset *set = ((PyResults *)self)->set;
+	PyObject *o;
+	Py_buffer out;
+	double *t;
+	long i;
+	short f;
+
+	if (!PyArg_ParseTuple(args, "O", &o))
+		return 0;
+
+	if (outGet(&out, o, (Py_ssize_t)(set->nloc * set->ndays * PT_FIELDS), 'd') != 0)
+		return 0;
+
+	t = out.buf;
+
+	Py_BEGIN_ALLOW_THREADS
+
+	for (i = 0; i < set->nloc * set->ndays; i++)
+	{
+		for (f = 0; f < PT_FIELDS; f++)
+			t[i * PT_FIELDS + f] = ptResTime(&(set->r[i]), f);
+	}
+
+	Py_END_ALLOW_THREADS
+
+	PyBuffer_Release(&out);
+
+	Py_RETURN_NONE;
+}
+
+static PyObject *resultsNloc(PyObject *self, void *closure)
+{
+	return PyLong_FromLong(((PyResults *)self)->set->nloc);
+}
+
+static PyObject *resultsNdays(PyObject *self, void *closure)
+{
+	return PyLong_FromLong(((PyResults *)self)->set->ndays);
+}
+
+static PyMethodDef results_methods[] =
+{
+	{"hours", pyHours, METH_VARARGS, hours_doc},
+	{0, 0, 0, 0}
+};
+
+static PyGetSetDef results_getset[] =
+{
+	{"nloc", resultsNloc, 0, "locations", 0},
+	{"ndays", resultsNdays, 0, "days of every location", 0},
+	{0, 0, 0, 0, 0}
+};
+
+static PyBufferProcs results_buffer = {resultsBuffer, 0};
+
+static PyTypeObject results_type =
+{
+	PyVarObject_HEAD_INIT(0, 0)
+	.tp_name = "prayertimes.Results",
+	.tp_basicsize = sizeof(PyResults),
+	.tp_dealloc = resultsFree,
+	.tp_as_buffer = &results_buffer,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_doc = "Compact results of compact(), a read-only buffer of nloc * ndays\n"
+		"results, location i on day d at i * ndays + d, as of ptres.h.",
+	.tp_methods = results_methods,
+	.tp_getset = results_getset,
+};
+
+// A grid() or compact() call, into the results of one arena for *compact*.
+static PyObject *gridCall(PyObject *args, PyObject *kw, int compact)
+{
+	static char *kwlist[] = {"lat", "lng", "elv", "tz", "year", "month", "day", "ndays", "out",
+		"method", "asr", "high_lats", "model", "threads", 0};
+	static char *kwlist_compact[] = {"lat", "lng", "elv", "tz", "year", "month", "day", "ndays",
+		"method", "asr", "high_lats", "model", "threads", 0};
+	static const char *names[4] = {"lat", "lng", "elv", "tz"};
+	struct _ptimes def, *loc = 0;
+	struct _pycol col[4];
+	struct _ptpool pool;
+	PyResults *res = 0;
+	PyObject *o[5];
+	Py_buffer out;
+	Py_ssize_t n = 1, i, ndays;
+	double asr = ASR_STANDARD;
+	int year, month, day, method = 1, high_lats = HIGHLAT_NIGHT_MIDDLE, model = 1, threads = 1;
+	int k, got = 0, r = -1;
+
+	if (compact ? !PyArg_ParseTupleAndKeywords(args, kw, "OOOOiiin|idiii", kwlist_compact, &o[0], &o[1], &o[2], &o[3],
+		&year, &month, &day, &ndays, &method, &asr, &high_lats, &model, &threads)
+		: !PyArg_ParseTupleAndKeywords(args, kw, "OOOOiiinO|idiii", kwlist, &o[0], &o[1], &o[2], &o[3],
+		&year, &month, &day, &ndays, &o[4], &method, &asr, &high_lats, &model, &threads))
+		return 0;
+
+	if (settings(&def, method, asr, high_lats, model) != 0)
+		return 0;
+
+	if (ndays < 0)
+	{
+		PyErr_SetString(PyExc_ValueError, "ndays must not be negative");
+		return 0;
+	}
+
+	for (got = 0; got < 4; got++)
+	{
+		if (colGet(&(col[got]), o[got], "d", names[got]) != 0)
+			goto done;
+
+		if (col[got].n > 1 && n > 1 && col[got].n != n)
+		{
+			PyErr_Format(PyExc_ValueError, "%s has %zd items, not %zd", names[got], col[got].n, n);
+			++got;
+			goto done;
+		}
+
+		if (col[got].n > n)
+			n = col[got].n;
+	}
+
+	for (k = 0; k < 4; k++)
+	{
+		if (col[k].n == 0)
+			n = 0;
+	}
+
+	if (compact)
+	{
+		res = PyObject_New(PyResults, &results_type);
+
+		if (res == 0)
+			goto done;
+
+		if (ptArenaInit(&(res->arena), sizeof(struct _ptresset) + sizeof(struct _ptres) * n * ndays + PTARENA_ALIGN) != 0)
+		{
+			res->arena.base = 0;
+			Py_DECREF(res);
+			res = 0;
+			PyErr_NoMemory();
+			goto done;
+		}
+
+		res->set = ptResAlloc(&(res->arena), (long)n, (long)ndays, julian((short)year, (short)month, (short)day));
+	}
+	else if (outGet(&out, o[4], n * ndays * PT_FIELDS, 'd') != 0)
+		goto done;
+
+	loc = PyMem_RawMalloc(sizeof(struct _ptimes) * (n > 0 ? n : 1));
+
+	if (loc == 0)
+	{
+		PyErr_NoMemory();
+		goto fail;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		loc[i] = def;
+		ptSetLocation(&(loc[i]), (float)colDouble(&col[0], i), (float)colDouble(&col[1], i),
+			(float)colDouble(&col[2], i), (float)colDouble(&col[3], i));
+	}
+
+	r = 0;
+
+	Py_BEGIN_ALLOW_THREADS
+
+	if (ptPoolInit(&pool, threads > 1 ? threads : 1) == 0)
+	{
+		if (compact)
+			ptGridRunRes(&pool, loc, (long)n, (short)year, (short)month, (short)day, (long)ndays, res->set->r);
+		else
+			ptGridRun(&pool, loc, (long)n, (short)year, (short)month, (short)day, (long)ndays, out.buf);
+
+		ptPoolFree(&pool);
+	}
+	else
+		r = -1;
+
+	Py_END_ALLOW_THREADS
+
+	if (r != 0)
+		PyErr_SetString(PyExc_RuntimeError, "cannot start the threads");
+
+	PyMem_RawFree(loc);
+
+fail:
+	if (!compact)
+		PyBuffer_Release(&out);
+	else if (r != 0)
+	{
+		Py_DECREF(res);
+		res = 0;
+	}
+
+done:
+	for (k = 0; k < got; k++)
+		PyBuffer_Release(&(col[k].view));
+
+	if (r != 0)
+		return 0;
+
+	if (compact)
+		return (PyObject *)res;
+
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(grid_doc,
+"grid(lat, lng, elv, tz, year, month, day, ndays, out, method=1, asr=1, high_lats=1, model=1, threads=1)\n"
+"\n"
+"Prayer times of n locations for ndays days from a date into out,\n"
+"n * ndays * 9 float64, location i on day d at out[(i * ndays + d) * 9].\n"
+"lat, lng, elv and tz are float64 buffers of n items or of one. The GIL\n"
+"is released while calculating.");
+
+static PyObject *pyGrid(PyObject *self, PyObject *args, PyObject *kw)
+{
+	return gridCall(args, kw, 0);
+}
+
+PyDoc_STRVAR(compact_doc,
+"compact(lat, lng, elv, tz, year, month, day, ndays, method=1, asr=1, high_lats=1, model=1, threads=1)\n"
+"\n"
+"Prayer times of grid() as compact results, taken in one allocation:\n"
+"a Results buffer of n * ndays results of RESULT_DTYPE, times in\n"
+"half-minutes from the local midnight plus a day and a flags word, 20\n"
+"bytes against 72 of float64 times, i.e.\n"
+"numpy.frombuffer(r, dtype=numpy.dtype(RESULT_DTYPE)).");
+
+static PyObject *pyCompact(PyObject *self, PyObject *args, PyObject *kw)
+{
+	return gridCall(args, kw, 1);
+}
+
+static PyMethodDef methods[] =
+{
+	{"times", (PyCFunction)(void (*)(void))pyTimes, METH_VARARGS | METH_KEYWORDS, times_doc},
+	{"batch", (PyCFunction)(void (*)(void))pyBatch, METH_VARARGS | METH_KEYWORDS, batch_doc},
+	{"grid", (PyCFunction)(void (*)(void))pyGrid, METH_VARARGS | METH_KEYWORDS, grid_doc},
+	{"compact", (PyCFunction)(void (*)(void))pyCompact, METH_VARARGS | METH_KEYWORDS, compact_doc},
+	{"utc", (PyCFunction)(void (*)(void))pyUtc, METH_VARARGS | METH_KEYWORDS, utc_doc},
+	{0, 0, 0, 0}
+};
+
+static struct PyModuleDef module =
+{
+	PyModuleDef_HEAD_INIT,
+	"prayertimes",
+	"Prayer times calculator, see ptpy.c.",
+	-1,
+	methods
+};
+
+PyMODINIT_FUNC PyInit_prayertimes(void)
+{
+	PyObject *m, *f;
+	const char *env;
+	int i;
+
+	m = PyModule_Create(&module);
+
+	if (m == 0)
+		return 0;
+
+	f = PyTuple_New(PT_FIELDS);
+
+	if (f == 0)
+	{
+		Py_DECREF(m);
+		return 0;
+	}
+
+	for (i = 0; i < PT_FIELDS; i++)
+		PyTuple_SET_ITEM(f, i, PyUnicode_FromString(fields[i]));
+
+	if (PyModule_AddObject(m, "FIELDS", f) != 0)
+	{
+		Py_DECREF(f);
+		Py_DECREF(m);
+		return 0;
+	}
+
+	f = PyLong_FromLongLong(PT_NO_TIME);
+
+	if (f == 0 || PyModule_AddObject(m, "NO_TIME", f) != 0)
+	{
+		Py_XDECREF(f);
+		Py_DECREF(m);
+		return 0;
+	}
+
+	if (PyType_Ready(&results_type) != 0)
+	{
+		Py_DECREF(m);
+		return 0;
+	}
+
+	Py_INCREF(&results_type);
+
+	if (PyModule_AddObject(m, "Results", (PyObject *)&results_type) != 0)
+	{
+		Py_DECREF(&results_type);
+		Py_DECREF(m);
+		return 0;
+	}
+
+#ifdef PT_RES_SECONDS
+	f = Py_BuildValue("[(ssi)(ss)(ss)]", "t", "=i4", PT_FIELDS, "flags", "=u2", "pad", "=u2");
+#else
+	f = Py_BuildValue("[(ssi)(ss)]", "t", "=u2", PT_FIELDS, "flags", "=u2");
+#endif
+
+	if (f == 0 || PyModule_AddObject(m, "RESULT_DTYPE", f) != 0)
+	{
+		Py_XDECREF(f);
+		Py_DECREF(m);
+		return 0;
+	}
+
+	env = getenv("PT_KERN");
+
+	if (env != 0 && ptKernSelect(env) != 0
+		&& PyErr_WarnFormat(PyExc_RuntimeWarning, 1, "PT_KERN: no kernels %s the CPU runs, using %s", env,
+		ptKern()->name) != 0)
+	{
+		Py_DECREF(m);
+		return 0;
+	}
+
+	return m;
+}
@@ -0,0 +1,668 @@
+// ptref.c
+// Prayer times accuracy regression
+// Calculates a fixed corpus of locations, dates and methods with the
+// library as built and with a long double reference, and reports the
+// error of every prayer time field against the speed of the build.
+// Fails when an error is over the budget recorded for the build.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "prayertimes.h"
+#include "ptmethod.h"
+#include "ptkern.h"
+
+// Notes:
+// 1. The reference follows ptCalc() formula by formula in long double
+//     with libm. It is taken twice: with the Sun at the fixed times of day
+//     of ptCalc(), which measures the error of the math alone, and with
+//     the Sun moved to the time found until it no longer moves, which
+//     measures the error against the model itself.
+// 2. The corpus is every 5 degrees of latitude from 65S to 65N at four
+//     longitudes, every 8th day of 2018 plus the solstices and equinoxes,
+//     with all seven methods.
+// 3. A build is a value of PT_TRIG_TIER, followed by -min for the
+//     footprint profile of PT_MINIMAL, see "make pareto". An engine is
+//     a way to call the library: "calc", ptCalc() alone, "sun", with
+//     the positions of the Sun shared by the locations of a date, and
+//     "kern", the vectorized kernels of ptkern.c that ptgrid and the
+//     Python module use, over the locations of a date and method. The
+//     kernels are of full precision whatever the tier.
+// 4. Errors are in seconds. A time that is NAN on one side only counts as
+//     an infinite error.
+// 5. A budget file has a line "<build> <engine> <field> <math max>
+//     <math p99> <model max> <model p99>" of the errors allowed, the
+//     largest and the 99th percentile. The p99 budgets catch a regression
+//     of most of the corpus that the max budgets, set by a few locations
+//     near the polar circles, let through. "w <file>" records the errors
+//     of the build with a margin, keeping the lines of other builds.
+// 6. Settings kept in struct _ptcfg are checked by a round trip: every
+//     case of the corpus, with its adjustments and elevation drawn at
+//     random off the fixed point steps of struct _ptcfg, is calculated as
+//     it is and after ptCfgGet() and ptCfgSet(). "b <file>" fails when a
+//     time moves by more than PTCFG_BOUND seconds, see ptmethod.h.
+//
+
+#define REF_LATS 27       // -65 to 65
+#define REF_LNGS 4
+#define REF_DATES 50
+#define REF_METHODS 7
+#define REF_ITERATIONS 8  // of the refined reference
+#define REF_ENGINES 3
+#define REF_LOCS (REF_LATS * REF_LNGS) // of a date and method
+#define REF_LINE 128
+
+#define REF_STR(x) #x
+#define REF_XSTR(x) REF_STR(x)
+#ifdef PT_MINIMAL
+#define REF_BUILD REF_XSTR(PT_TRIG_TIER) "-min"
+#else
+#define REF_BUILD REF_XSTR(PT_TRIG_TIER)
+#endif
+
+#define PI 3.14159265358979323846264338327950288L
+#define DEG (PI / 180.0L)
+
+static const char *fields[PT_FIELDS] =
+{
+	"imsak", "fajr", "sunrise", "dhuhr", "asr", "sunset", "maghrib", "isha", "midnight"
+};
+
+static const char *engines[REF_ENGINES] = {"calc", "sun", "kern"};
+
+// A location-day of the corpus with its reference times.
+struct _case
+{
+	struct _ptimes pt;
+	long double math[PT_FIELDS];  // Sun at the times of day of ptCalc()
+	long double model[PT_FIELDS]; // Sun at the times found
+};
+
+// Errors of a field, in seconds.
+struct _errors
+{
+	float *math;
+	float *model;
+};
+
+//---------------------- Reference -----------------------
+
+static long double fixl(long double a, long double b)
+{
+	a = fmodl(a, b);
+
+	return a < 0.0L ? a + b : a;
+}
+
+static long double sind(long double d)
+{
+	return sinl(d * DEG);
+}
+
+static long double cosd(long double d)
+{
+	return cosl(d * DEG);
+}
+
+static void sunPositionL(long double jd, long double *decl, long double *eqt)
+{
+	long double D, g, q, L, e, RA;
+
+	D = jd - 2451545.0L;
+	g = fixl(357.529L + 0.98560028L * D, 360.0L);
+	q = fixl(280.459L + 0.98564736L * D, 360.0L);
+	L = fixl(q + 1.915L * sind(g) + 0.020L * sind(2.0L * g), 360.0L);
+	e = 23.439L - 0.00000036L * D;
+	RA = atan2l(cosd(e) * sind(L), cosd(L)) / DEG / 15.0L;
+
+	*decl = asinl(sind(e) * sind(L)) / DEG;
+	*eqt = q / 15.0L - fixl(RA, 24.0L);
+
+	if (*eqt > 23.0L)
+		*eqt -= 24.0L;
+	else if (*eqt < -23.0L)
+		*eqt += 24.0L;
+}
+
+// Time of the Sun at *angle* below the horizon, or of asr for an *angle*
+// of 0 and a *factor*, of noon for neither.
+static long double eventL(long double decl, long double eqt, long double lat, long double angle, long double factor, short dir)
+{
+	long double noon = fixl(12.0L - eqt, 24.0L), t;
+
+	if (angle == 0.0L && factor == 0.0L)
+		return noon;
+
+	if (factor != 0.0L)
+		angle = -atanl(1.0L / (factor + tanl(fabsl(lat - decl) * DEG))) / DEG;
+
+	t = acosl((-sind(angle) - sind(decl) * sind(lat)) / (cosd(decl) * cosd(lat))) / DEG / 15.0L;
+
+	return noon + (dir == DIR_COUNTER_CLOCKWISE ? -t : t);
+}
+
+// Event of *pt* with the Sun at *daytime*, then at the time found when
+// *refine*.
+static long double timeL(struct _ptimes *pt, long double daytime, long double angle, long double factor, short dir, int refine)
+{
+	long double decl, eqt, t, u;
+	int i;
+
+	sunPositionL(pt->jd + daytime, &decl, &eqt);
+	t = eventL(decl, eqt, pt->lat, angle, factor, dir);
+
+	for (i = 0; refine && i < REF_ITERATIONS && t == t; i++)
+	{
+		sunPositionL(pt->jd + (t - pt->lng / 15.0L) / 24.0L, &decl, &eqt);
+		u = eventL(decl, eqt, pt->lat, angle, factor, dir);
+
+		if (fabsl(u - t) < 1e-12L)
+			i = REF_ITERATIONS;
+
+		t = u;
+	}
+
+	return t;
+}
+
+static long double highLatL(struct _ptimes *pt, long double t, long double base, long double angle, long double night, short dir)
+{
+	long double td, p = 0.5L;
+
+	if (pt->high_lats == HIGHLAT_NONE)
+		return t;
+
+	if (pt->high_lats == HIGHLAT_ANGLE_BASED && angle != 0.0L)
+		p = angle / 60.0L;
+
+	if (pt->high_lats == HIGHLAT_ONE_SEVEN)
+		p = 1.0L / 7.0L;
+
+	p *= night;
+	td = dir == DIR_COUNTER_CLOCKWISE ? fixl(base - t, 24.0L) : fixl(t - base, 24.0L);
+
+	if (t != t || td > p)
+		t = base + (dir == DIR_COUNTER_CLOCKWISE ? -p : p);
+
+	return t;
+}
+
+// Reference prayer times of *pt* into *t*, as of ptCalc().
+static void reference(struct _ptimes *pt, int refine, long double *t)
+{
+	long double horz = 0.833L + (pt->elv > 0.0f ? 0.0347L * sqrtl(pt->elv) : 0.0L), night, td;
+	short f;
+
+	t[PT_SUNRISE] = timeL(pt, DAYTIME_SUNRISE, horz, 0.0L, DIR_COUNTER_CLOCKWISE, refine);
+	t[PT_SUNSET] = timeL(pt, DAYTIME_SUNSET, horz, 0.0L, DIR_CLOCKWISE, refine);
+	night = fixl(t[PT_SUNRISE] - t[PT_SUNSET], 24.0L);
+
+	if (pt->fajr_rel_d != 0.0f)
+		t[PT_FAJR] = timeL(pt, DAYTIME_FAJR, pt->fajr_rel_d, 0.0L, DIR_COUNTER_CLOCKWISE, refine);
+	else
+		t[PT_FAJR] = t[PT_SUNRISE] - pt->fajr_rel_m / 60.0L;
+
+	if (pt->imsak_rel_d != 0.0f)
+		t[PT_IMSAK] = timeL(pt, DAYTIME_IMSAK, pt->imsak_rel_d, 0.0L, DIR_COUNTER_CLOCKWISE, refine);
+	else
+		t[PT_IMSAK] = t[PT_FAJR] - pt->imsak_rel_m / 60.0L;
+
+	t[PT_DHUHR] = timeL(pt, DAYTIME_DHUHR, 0.0L, 0.0L, DIR_CLOCKWISE, refine) + pt->dhuhr_rel_m / 60.0L;
+	t[PT_ASR] = timeL(pt, DAYTIME_ASR, 0.0L, pt->asr_factor, DIR_CLOCKWISE, refine) + pt->asr_rel_m / 60.0L;
+
+	if (pt->maghrib_rel_d != 0.0f)
+		t[PT_MAGHRIB] = timeL(pt, DAYTIME_MAGHRIB, pt->maghrib_rel_d, 0.0L, DIR_CLOCKWISE, refine);
+	else
+		t[PT_MAGHRIB] = t[PT_SUNSET] + pt->maghrib_rel_m / 60.0L;
+
+	if (pt->isha_rel_d != 0.0f)
+		t[PT_ISHA] = timeL(pt, DAYTIME_ISHA, pt->isha_rel_d, 0.0L, DIR_CLOCKWISE, refine);
+	else
+		t[PT_ISHA] = t[PT_MAGHRIB] + pt->isha_rel_m / 60.0L;
+
+	t[PT_IMSAK] = highLatL(pt, t[PT_IMSAK], t[PT_SUNRISE], 0.0L, night, DIR_COUNTER_CLOCKWISE);
+	t[PT_FAJR] = highLatL(pt, t[PT_FAJR], t[PT_SUNRISE], pt->fajr_rel_d, night, DIR_COUNTER_CLOCKWISE);
+	t[PT_MAGHRIB] = highLatL(pt, t[PT_MAGHRIB], t[PT_SUNSET], pt->maghrib_rel_d, night, DIR_CLOCKWISE);
+	t[PT_ISHA] = highLatL(pt, t[PT_ISHA], t[PT_SUNSET], pt->isha_rel_d, night, DIR_CLOCKWISE);
+
+	if (pt->midnight_type == MIDNIGHT_JAFARI)
+		t[PT_MIDNIGHT] = t[PT_SUNSET] + fixl(t[PT_FAJR] - t[PT_SUNSET], 24.0L) / 2.0L;
+	else
+		t[PT_MIDNIGHT] = t[PT_SUNSET] + fixl(t[PT_SUNRISE] - t[PT_SUNSET], 24.0L) / 2.0L;
+
+	td = pt->tz - pt->lng / 15.0L;
+
+	for (f = 0; f < PT_FIELDS; f++)
+		t[f] += td;
+}
+
+//---------------------- Suite -----------------------
+
+static uint64_t now(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+// Make the corpus into *c*, date by date. Return its size.
+static long corpus(struct _case *c)
+{
+	static const float lngs[REF_LNGS] = {-122.4f, -0.1f, 39.8f, 151.2f};
+	static const short extra[][2] = {{3, 20}, {6, 21}, {9, 23}, {12, 21}};
+	struct _ptimes pt;
+	long n = 0;
+	double jd0 = julian(2018, 1, 1);
+	short d, i, j, k, y, m, dd;
+
+	ptInit(&pt);
+
+	for (d = 0; d < REF_DATES; d++)
+	{
+		if (d < REF_DATES - 4)
+			gregorian(jd0 + 8.0 * d, &y, &m, &dd);
+		else
+		{
+			y = 2018;
+			m = extra[d - (REF_DATES - 4)][0];
+			dd = extra[d - (REF_DATES - 4)][1];
+		}
+
+		for (i = 0; i < REF_LATS; i++)
+		{
+			for (j = 0; j < REF_LNGS; j++)
+			{
+				for (k = 0; k < REF_METHODS; k++, n++)
+				{
+					c[n].pt = pt;
+					ptSetMethod(&(c[n].pt), k);
+					ptSetLocation(&(c[n].pt), (float)(-65 + 5 * i), lngs[j], 0.0f, (float)(int)(lngs[j] / 15.0f));
+					ptSetDate(&(c[n].pt), y, m, dd);
+					reference(&(c[n].pt), 0, c[n].math);
+					reference(&(c[n].pt), 1, c[n].model);
+				}
+			}
+		}
+	}
+
+	return n;
+}
+
+// Calculate the corpus of *n* cases from *c* with the kernels into *out*,
+// the locations of a date and method together. Corpus() makes the cases
+// of a date in blocks of REF_LOCS locations of every method.
+static void runKern(struct _case *c, long n, double *out)
+{
+	const struct _ptkern *k = ptKern();
+	float lat[REF_LOCS], lng[REF_LOCS], elv[REF_LOCS], tz[REF_LOCS];
+	struct _ptsun sun;
+	long i, j, m;
+
+	for (i = 0; i + REF_LOCS * REF_METHODS <= n; i += REF_LOCS * REF_METHODS)
+	{
+		ptSunInit(&sun, c[i].pt.jd, c[i].pt.sun_model);
+
+		for (m = 0; m < REF_METHODS; m++)
+		{
+			for (j = 0; j < REF_LOCS; j++)
+			{
+				lat[j] = c[i + j * REF_METHODS + m].pt.lat;
+				lng[j] = c[i + j * REF_METHODS + m].pt.lng;
+				elv[j] = c[i + j * REF_METHODS + m].pt.elv;
+				tz[j] = c[i + j * REF_METHODS + m].pt.tz;
+			}
+
+			k->times(&(c[i + m].pt), &sun, lat, lng, elv, tz, REF_LOCS, out + (i + m) * PT_FIELDS,
+				REF_METHODS * PT_FIELDS, 0);
+		}
+	}
+}
+
+// Calculate the corpus with *engine* into *out*. Return ns a location-day.
+static double run(struct _case *c, long n, int engine, double *out)
+{
+	struct _ptsun sun;
+	struct _ptimes pt;
+	uint64_t t = now();
+	long i;
+	short f;
+
+	sun.jd = 0.0;
+
+	if (engine == 2)
+	{
+		runKern(c, n, out);
+		return (double)(now() - t) / (double)n;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		pt = c[i].pt;
+		pt.phase = 0;
+		pt.sun = 0;
+
+		if (engine == 1)
+		{
+			if (sun.jd != pt.jd || sun.model != pt.sun_model)
+				ptSunInit(&sun, pt.jd, pt.sun_model);
+
+			pt.sun = &sun;
+		}
+
+		while (ptCalc(&pt) != 0);
+
+		for (f = 0; f < PT_FIELDS; f++)
+			out[i * PT_FIELDS + f] = ptTime(&pt, f);
+	}
+
+	return (double)(now() - t) / (double)n;
+}
+
+// Error in seconds of *v* against *ref*, around the clock.
+static float error(double v, long double ref)
+{
+	long double e;
+
+	if (v != v || ref != ref)
+		return (v != v) == (ref != ref) ? 0.0f : INFINITY;
+
+	e = fabsl(fixl((long double)v - ref + 12.0L, 24.0L) - 12.0L) * 3600.0L;
+
+	return (float)e;
+}
+
+static int byError(const void *a, const void *b)
+{
+	float x = *(const float *)a, y = *(const float *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+// Largest error allowed for *errors*, with a margin.
+static double margin(double e)
+{
+	return isinf(e) ? e : ceil((e * 1.25 + 0.01) * 100.0) / 100.0;
+}
+
+// Find the budget of *engine* and *field* of this build in *path*, the
+// max and p99 errors of the math into *math* and of the model into
+// *model*. Return 0 when there is none.
+static int budget(const char *path, const char *engine, const char *field, double *math, double *model)
+{
+	char line[REF_LINE], b[32], e[32], f[32];
+	FILE *fp = fopen(path, "r");
+	int found = 0;
+
+	if (fp == 0)
+		return 0;
+
+	while (!found && fgets(line, sizeof(line), fp) != 0)
+	{
+		found = sscanf(line, "%31s %31s %31s %lf %lf %lf %lf", b, e, f, &math[0], &math[1], &model[0], &model[1]) == 7
+			&& strcmp(b, REF_BUILD) == 0 && strcmp(e, engine) == 0 && strcmp(f, field) == 0;
+	}
+
+	fclose(fp);
+
+	return found;
+}
+
+// Rewrite the budget file *path* with *lines* for this build.
+static int record(const char *path, const char *lines)
+{
+	char line[REF_LINE], b[32], *keep = 0, *p;
+	size_t n = 0, len;
+	FILE *fp = fopen(path, "r");
+
+	if (fp != 0)
+	{
+		keep = malloc(1 << 16);
+
+		while (keep != 0 && fgets(line, sizeof(line), fp) != 0)
+		{
+			len = strlen(line);
+
+			if ((sscanf(line, "%31s", b) != 1 || strcmp(b, REF_BUILD) != 0) && n + len < (1 << 16))
+			{
+				memcpy(keep + n, line, len);
+				n += len;
+			}
+		}
+
+		fclose(fp);
+	}
+
+	fp = fopen(path, "w");
+
+	if (fp == 0)
+	{
+		free(keep);
+		return -1;
+	}
+
+	for (p = keep; p != 0 && p < keep + n; p++)
+		fputc(*p, fp);
+
+	fputs(lines, fp);
+	free(keep);
+
+	return fclose(fp);
+}
+
+//---------------------- Round trip -----------------------
+
+static uint64_t rnd(uint64_t *s)
+{
+	*s ^= *s >> 12;
+	*s ^= *s << 25;
+	*s ^= *s >> 27;
+
+	return *s * 2685821657736338717ULL;
+}
+
+// Uniform in [*lo*, *hi*).
+static float uniform(uint64_t *s, float lo, float hi)
+{
+	return lo + (hi - lo) * (float)((double)(rnd(s) >> 11) / 9007199254740992.0);
+}
+
+// Largest move in seconds of every field of the *n* cases of *c* through
+// struct _ptcfg into *move*, see note 6.
+static void roundTrip(struct _case *c, long n, double *move)
+{
+	struct _ptimes a, b;
+	struct _ptcfg cfg;
+	uint64_t s = 88172645463325252ULL;
+	double e;
+	long i;
+	short f;
+
+	for (f = 0; f < PT_FIELDS; f++)
+		move[f] = 0.0;
+
+	for (i = 0; i < n; i++)
+	{
+		a = c[i].pt;
+		ptSetElevation(&a, uniform(&s, 0.0f, 3000.0f));
+		a.imsak_rel_m = uniform(&s, 0.0f, 20.0f);
+		a.dhuhr_rel_m = uniform(&s, -5.0f, 5.0f);
+		a.asr_rel_m = uniform(&s, -5.0f, 5.0f);
+
+		if (a.fajr_rel_d != 0.0f)
+			a.fajr_rel_d = uniform(&s, 12.0f, 20.0f);
+
+		if (a.maghrib_rel_d != 0.0f)
+			a.maghrib_rel_d = uniform(&s, 3.0f, 6.0f);
+		else
+			a.maghrib_rel_m = uniform(&s, 0.0f, 5.0f);
+
+		if (a.isha_rel_d != 0.0f)
+			a.isha_rel_d = uniform(&s, 12.0f, 20.0f);
+		else
+			a.isha_rel_m = uniform(&s, 60.0f, 120.0f);
+
+		ptCfgGet(&a, &cfg);
+		b = a;
+		ptCfgSet(&b, &cfg);
+
+		while (ptCalc(&a) != 0);
+		while (ptCalc(&b) != 0);
+
+		for (f = 0; f < PT_FIELDS; f++)
+		{
+			e = error(ptTime(&b, f), ptTime(&a, f));
+			move[f] = e > move[f] ? e : move[f];
+		}
+	}
+}
+
+static void help(void)
+{
+	printf("PRAYER TIMES ACCURACY REGRESSION\n\n");
+	printf("USAGE:\n");
+	printf("\tptref <options>\n\n");
+	printf("\toptions:\n");
+	printf("\tb <file>         fail when an error is over its budget, or a time of\n");
+	printf("\t                 the struct _ptcfg round trip over PTCFG_BOUND\n");
+	printf("\tw <file>         record the errors of this build as budgets\n");
+	printf("\tr <repeats>      timed runs, the best kept, 3 by default\n");
+	printf("\n");
+	printf("\tBuilt for every PT_TRIG_TIER and PT_MINIMAL and checked by\n");
+	printf("\tmake pareto.\n\n");
+}
+
+int main(int argc, char *argv[])
+{
+	static char lines[REF_ENGINES * PT_FIELDS * REF_LINE];
+	struct _errors err[PT_FIELDS];
+	struct _case *c;
+	double *out, ns, best, bm[2], bt[2], max[2], p99[2], move[PT_FIELDS];
+	char *check = 0, *write = 0;
+	size_t len = 0;
+	long n, i;
+	int repeats = 3, engine, k, over = 0;
+	short f;
+
+	for (k = 1; k + 1 < argc; k += 2)
+	{
+		switch (argv[k][0] != '\0' && argv[k][1] == '\0' ? argv[k][0] : 0)
+		{
+			case 'b': check = argv[k + 1]; break;
+			case 'w': write = argv[k + 1]; break;
+			case 'r': repeats = atoi(argv[k + 1]); break;
+			default: help(); return 1;
+		}
+	}
+
+	if (k < argc || repeats < 1)
+	{
+		help();
+		return 1;
+	}
+
+	n = (long)REF_DATES * REF_LATS * REF_LNGS * REF_METHODS;
+	c = malloc(sizeof(struct _case) * n);
+	out = malloc(sizeof(double) * PT_FIELDS * n);
+
+	for (f = 0; f < PT_FIELDS; f++)
+	{
+		err[f].math = malloc(sizeof(float) * n);
+		err[f].model = malloc(sizeof(float) * n);
+
+		if (err[f].math == 0 || err[f].model == 0)
+			c = 0;
+	}
+
+	if (c == 0 || out == 0)
+	{
+		fprintf(stderr, "ptref: out of memory\n");
+		return 1;
+	}
+
+	n = corpus(c);
+
+	for (engine = 0; engine < REF_ENGINES; engine++)
+	{
+		for (k = 0, best = INFINITY; k < repeats; k++)
+		{
+			ns = run(c, n, engine, out);
+
+			if (ns < best)
+				best = ns;
+		}
+
+		printf("build %-5s engine %-5s %ld location-days %10.1f ns/location-day\n", REF_BUILD, engines[engine], n, best);
+		printf("%-9s %10s %10s %10s %10s  (seconds)\n", "field", "math max", "math p99", "model max", "model p99");
+
+		for (f = 0; f < PT_FIELDS; f++)
+		{
+			for (i = 0; i < n; i++)
+			{
+				err[f].math[i] = error(out[i * PT_FIELDS + f], c[i].math[f]);
+				err[f].model[i] = error(out[i * PT_FIELDS + f], c[i].model[f]);
+			}
+
+			qsort(err[f].math, n, sizeof(float), byError);
+			qsort(err[f].model, n, sizeof(float), byError);
+			max[0] = err[f].math[n - 1];
+			max[1] = err[f].model[n - 1];
+			p99[0] = err[f].math[(n * 99) / 100];
+			p99[1] = err[f].model[(n * 99) / 100];
+
+			printf("%-9s %10.3f %10.3f %10.3f %10.3f", fields[f], max[0], p99[0], max[1], p99[1]);
+
+			if (check != 0 && budget(check, engines[engine], fields[f], bm, bt))
+			{
+				if (max[0] > bm[0] || p99[0] > bm[1] || max[1] > bt[0] || p99[1] > bt[1])
+				{
+					printf("  over budget %.2f %.2f %.2f %.2f", bm[0], bm[1], bt[0], bt[1]);
+					++over;
+				}
+			}
+			else if (check != 0)
+			{
+				printf("  no budget");
+				++over;
+			}
+
+			printf("\n");
+
+			len += (size_t)snprintf(lines + len, sizeof(lines) - len, "%s %s %s %.2f %.2f %.2f %.2f\n",
+				REF_BUILD, engines[engine], fields[f], margin(max[0]), margin(p99[0]), margin(max[1]), margin(p99[1]));
+		}
+	}
+
+	roundTrip(c, n, move);
+	printf("build %-5s round trip through struct _ptcfg, bound %.1f seconds\n", REF_BUILD, PTCFG_BOUND);
+
+	for (f = 0; f < PT_FIELDS; f++)
+	{
+		printf("%-9s %10.3f", fields[f], move[f]);
+
+		if (check != 0 && !(move[f] <= PTCFG_BOUND))
+		{
+			printf("  over bound");
+			++over;
+		}
+
+		printf("\n");
+	}
+
+	if (write != 0 && record(write, lines) != 0)
+	{
+		fprintf(stderr, "ptref: cannot write %s\n", write);
+		return 1;
+	}
+
+	if (over > 0)
+		printf("%d errors over budget\n", over);
+
+	return over > 0;
+}
@@ -0,0 +1,90 @@
+// ptres.c
+// Compact results
+// Keeps the prayer times of a location-day as small integers from the
+// local midnight of the date, with a flag for every time that is none and
+// for every time moved by the high latitude adjustment.
+
+#include <stddef.h>
+#include "ptres.h"
+
+// Notes:
+// 1. A time is rounded to the nearest unit, half a minute by default. A
+//     time too early or too late for the type, i.e. of a time zone far off
+//     the longitude, is kept as none, as a NAN is.
+// 2. The times of none are kept as 0 with their flag set, so the results
+//     compress well and compare equal.
+// 3. A result set and its results are one block of an arena, so a bulk
+//     run takes them all with one allocation and gives them back at once.
+//
+
+// Compact result *r* of times *t* of PT_FIELDS hours and the high_lat_adj
+// bits *adj*.
+void ptResPack(struct _ptres *r, const double *t, short adj)
+{
+	double v;
+	short f;
+
+	r->flags = (uint16_t)PT_RES_HL(adj);
+
+	for (f = 0; f < PT_FIELDS; f++)
+	{
+		v = t[f] * PT_RES_UNIT + PT_RES_BIAS;
+
+		if (v > PT_RES_MIN - 0.5 && v < PT_RES_MAX + 0.5) // false for NAN
+			r->t[f] = (pt_rtime)(v < 0.0 ? v - 0.5 : v + 0.5);
+		else
+		{
+			r->t[f] = 0;
+			r->flags |= PT_RES_NAN(f);
+		}
+	}
+}
+
+// Compact result *r* of the times ptCalc() gave *pt*.
+void ptResSet(struct _ptres *r, const struct _ptimes *pt)
+{
+	double t[PT_FIELDS];
+
+	t[PT_IMSAK] = pt->imsak;
+	t[PT_FAJR] = pt->fajr;
+	t[PT_SUNRISE] = pt->sunrise;
+	t[PT_DHUHR] = pt->dhuhr;
+	t[PT_ASR] = pt->asr;
+	t[PT_SUNSET] = pt->sunset;
+	t[PT_MAGHRIB] = pt->maghrib;
+	t[PT_ISHA] = pt->isha;
+	t[PT_MIDNIGHT] = pt->midnight;
+
+	ptResPack(r, t, pt->high_lat_adj);
+}
+
+// Time *field* of *r* in hours from the local midnight, NAN for none.
+double ptResTime(const struct _ptres *r, short field)
+{
+	if (r->flags & PT_RES_NAN(field))
+		return p_nan();
+
+	return ((double)r->t[field] - PT_RES_BIAS) / PT_RES_UNIT;
+}
+
+// A result set of *nloc* locations for *ndays* days from Julian date *jd*,
+// taken from arena *a*. Return 0 when the arena is full.
+struct _ptresset *ptResAlloc(struct _ptarena *a, long nloc, long ndays, double jd)
+{
+	struct _ptresset *s;
+
+	if (nloc < 0 || ndays < 0)
+		return 0;
+
+	s = ptArenaAlloc(a, sizeof(struct _ptresset) + sizeof(struct _ptres) * (size_t)nloc * (size_t)ndays);
+
+	if (s == 0)
+		return 0;
+
+	s->nloc = nloc;
+	s->ndays = ndays;
+	s->jd = jd;
+	s->r = (struct _ptres *)(s + 1);
+
+	return s;
+}
@@ -0,0 +1,54 @@
+// ptres.h
+
+#ifndef __PTRES_H__
+#define __PTRES_H__
+
+#include <stdint.h>
+#include "prayertimes.h"
+#include "ptarena.h"
+
+// Times of a compact result, from the local midnight of its date. By
+// default in half-minutes plus a day, as uint16, so that the times of the
+// day before fit. Define PT_RES_SECONDS for seconds as int32.
+#ifdef PT_RES_SECONDS
+typedef int32_t pt_rtime;
+#define PT_RES_UNIT 3600.0 // per hour
+#define PT_RES_BIAS 0.0
+#define PT_RES_MIN -2147483647.0
+#define PT_RES_MAX 2147483647.0
+#else
+typedef uint16_t pt_rtime;
+#define PT_RES_UNIT 120.0
+#define PT_RES_BIAS 2880.0 // a day
+#define PT_RES_MIN 0.0
+#define PT_RES_MAX 65535.0
+#endif
+
+// Flags of a compact result
+#define PT_RES_NAN(f) (1 << (f))       // no time of field f, or out of range
+#define PT_RES_HL(b) ((b) << PT_FIELDS) // PT_HL_x bits of high_lat_adj
+
+// Prayer times of a location-day in 20 bytes, or 40 with PT_RES_SECONDS,
+// against 72 of its times as doubles and 208 of a struct _ptimes.
+struct _ptres
+{
+	pt_rtime t[PT_FIELDS];
+	uint16_t flags;
+};
+
+// Compact results of *nloc* locations for *ndays* days from Julian date
+// *jd*. Location i on day d is at r[i * ndays + d].
+struct _ptresset
+{
+	long nloc;
+	long ndays;
+	double jd;
+	struct _ptres *r;
+};
+
+void ptResPack(struct _ptres *r, const double *t, short adj);
+void ptResSet(struct _ptres *r, const struct _ptimes *pt);
+double ptResTime(const struct _ptres *r, short field);
+struct _ptresset *ptResAlloc(struct _ptarena *a, long nloc, long ndays, double jd);
+
+#endif
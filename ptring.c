@@ -0,0 +1,52 @@
+// ptring.c
+// Single-producer single-consumer ring
+
+#include "ptring.h"
+
+// Notes:
+// 1. *head* and *tail* count every pop and push and are never wrapped, so
+//     the ring is empty when they are equal and full when they are
+//     PTRING_SIZE apart. A release store of the own counter after the slot
+//     is written or read, with an acquire load of the other one, is all
+//     the ordering needed.
+//
+
+void ptRingInit(struct _ptring *r)
+{
+	short i;
+
+	r->head = 0;
+	r->tail = 0;
+
+	for (i = 0; i < PTRING_SIZE; i++)
+		r->slot[i] = 0;
+}
+
+// Push *p*. Return 0 when the ring is full.
+int ptRingPush(struct _ptring *r, void *p)
+{
+	uint64_t t = r->tail;
+
+	if (t - __atomic_load_n(&(r->head), __ATOMIC_ACQUIRE) >= PTRING_SIZE)
+		return 0;
+
+	r->slot[t & (PTRING_SIZE - 1)] = p;
+	__atomic_store_n(&(r->tail), t + 1, __ATOMIC_RELEASE);
+
+	return 1;
+}
+
+// Pop the oldest pointer. Return 0 when the ring is empty.
+void *ptRingPop(struct _ptring *r)
+{
+	uint64_t h = r->head;
+	void *p;
+
+	if (h == __atomic_load_n(&(r->tail), __ATOMIC_ACQUIRE))
+		return 0;
+
+	p = r->slot[h & (PTRING_SIZE - 1)];
+	__atomic_store_n(&(r->head), h + 1, __ATOMIC_RELEASE);
+
+	return p;
+}
@@ -0,0 +1,26 @@
+// ptring.h
+
+#ifndef __PTRING_H__
+#define __PTRING_H__
+
+#include <stdint.h>
+
+#define PTRING_SIZE 16 // slots, a power of two
+
+// Bounded lock-free ring of pointers between one producer thread and one
+// consumer thread. The producer only writes *tail* and the consumer only
+// writes *head*, each in a cache line of its own.
+struct _ptring
+{
+	uint64_t head;
+	char pad0[64 - sizeof(uint64_t)];
+	uint64_t tail;
+	char pad1[64 - sizeof(uint64_t)];
+	void *slot[PTRING_SIZE];
+};
+
+void ptRingInit(struct _ptring *r);
+int ptRingPush(struct _ptring *r, void *p);
+void *ptRingPop(struct _ptring *r);
+
+#endif
@@ -0,0 +1,675 @@
+// ptroute.c
+// Request router of sharded servers
+// Sends every request line of a client to the shard server that owns the
+// location of the request, and merges the replies of the shards back in
+// the order of the requests.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include "ptparse.h"
+#include "ptroute.h"
+
+// Notes:
+// 1. Locations are put in cells of 1/PTROUTE_CELLS degree, and a cell
+//     belongs to the shard of the first point after its hash on a ring of
+//     PTROUTE_VNODES points a shard. Nearby requests meet in the cache of
+//     one shard, and a shard added or taken away moves only about 1/n of
+//     the cells.
+// 2. A client has a connection of its own to every shard it uses, so the
+//     replies of a shard come back in the order of its requests. The
+//     shards of the requests in flight are kept in order, and a reply is
+//     passed on only when it is the oldest one, whole.
+// 3. Everything runs on a single thread with epoll. The work of a request
+//     is a parse for its location and two copies.
+// 4. A request line longer than PTROUTE_IN is answered as empty by the
+//     router itself, as a server would. A last line with no newline before
+//     the client shuts down is passed on with one.
+//
+
+#define EVENTS 64
+#define EMPTY -1 // pending reply of a line too long
+
+struct _point
+{
+	uint64_t p;
+	short s;
+};
+
+static uint64_t mix(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xBF58476D1CE4E5B9ULL;
+	x ^= x >> 27;
+	x *= 0x94D049BB133111EBULL;
+	x ^= x >> 31;
+
+	return x;
+}
+
+static int byPoint(const void *a, const void *b)
+{
+	const struct _point *x = a, *y = b;
+
+	return x->p < y->p ? -1 : x->p > y->p;
+}
+
+static int64_t cell(double v)
+{
+	int64_t q = (int64_t)(v * PTROUTE_CELLS);
+
+	return (double)q > v * PTROUTE_CELLS ? q - 1 : q;
+}
+
+static int nonblock(int fd)
+{
+	int fl = fcntl(fd, F_GETFL);
+
+	return fl < 0 ? -1 : fcntl(fd, F_SETFL, fl | O_NONBLOCK);
+}
+
+// Send what is pending in [*at, len) of *buf*, resetting both when done.
+// Return -1 when the connection is lost.
+static int sendSome(int fd, char *buf, size_t *at, size_t *len)
+{
+	ssize_t n;
+
+	while (*at < *len)
+	{
+		n = send(fd, buf + *at, *len - *at, MSG_NOSIGNAL);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return 0;
+
+		if (n <= 0)
+			return -1;
+
+		*at += (size_t)n;
+	}
+
+	*at = 0;
+	*len = 0;
+
+	return 0;
+}
+
+static void watch(struct _ptroute *r, struct _ptroute_end *end, short events)
+{
+	struct epoll_event ev;
+
+	if (end->events == events)
+		return;
+
+	end->events = events;
+	ev.events = (unsigned int)events;
+	ev.data.ptr = end;
+	epoll_ctl(r->ep, EPOLL_CTL_MOD, end->fd, &ev);
+}
+
+// Close client *c* and its shard connections. It is freed after the
+// events at hand, which may still refer to it.
+static void drop(struct _ptroute *r, struct _ptroute_conn *c, struct _ptroute_conn **dead)
+{
+	short k;
+
+	for (k = 0; k < r->shards; k++)
+	{
+		if (c->up[k] != 0 && c->up[k]->end.fd >= 0)
+		{
+			epoll_ctl(r->ep, EPOLL_CTL_DEL, c->up[k]->end.fd, 0);
+			close(c->up[k]->end.fd);
+			c->up[k]->end.fd = -1;
+		}
+	}
+
+	epoll_ctl(r->ep, EPOLL_CTL_DEL, c->end.fd, 0);
+	close(c->end.fd);
+	c->end.fd = -1;
+
+	*(c->pprev) = c->next;
+
+	if (c->next != 0)
+		c->next->pprev = c->pprev;
+
+	c->next = *dead;
+	*dead = c;
+}
+
+static void release(struct _ptroute *r, struct _ptroute_conn *c)
+{
+	short k;
+
+	for (k = 0; k < r->shards; k++)
+		free(c->up[k]);
+
+	free(c);
+}
+
+// Connect client *c* to shard *k*. Return 0 on failure.
+static struct _ptroute_up *upOpen(struct _ptroute *r, struct _ptroute_conn *c, short k)
+{
+	struct _ptroute_up *up = malloc(sizeof(struct _ptroute_up));
+	struct epoll_event ev;
+
+	if (up == 0)
+		return 0;
+
+	up->end.up = 1;
+	up->end.events = EPOLLIN;
+	up->end.fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	up->c = c;
+	up->out_len = 0;
+	up->out_at = 0;
+	up->in_at = 0;
+	up->in_len = 0;
+
+	ev.events = EPOLLIN;
+	ev.data.ptr = &(up->end);
+
+	if (up->end.fd < 0 || connect(up->end.fd, (struct sockaddr *)&(r->shard[k]), sizeof(r->shard[k])) != 0
+		|| nonblock(up->end.fd) != 0 || epoll_ctl(r->ep, EPOLL_CTL_ADD, up->end.fd, &ev) != 0)
+	{
+		if (up->end.fd >= 0)
+			close(up->end.fd);
+
+		free(up);
+		return 0;
+	}
+
+	c->up[k] = up;
+
+	return up;
+}
+
+// Shard of the location of request line [s, e).
+static short lineShard(struct _ptroute *r, const char *s, const char *e)
+{
+	struct _ptrec rec;
+
+	if (ptParseRecord(s, e, &rec) != 1)
+		return 0;
+
+	return ptRouteShard(r, rec.has & PTREC_LAT ? rec.lat : r->lat, rec.has & PTREC_LNG ? rec.lng : r->lng);
+}
+
+// End of the oldest whole reply of shard connection *up*, 0 if none yet.
+// A reply ends with an empty line.
+static size_t replyEnd(struct _ptroute_up *up)
+{
+	const char *b = up->in, *p = b + up->in_at, *e = b + up->in_len;
+
+	if (p < e && *p == '\n')
+		return up->in_at + 1;
+
+	while (p < e && (p = memchr(p, '\n', e - p)) != 0)
+	{
+		if (p + 1 >= e)
+			break;
+
+		if (p[1] == '\n')
+			return (size_t)(p + 2 - b);
+
+		++p;
+	}
+
+	return 0;
+}
+
+// Queue the request lines of *c* to their shards. Return 1 when any was
+// queued, -1 when a shard cannot be reached.
+static int route(struct _ptroute *r, struct _ptroute_conn *c)
+{
+	struct _ptroute_up *up;
+	char *p = c->in, *e = c->in + c->in_len, *eol, *q;
+	size_t n;
+	short k;
+	int done = 0;
+
+	while (p < e && c->tail - c->head < PTROUTE_PENDING)
+	{
+		eol = memchr(p, '\n', e - p);
+
+		if (eol == 0 && !c->eof)
+		{
+			if (p > c->in || c->in_len < PTROUTE_IN)
+				break;
+
+			// too long, answered as empty here, the rest of it is dropped
+			// as the next line would be too long as well
+			c->pending[c->tail++ % PTROUTE_PENDING] = EMPTY;
+			p = e;
+			done = 1;
+			break;
+		}
+
+		q = eol != 0 ? eol : e; // the last line may have no newline
+		k = lineShard(r, p, q);
+		up = c->up[k] != 0 ? c->up[k] : upOpen(r, c, k);
+
+		if (up == 0)
+			return -1;
+
+		n = (size_t)(q - p) + 1;
+
+		if (up->out_at > 0 && PTROUTE_SEND - up->out_len < n)
+		{
+			memmove(up->out, up->out + up->out_at, up->out_len - up->out_at);
+			up->out_len -= up->out_at;
+			up->out_at = 0;
+		}
+
+		if (PTROUTE_SEND - up->out_len < n)
+			break; // the shard is behind
+
+		memcpy(up->out + up->out_len, p, n - 1);
+		up->out[up->out_len + n - 1] = '\n';
+		up->out_len += n;
+		c->pending[c->tail++ % PTROUTE_PENDING] = k;
+		p = q + (eol != 0);
+		done = 1;
+	}
+
+	c->in_len = (size_t)(e - p);
+	memmove(c->in, p, c->in_len);
+
+	return done;
+}
+
+// Pass the replies of *c* in order while they are whole and fit.
+static int merge(struct _ptroute_conn *c)
+{
+	struct _ptroute_up *up;
+	size_t end, n;
+	short k;
+	int done = 0;
+
+	if (c->out_at > 0)
+	{
+		memmove(c->out, c->out + c->out_at, c->out_len - c->out_at);
+		c->out_len -= c->out_at;
+		c->out_at = 0;
+	}
+
+	while (c->head < c->tail)
+	{
+		k = c->pending[c->head % PTROUTE_PENDING];
+
+		if (k == EMPTY)
+		{
+			if (c->out_len == PTSERVE_OUT)
+				break;
+
+			c->out[c->out_len++] = '\n';
+		}
+		else
+		{
+			up = c->up[k];
+			end = replyEnd(up);
+			n = end - up->in_at;
+
+			if (end == 0 || PTSERVE_OUT - c->out_len < n)
+				break;
+
+			memcpy(c->out + c->out_len, up->in + up->in_at, n);
+			c->out_len += n;
+			up->in_at = end;
+
+			if (up->in_at == up->in_len)
+			{
+				up->in_at = 0;
+				up->in_len = 0;
+			}
+		}
+
+		c->head++;
+		done = 1;
+	}
+
+	return done;
+}
+
+// Move the requests and replies of client *c* as far as they go.
+static void pump(struct _ptroute *r, struct _ptroute_conn *c, struct _ptroute_conn **dead)
+{
+	struct _ptroute_up *up;
+	short k, events;
+	int moved;
+
+	do
+	{
+		moved = route(r, c);
+
+		if (moved < 0)
+		{
+			drop(r, c, dead);
+			return;
+		}
+
+		for (k = 0; k < r->shards; k++)
+		{
+			up = c->up[k];
+
+			if (up != 0 && sendSome(up->end.fd, up->out, &(up->out_at), &(up->out_len)) < 0)
+			{
+				drop(r, c, dead);
+				return;
+			}
+		}
+
+		moved |= merge(c);
+
+		if (sendSome(c->end.fd, c->out, &(c->out_at), &(c->out_len)) < 0)
+		{
+			drop(r, c, dead);
+			return;
+		}
+	}
+	while (moved);
+
+	if (c->eof && c->head == c->tail && c->out_len == 0)
+	{
+		drop(r, c, dead);
+		return;
+	}
+
+	events = (!c->eof && c->in_len < PTROUTE_IN ? EPOLLIN : 0) | (c->out_len > 0 ? EPOLLOUT : 0);
+	watch(r, &(c->end), events);
+
+	for (k = 0; k < r->shards; k++)
+	{
+		up = c->up[k];
+
+		if (up == 0)
+			continue;
+
+		if (up->in_at > 0 && up->in_len == PTSERVE_OUT)
+		{
+			memmove(up->in, up->in + up->in_at, up->in_len - up->in_at);
+			up->in_len -= up->in_at;
+			up->in_at = 0;
+		}
+
+		events = (up->in_len < PTSERVE_OUT ? EPOLLIN : 0) | (up->out_len > 0 ? EPOLLOUT : 0);
+		watch(r, &(up->end), events);
+	}
+}
+
+// Read from the end *fd* into [*len*, size) of *buf*.
+// Return 0 when it has nothing more now, -1 at its end or on error.
+static int readSome(int fd, char *buf, size_t *len, size_t size)
+{
+	ssize_t n;
+
+	while (*len < size)
+	{
+		n = read(fd, buf + *len, size - *len);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return 0;
+
+		if (n <= 0)
+			return -1;
+
+		*len += (size_t)n;
+	}
+
+	return 0;
+}
+
+static void welcome(struct _ptroute *r)
+{
+	struct _ptroute_conn *c;
+	struct epoll_event ev;
+	short k;
+	int fd;
+
+	while ((fd = accept(r->fd, 0, 0)) >= 0)
+	{
+		c = malloc(sizeof(struct _ptroute_conn));
+
+		if (c == 0 || nonblock(fd) != 0)
+		{
+			free(c);
+			close(fd);
+			continue;
+		}
+
+		c->end.up = 0;
+		c->end.fd = fd;
+		c->end.events = EPOLLIN;
+		c->eof = 0;
+		c->in_len = 0;
+		c->out_len = 0;
+		c->out_at = 0;
+		c->head = 0;
+		c->tail = 0;
+
+		for (k = 0; k < PTROUTE_MAX_SHARDS; k++)
+			c->up[k] = 0;
+
+		ev.events = EPOLLIN;
+		ev.data.ptr = &(c->end);
+
+		if (epoll_ctl(r->ep, EPOLL_CTL_ADD, fd, &ev) != 0)
+		{
+			free(c);
+			close(fd);
+			continue;
+		}
+
+		c->next = r->head;
+		c->pprev = &(r->head);
+
+		if (r->head != 0)
+			r->head->pprev = &(c->next);
+
+		r->head = c;
+	}
+}
+
+// Shard of location *lat*, *lng*.
+short ptRouteShard(struct _ptroute *r, double lat, double lng)
+{
+	uint64_t key = mix(((uint64_t)(uint32_t)cell(lat) << 32) | (uint64_t)(uint32_t)cell(lng));
+	long lo = 0, hi = (long)r->shards * PTROUTE_VNODES, m;
+
+	while (lo < hi)
+	{
+		m = (lo + hi) / 2;
+
+		if (r->point[m] < key)
+			lo = m + 1;
+		else
+			hi = m;
+	}
+
+	return r->owner[lo < (long)r->shards * PTROUTE_VNODES ? lo : 0];
+}
+
+// Listen on Unix domain socket *path* to route requests to the *n* shard
+// servers listening on *shards*, waiting for them to be up. Requests with
+// no location are taken to be at *lat*, *lng*.
+// Return 0 on success, -1 on failure.
+int ptRouteInit(struct _ptroute *r, const char *path, const char **shards, short n, float lat, float lng)
+{
+	struct _point pt[PTROUTE_MAX_SHARDS * PTROUTE_VNODES];
+	struct sockaddr_un a;
+	struct epoll_event ev;
+	struct timespec w = {0, 20000000};
+	short k, v, i;
+	int fd;
+
+	if (n < 1 || n > PTROUTE_MAX_SHARDS || strlen(path) >= sizeof(a.sun_path))
+		return -1;
+
+	for (k = 0; k < n; k++)
+	{
+		if (strlen(shards[k]) >= sizeof(a.sun_path))
+			return -1;
+
+		memset(&(r->shard[k]), 0, sizeof(r->shard[k]));
+		r->shard[k].sun_family = AF_UNIX;
+		strcpy(r->shard[k].sun_path, shards[k]);
+
+		for (v = 0; v < PTROUTE_VNODES; v++)
+		{
+			pt[k * PTROUTE_VNODES + v].p = mix(((uint64_t)(k + 1) << 32) | (uint64_t)v);
+			pt[k * PTROUTE_VNODES + v].s = k;
+		}
+
+		// wait for the shard to listen
+		for (i = 0; i < 250; i++)
+		{
+			fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+			if (fd >= 0 && connect(fd, (struct sockaddr *)&(r->shard[k]), sizeof(r->shard[k])) == 0)
+			{
+				close(fd);
+				break;
+			}
+
+			if (fd >= 0)
+				close(fd);
+
+			nanosleep(&w, 0);
+		}
+
+		if (i == 250)
+			return -1;
+	}
+
+	qsort(pt, (size_t)n * PTROUTE_VNODES, sizeof(struct _point), byPoint);
+
+	for (i = 0; i < n * PTROUTE_VNODES; i++)
+	{
+		r->point[i] = pt[i].p;
+		r->owner[i] = pt[i].s;
+	}
+
+	memset(&a, 0, sizeof(a));
+	a.sun_family = AF_UNIX;
+	strcpy(a.sun_path, path);
+	unlink(path);
+
+	r->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (r->fd < 0)
+		return -1;
+
+	r->ep = epoll_create1(0);
+	ev.events = EPOLLIN;
+	ev.data.ptr = 0; // the listening socket
+
+	if (r->ep < 0 || bind(r->fd, (struct sockaddr *)&a, sizeof(a)) != 0 || listen(r->fd, 1024) != 0
+		|| nonblock(r->fd) != 0 || epoll_ctl(r->ep, EPOLL_CTL_ADD, r->fd, &ev) != 0)
+	{
+		if (r->ep >= 0)
+			close(r->ep);
+
+		close(r->fd);
+		return -1;
+	}
+
+	r->path = path;
+	r->shards = n;
+	r->lat = lat;
+	r->lng = lng;
+	r->head = 0;
+	r->quit = 0;
+
+	return 0;
+}
+
+// Route until ptRouteStop(), then close every connection and remove the
+// socket.
+void ptRouteRun(struct _ptroute *r)
+{
+	struct epoll_event ev[EVENTS];
+	struct _ptroute_conn *c, *dead;
+	struct _ptroute_end *end;
+	struct _ptroute_up *up;
+	int i, n;
+
+	while (!__atomic_load_n(&(r->quit), __ATOMIC_ACQUIRE))
+	{
+		n = epoll_wait(r->ep, ev, EVENTS, 200);
+		dead = 0;
+
+		for (i = 0; i < n; i++)
+		{
+			end = ev[i].data.ptr;
+
+			if (end == 0)
+			{
+				welcome(r);
+				continue;
+			}
+
+			if (end->fd < 0) // dropped by an earlier event
+				continue;
+
+			if (end->up)
+			{
+				up = (struct _ptroute_up *)end;
+				c = up->c;
+
+				if ((ev[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+					&& up->in_len < PTSERVE_OUT && readSome(end->fd, up->in, &(up->in_len), PTSERVE_OUT) < 0)
+				{
+					drop(r, c, &dead); // the shard is gone
+					continue;
+				}
+			}
+			else
+			{
+				c = (struct _ptroute_conn *)end;
+
+				if ((ev[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !c->eof
+					&& readSome(end->fd, c->in, &(c->in_len), PTROUTE_IN) < 0)
+					c->eof = 1;
+			}
+
+			pump(r, c, &dead);
+		}
+
+		while ((c = dead) != 0)
+		{
+			dead = c->next;
+			release(r, c);
+		}
+	}
+
+	dead = 0;
+
+	while (r->head != 0)
+		drop(r, r->head, &dead);
+
+	while ((c = dead) != 0)
+	{
+		dead = c->next;
+		release(r, c);
+	}
+
+	close(r->ep);
+	close(r->fd);
+	unlink(r->path);
+}
+
+// Stop the router. Safe to call from a signal handler.
+void ptRouteStop(struct _ptroute *r)
+{
+	__atomic_store_n(&(r->quit), 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,81 @@
+// ptroute.h
+
+#ifndef __PTROUTE_H__
+#define __PTROUTE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/un.h>
+#include "ptserve.h"
+
+#define PTROUTE_MAX_SHARDS 64
+#define PTROUTE_VNODES 64       // points of a shard on the hash ring
+#define PTROUTE_CELLS 10.0      // cells a degree of latitude or longitude
+#define PTROUTE_IN (16 << 10)   // request buffer of a client
+#define PTROUTE_SEND (64 << 10) // requests to a shard
+#define PTROUTE_PENDING 4096    // requests of a client in flight
+
+// End of a connection, first in both kinds so that an epoll event tells
+// which one it is.
+struct _ptroute_end
+{
+	short up; // a shard connection
+	int fd;
+	short events; // watched
+};
+
+struct _ptroute_conn;
+
+// Connection of a client to a shard.
+struct _ptroute_up
+{
+	struct _ptroute_end end;
+	struct _ptroute_conn *c;
+	size_t out_len;
+	size_t out_at;
+	size_t in_at;
+	size_t in_len;
+	char out[PTROUTE_SEND];
+	char in[PTSERVE_OUT]; // replies, room for a whole one at least
+};
+
+// Connection of a client to the router.
+struct _ptroute_conn
+{
+	struct _ptroute_end end;
+	short eof;
+	size_t in_len;
+	size_t out_len;
+	size_t out_at;
+	long head; // pending requests
+	long tail;
+	short pending[PTROUTE_PENDING]; // shards of the requests in flight
+	struct _ptroute_up *up[PTROUTE_MAX_SHARDS];
+	struct _ptroute_conn *next;
+	struct _ptroute_conn **pprev;
+	char in[PTROUTE_IN];
+	char out[PTSERVE_OUT];
+};
+
+// Router of request lines to shard servers by the location of the request.
+struct _ptroute
+{
+	int fd;
+	int ep;
+	const char *path;
+	short shards;
+	struct sockaddr_un shard[PTROUTE_MAX_SHARDS];
+	uint64_t point[PTROUTE_MAX_SHARDS * PTROUTE_VNODES]; // hash ring
+	short owner[PTROUTE_MAX_SHARDS * PTROUTE_VNODES];
+	float lat; // of requests with no location
+	float lng;
+	struct _ptroute_conn *head;
+	int quit;
+};
+
+int ptRouteInit(struct _ptroute *r, const char *path, const char **shards, short n, float lat, float lng);
+short ptRouteShard(struct _ptroute *r, double lat, double lng);
+void ptRouteRun(struct _ptroute *r);
+void ptRouteStop(struct _ptroute *r);
+
+#endif
@@ -0,0 +1,324 @@
+// ptsched.c
+// Prayer time notification scheduler
+// Keeps the next prayer time event of every subscriber in a hierarchical
+// timing wheel and fires a callback when the event is due.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <time.h>
+#include "ptsched.h"
+
+// Notes:
+// 1. A subscriber is in exactly one wheel slot, for its next event only.
+//     Inserting and removing is O(1). A slot of a higher level is cascaded
+//     down once per turn of the level below, so every subscriber moves
+//     at most PTSCHED_LEVELS - 1 times before it fires.
+// 2. On firing, the following event is looked up in the prayer times
+//     already calculated for the subscriber's date and the day after. The
+//     late events of a date may come after the first ones of the next,
+//     i.e. sunset after midnight in polar summer, so both are looked at.
+//     The dates move on by a day, with ptCalc() for the day after, only
+//     when the first date has no more events.
+// 3. The scheduler has no clock of its own. ptSchedAdvance() processes
+//     ticks up to a given time, so a simulation can replay days of events
+//     as fast as the callbacks allow. ptSchedRun() paces it against the
+//     wall clock at a chosen speed.
+//
+
+static void slotUnlink(struct _ptsched_sub *sub)
+{
+	*(sub->pprev) = sub->next;
+
+	if (sub->next != 0)
+		sub->next->pprev = sub->pprev;
+
+	sub->next = 0;
+	sub->pprev = 0;
+}
+
+// Put *sub* into the wheel slot of its due time.
+static void slotLink(struct _ptsched *s, struct _ptsched_sub *sub)
+{
+	struct _ptsched_sub **head;
+	int64_t due = sub->due < s->tick ? s->tick : sub->due;
+	uint64_t delta = (uint64_t)(due - s->tick);
+	short l;
+
+	for (l = 0; l < PTSCHED_LEVELS - 1; l++)
+	{
+		if (delta < ((uint64_t)1 << (PTSCHED_BITS * (l + 1))))
+			break;
+	}
+
+	// beyond the wheel, park at its far end to be cascaded again later
+	if (delta >= ((uint64_t)1 << (PTSCHED_BITS * PTSCHED_LEVELS)))
+		due = s->tick + (int64_t)((uint64_t)1 << (PTSCHED_BITS * PTSCHED_LEVELS)) - 1;
+
+	head = &(s->wheel[l][((uint64_t)due >> (PTSCHED_BITS * l)) & (PTSCHED_SLOTS - 1)]);
+
+	sub->next = *head;
+	sub->pprev = head;
+
+	if (*head != 0)
+		(*head)->pprev = &(sub->next);
+
+	*head = sub;
+}
+
+// Calculate the prayer times of the day after the date of *pt* into *after*.
+static void dayAfter(struct _ptimes *pt, struct _ptimes *after)
+{
+	short y, m, d;
+
+	*after = *pt;
+	gregorian(pt->jd + 1.0, &y, &m, &d);
+	ptSetDate(after, y, m, d);
+	after->phase = 0;
+
+	while (ptCalc(after) != 0);
+}
+
+// Move the subscriber's dates on by a day.
+static void nextDay(struct _ptsched *s, struct _ptsched_sub *sub)
+{
+	sub->pt = sub->after;
+	dayAfter(&(sub->pt), &(sub->after));
+	s->days++;
+}
+
+// Move *sub* to the first event after (due, field) in time and field order.
+static void nextEvent(struct _ptsched *s, struct _ptsched_sub *sub)
+{
+	struct _ptimes *pt;
+	int64_t u, bu = 0;
+	short f, k, best, left;
+	double t;
+
+	for (k = 0; k < 2; k++)
+	{
+		best = -1;
+		left = 0;
+
+		for (f = 0; f < 2 * PT_FIELDS; f++)
+		{
+			if ((s->fields & (1 << (f % PT_FIELDS))) == 0)
+				continue;
+
+			pt = f < PT_FIELDS ? &(sub->pt) : &(sub->after);
+			t = ptTime(pt, f % PT_FIELDS);
+
+			if (t != t) // NaN
+				continue;
+
+			u = (int64_t)ptUnixTime(pt, t);
+
+			if (u < sub->due || (u == sub->due && f % PT_FIELDS <= sub->field))
+				continue;
+
+			left |= f < PT_FIELDS;
+
+			if (best < 0 || u < bu || (u == bu && f % PT_FIELDS < best))
+			{
+				best = f % PT_FIELDS;
+				bu = u;
+			}
+		}
+
+		// move on a day when the first date has no events left
+		if (left)
+		{
+			sub->due = bu;
+			sub->field = best;
+			return;
+		}
+
+		nextDay(s, sub);
+	}
+
+	// no event for two days, i.e. polar nights without high latitude
+	// adjustment, look again from the start of the next day
+	sub->due = (int64_t)ptUnixTime(&(sub->pt), 0.0);
+	sub->field = -1;
+}
+
+static void fire(struct _ptsched *s, struct _ptsched_sub *sub)
+{
+	if (sub->field >= 0)
+	{
+		s->fired++;
+		s->fn(s, sub, s->arg);
+	}
+
+	if (sub->active == 0 || sub->pprev != 0) // removed or added again
+		return;
+
+	nextEvent(s, sub);
+	slotLink(s, sub);
+}
+
+// Move the subscribers of a slot of a higher *level* down the wheel.
+static void cascade(struct _ptsched *s, short level, int slot)
+{
+	struct _ptsched_sub *list, *sub;
+
+	list = s->wheel[level][slot];
+	s->wheel[level][slot] = 0;
+
+	if (list == 0)
+		return;
+
+	list->pprev = &list;
+
+	while ((sub = list) != 0)
+	{
+		slotUnlink(sub);
+		slotLink(s, sub);
+	}
+}
+
+// Start a scheduler at UTC seconds *now* to fire the prayer time *fields*
+// (i.e. PTSCHED_ALL or (1 << PT_FAJR) | (1 << PT_MAGHRIB)) with *fn*.
+void ptSchedInit(struct _ptsched *s, int64_t now, short fields, ptsched_fn fn, void *arg)
+{
+	short l;
+	int i;
+
+	s->tick = now;
+	s->count = 0;
+	s->fired = 0;
+	s->days = 0;
+	s->fields = fields;
+	s->fn = fn;
+	s->arg = arg;
+
+	for (l = 0; l < PTSCHED_LEVELS; l++)
+		for (i = 0; i < PTSCHED_SLOTS; i++)
+			s->wheel[l][i] = 0;
+}
+
+// Add a subscriber. *sub->pt* has its location and settings, and the
+// date that starts at or before the current tick, i.e. the local date.
+// Events before the current tick are skipped.
+void ptSchedAdd(struct _ptsched *s, struct _ptsched_sub *sub)
+{
+	if (sub->active != 0)
+		ptSchedRemove(s, sub);
+
+	sub->pt.phase = 0;
+
+	while (ptCalc(&(sub->pt)) != 0);
+
+	dayAfter(&(sub->pt), &(sub->after));
+	sub->due = s->tick - 1;
+	sub->field = PT_FIELDS;
+	sub->next = 0;
+	sub->pprev = 0;
+	sub->active = 1;
+	s->count++;
+
+	nextEvent(s, sub);
+	slotLink(s, sub);
+}
+
+void ptSchedRemove(struct _ptsched *s, struct _ptsched_sub *sub)
+{
+	if (sub->active == 0)
+		return;
+
+	if (sub->pprev != 0)
+		slotUnlink(sub);
+
+	sub->active = 0;
+	s->count--;
+}
+
+// Fire every event due up to and including UTC seconds *now*.
+// Return the number of events fired.
+long ptSchedAdvance(struct _ptsched *s, int64_t now)
+{
+	struct _ptsched_sub *list, *sub;
+	long fired = s->fired;
+	uint64_t t;
+	short l;
+	int i;
+
+	while (s->tick <= now)
+	{
+		if (s->count == 0)
+		{
+			s->tick = now + 1;
+			break;
+		}
+
+		t = (uint64_t)s->tick;
+
+		for (l = PTSCHED_LEVELS - 1; l > 0; l--)
+		{
+			if ((t & (((uint64_t)1 << (PTSCHED_BITS * l)) - 1)) == 0)
+				cascade(s, l, (int)((t >> (PTSCHED_BITS * l)) & (PTSCHED_SLOTS - 1)));
+		}
+
+		i = (int)(t & (PTSCHED_SLOTS - 1));
+
+		// subscribers due again at this tick are put back into the slot
+		while ((list = s->wheel[0][i]) != 0)
+		{
+			s->wheel[0][i] = 0;
+			list->pprev = &list;
+
+			while ((sub = list) != 0)
+			{
+				slotUnlink(sub);
+
+				if (sub->due <= s->tick)
+					fire(s, sub);
+				else
+					slotLink(s, sub);
+			}
+		}
+
+		s->tick++;
+	}
+
+	return s->fired - fired;
+}
+
+// Advance the scheduler up to UTC seconds *until* at *speed* times the
+// wall clock, i.e. 1000.0 to replay a day in under 90 seconds, or as fast
+// as possible when *speed* is 0. Return the number of events fired.
+long ptSchedRun(struct _ptsched *s, int64_t until, double speed)
+{
+	struct timespec w0, w, d;
+	int64_t t0 = s->tick, target;
+	long fired = 0;
+	double el, wait;
+
+	if (speed <= 0.0)
+		return ptSchedAdvance(s, until);
+
+	clock_gettime(CLOCK_MONOTONIC, &w0);
+
+	while (s->tick <= until)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &w);
+		el = (double)(w.tv_sec - w0.tv_sec) + (double)(w.tv_nsec - w0.tv_nsec) / 1e9;
+		target = t0 + (int64_t)(el * speed);
+
+		if (target > until)
+			target = until;
+
+		if (target >= s->tick)
+		{
+			fired += ptSchedAdvance(s, target);
+			continue;
+		}
+
+		// sleep until the wall clock reaches the next tick
+		wait = (double)(s->tick - t0) / speed - el;
+		d.tv_sec = (time_t)wait;
+		d.tv_nsec = (long)((wait - (double)d.tv_sec) * 1e9);
+		nanosleep(&d, 0);
+	}
+
+	return fired;
+}
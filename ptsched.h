@@ -0,0 +1,61 @@
+// ptsched.h
+
+#ifndef __PTSCHED_H__
+#define __PTSCHED_H__
+
+#include <stdint.h>
+#include "prayertimes.h"
+
+// Hierarchical timing wheel of one second ticks.
+// Each level has 256 slots and covers 256 times the span of the one below,
+// so four levels cover 2^32 seconds ahead.
+#define PTSCHED_LEVELS 4
+#define PTSCHED_BITS 8
+#define PTSCHED_SLOTS (1 << PTSCHED_BITS)
+
+// Field mask of every prayer time event.
+#define PTSCHED_ALL ((1 << PT_FIELDS) - 1)
+
+// A subscriber with its next prayer time event.
+// The memory is owned by the caller and is the same for every subscriber.
+struct _ptsched_sub
+{
+	long id;
+	struct _ptimes pt; // location, settings, and the times of pt's date
+	struct _ptimes after; // the times of the day after pt's date
+
+	// next event
+	int64_t due;  // UTC seconds since 1970-01-01
+	short field;  // prayer time field, or -1 to only move to the next day
+
+	// wheel slot list
+	struct _ptsched_sub *next;
+	struct _ptsched_sub **pprev;
+	short active;
+};
+
+struct _ptsched;
+
+// Called when the event *sub->field* of a subscriber is due at *sub->due*.
+// The callback may remove the subscriber with ptSchedRemove().
+typedef void (*ptsched_fn)(struct _ptsched *s, struct _ptsched_sub *sub, void *arg);
+
+struct _ptsched
+{
+	int64_t tick;   // the next tick to process in UTC seconds
+	long count;     // active subscribers
+	long fired;     // events fired so far
+	long days;      // ptCalc() runs for following days
+	short fields;   // mask of fields to fire, 1 << PT_FAJR etc.
+	ptsched_fn fn;
+	void *arg;
+	struct _ptsched_sub *wheel[PTSCHED_LEVELS][PTSCHED_SLOTS];
+};
+
+void ptSchedInit(struct _ptsched *s, int64_t now, short fields, ptsched_fn fn, void *arg);
+void ptSchedAdd(struct _ptsched *s, struct _ptsched_sub *sub);
+void ptSchedRemove(struct _ptsched *s, struct _ptsched_sub *sub);
+long ptSchedAdvance(struct _ptsched *s, int64_t now);
+long ptSchedRun(struct _ptsched *s, int64_t until, double speed);
+
+#endif
@@ -0,0 +1,403 @@
+// ptserve.c
+// Unix domain socket server
+// Answers request lines from many connections on a few threads, each with
+// an epoll instance of its own, so a query costs no process or thread of
+// its own.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "ptserve.h"
+
+// Notes:
+// 1. Every worker waits on the listening socket with EPOLLEXCLUSIVE, so a
+//     new connection wakes up one worker, which keeps the connection for
+//     its lifetime. No lock is taken on the way of a request.
+// 2. A request is a line and its reply is whatever the handler writes.
+//     Every line read is answered in order, and the replies of all the
+//     lines of a read go out with one send(), so pipelined requests are
+//     answered in batches.
+// 3. Lines are answered only while the output buffer has PTSERVE_REPLY
+//     bytes free. Otherwise the connection waits for the client to read,
+//     with no more reading from it until the output is sent.
+// 4. A line longer than PTSERVE_IN is answered as an empty line.
+// 5. A client may shut down its side after its requests. The connection
+//     is closed once the replies are sent. A last line with no newline
+//     before the end is answered as any other.
+//
+
+#define EVENTS 64
+
+// A connection of a worker.
+struct _ptserve_conn
+{
+	int fd;
+	short skip; // discard up to the end of a line too long
+	short eof; // the client sends no more
+	short out_wait; // waiting for room to send
+	size_t in_len;
+	size_t out_len;
+	size_t out_at;
+	struct _ptserve_conn *next;
+	struct _ptserve_conn **pprev;
+	char in[PTSERVE_IN];
+	char out[PTSERVE_OUT];
+};
+
+static int nonblock(int fd)
+{
+	int fl = fcntl(fd, F_GETFL);
+
+	return fl < 0 ? -1 : fcntl(fd, F_SETFL, fl | O_NONBLOCK);
+}
+
+static void drop(struct _ptserve_worker *w, struct _ptserve_conn *c)
+{
+	*(c->pprev) = c->next;
+
+	if (c->next != 0)
+		c->next->pprev = c->pprev;
+
+	epoll_ctl(w->ep, EPOLL_CTL_DEL, c->fd, 0);
+	close(c->fd);
+	free(c);
+	w->conns--;
+}
+
+// Wait for *c* to be readable, or writable when *out*.
+static void watch(struct _ptserve_worker *w, struct _ptserve_conn *c, short out)
+{
+	struct epoll_event ev;
+
+	if (c->out_wait == out)
+		return;
+
+	c->out_wait = out;
+	ev.events = out ? EPOLLOUT : EPOLLIN;
+	ev.data.ptr = c;
+	epoll_ctl(w->ep, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+// Send the pending output of *c*. Return -1 when the connection is lost.
+static int flush(struct _ptserve_conn *c)
+{
+	ssize_t n;
+
+	while (c->out_at < c->out_len)
+	{
+		n = send(c->fd, c->out + c->out_at, c->out_len - c->out_at, MSG_NOSIGNAL);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return 0;
+
+		if (n <= 0)
+			return -1;
+
+		c->out_at += (size_t)n;
+	}
+
+	c->out_at = 0;
+	c->out_len = 0;
+
+	return 0;
+}
+
+// Answer the complete lines in the input of *c* while there is room.
+// Return the number of lines answered.
+static long answer(struct _ptserve_worker *w, struct _ptserve_conn *c)
+{
+	struct _ptserve *s = w->s;
+	char *p = c->in, *e = c->in + c->in_len, *eol;
+	long n = 0;
+
+	while (p < e && PTSERVE_OUT - c->out_len >= PTSERVE_REPLY)
+	{
+		eol = memchr(p, '\n', e - p);
+
+		if (c->skip) // the rest of a line too long
+		{
+			p = eol == 0 ? e : eol + 1;
+			c->skip = eol == 0;
+			continue;
+		}
+
+		if (eol == 0 && c->eof) // the last line, with no newline
+		{
+			c->out_len += s->fn(s->arg, p, e, c->out + c->out_len, PTSERVE_REPLY);
+			p = e;
+			++n;
+			break;
+		}
+
+		if (eol == 0)
+		{
+			if (p > c->in || c->in_len < PTSERVE_IN)
+				break; // wait for the rest of the line
+
+			// too long, answer as empty and discard the rest
+			c->out_len += s->fn(s->arg, p, p, c->out + c->out_len, PTSERVE_REPLY);
+			c->skip = 1;
+			p = e;
+			++n;
+			break;
+		}
+
+		c->out_len += s->fn(s->arg, p, eol, c->out + c->out_len, PTSERVE_REPLY);
+		p = eol + 1;
+		++n;
+	}
+
+	c->in_len = (size_t)(e - p);
+	memmove(c->in, p, c->in_len);
+	w->requests += n;
+
+	return n;
+}
+
+// Read, answer and send on connection *c*.
+static void serve(struct _ptserve_worker *w, struct _ptserve_conn *c, unsigned int events)
+{
+	ssize_t n;
+
+	if (events & (EPOLLERR | EPOLLHUP) && !(events & (EPOLLIN | EPOLLOUT)))
+	{
+		drop(w, c);
+		return;
+	}
+
+	if (!(events & EPOLLOUT))
+	{
+		while (c->in_len < PTSERVE_IN)
+		{
+			n = read(c->fd, c->in + c->in_len, PTSERVE_IN - c->in_len);
+
+			if (n < 0 && errno == EINTR)
+				continue;
+
+			if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+				break;
+
+			if (n <= 0)
+			{
+				c->eof = 1;
+				break;
+			}
+
+			c->in_len += (size_t)n;
+			answer(w, c);
+
+			if (PTSERVE_OUT - c->out_len < PTSERVE_REPLY)
+				break;
+		}
+	}
+
+	// send, and answer the lines left for lack of room
+	do
+	{
+		if (flush(c) < 0)
+		{
+			drop(w, c);
+			return;
+		}
+	}
+	while (c->out_len == 0 && answer(w, c) > 0);
+
+	if (c->eof && c->out_len == 0)
+	{
+		drop(w, c);
+		return;
+	}
+
+	watch(w, c, c->out_len > 0);
+}
+
+// Accept the connections waiting on the listening socket.
+static void welcome(struct _ptserve_worker *w)
+{
+	struct epoll_event ev;
+	struct _ptserve_conn *c;
+	int fd;
+
+	while ((fd = accept(w->s->fd, 0, 0)) >= 0)
+	{
+		c = malloc(sizeof(struct _ptserve_conn));
+
+		if (c == 0 || nonblock(fd) != 0)
+		{
+			free(c);
+			close(fd);
+			continue;
+		}
+
+		c->fd = fd;
+		c->skip = 0;
+		c->eof = 0;
+		c->out_wait = 0;
+		c->in_len = 0;
+		c->out_len = 0;
+		c->out_at = 0;
+
+		ev.events = EPOLLIN;
+		ev.data.ptr = c;
+
+		if (epoll_ctl(w->ep, EPOLL_CTL_ADD, fd, &ev) != 0)
+		{
+			free(c);
+			close(fd);
+			continue;
+		}
+
+		c->next = w->head;
+		c->pprev = &(w->head);
+
+		if (w->head != 0)
+			w->head->pprev = &(c->next);
+
+		w->head = c;
+		w->conns++;
+	}
+}
+
+static void *work(void *arg)
+{
+	struct _ptserve_worker *w = arg;
+	struct epoll_event ev[EVENTS];
+	int i, n;
+
+	while (!__atomic_load_n(&(w->s->quit), __ATOMIC_ACQUIRE))
+	{
+		n = epoll_wait(w->ep, ev, EVENTS, 200);
+
+		for (i = 0; i < n; i++)
+		{
+			if (ev[i].data.ptr == 0)
+				welcome(w);
+			else
+				serve(w, ev[i].data.ptr, ev[i].events);
+		}
+	}
+
+	return 0;
+}
+
+// Listen on Unix domain socket *path* with *threads* workers, 0 for one per
+// online CPU, answering every request line with *fn*.
+// Return 0 on success, -1 on failure.
+int ptServeInit(struct _ptserve *s, const char *path, int threads, ptserve_fn fn, void *arg)
+{
+	struct sockaddr_un a;
+	struct epoll_event ev;
+	int i;
+
+	if (strlen(path) >= sizeof(a.sun_path))
+		return -1;
+
+	if (threads <= 0)
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (threads < 1)
+		threads = 1;
+	else if (threads > PTSERVE_MAX_THREADS)
+		threads = PTSERVE_MAX_THREADS;
+
+	memset(&a, 0, sizeof(a));
+	a.sun_family = AF_UNIX;
+	strcpy(a.sun_path, path);
+	unlink(path);
+
+	s->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (s->fd < 0)
+		return -1;
+
+	if (bind(s->fd, (struct sockaddr *)&a, sizeof(a)) != 0
+		|| listen(s->fd, 1024) != 0 || nonblock(s->fd) != 0)
+	{
+		close(s->fd);
+		return -1;
+	}
+
+	s->path = path;
+	s->threads = threads;
+	s->fn = fn;
+	s->arg = arg;
+	s->quit = 0;
+	s->w = calloc(threads, sizeof(struct _ptserve_worker));
+
+	if (s->w == 0)
+	{
+		close(s->fd);
+		return -1;
+	}
+
+	for (i = 0; i < threads; i++)
+	{
+		s->w[i].s = s;
+		s->w[i].ep = epoll_create1(0);
+		ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+		ev.data.ptr = 0; // the listening socket
+
+		if (s->w[i].ep < 0 || epoll_ctl(s->w[i].ep, EPOLL_CTL_ADD, s->fd, &ev) != 0)
+		{
+			while (i >= 0)
+			{
+				if (s->w[i].ep >= 0)
+					close(s->w[i].ep);
+
+				--i;
+			}
+
+			free(s->w);
+			close(s->fd);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+// Serve on the workers, the calling thread being the first, until
+// ptServeStop(). Then close every connection and remove the socket.
+void ptServeRun(struct _ptserve *s)
+{
+	int i, started;
+
+	for (started = 1; started < s->threads; started++)
+	{
+		if (pthread_create(&(s->w[started].th), 0, work, &(s->w[started])) != 0)
+			break;
+	}
+
+	work(&(s->w[0]));
+
+	for (i = 1; i < started; i++)
+		pthread_join(s->w[i].th, 0);
+
+	for (i = 0; i < s->threads; i++)
+	{
+		while (s->w[i].head != 0)
+			drop(&(s->w[i]), s->w[i].head);
+
+		close(s->w[i].ep);
+	}
+
+	close(s->fd);
+	unlink(s->path);
+	free(s->w);
+}
+
+// Stop the server. Safe to call from a signal handler.
+void ptServeStop(struct _ptserve *s)
+{
+	__atomic_store_n(&(s->quit), 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,53 @@
+// ptserve.h
+
+#ifndef __PTSERVE_H__
+#define __PTSERVE_H__
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define PTSERVE_MAX_THREADS 64
+
+// Buffers of a connection, allocated with it when it is accepted, so every
+// open connection costs PTSERVE_IN + PTSERVE_OUT, about 528 KB, of which
+// only the pages touched by its requests and replies are resident. Keep
+// it in mind for many idle connections: 1000 of them reserve about 516 MB.
+#define PTSERVE_IN (16 << 10)     // request buffer of a connection, the longest request line
+#define PTSERVE_REPLY (256 << 10) // room given for the reply of a request
+#define PTSERVE_OUT (2 * PTSERVE_REPLY)
+
+// Reply to request line [s, e) into *out* of *room* bytes.
+// Return the length of the reply.
+typedef size_t (*ptserve_fn)(void *arg, const char *s, const char *e, char *out, size_t room);
+
+struct _ptserve;
+struct _ptserve_conn;
+
+// A worker thread with an epoll instance of its own.
+struct _ptserve_worker
+{
+	struct _ptserve *s;
+	pthread_t th;
+	int ep;
+	struct _ptserve_conn *head; // connections
+	long conns;
+	long requests;
+};
+
+// Line protocol server on a Unix domain socket.
+struct _ptserve
+{
+	int fd;
+	const char *path;
+	int threads;
+	struct _ptserve_worker *w;
+	ptserve_fn fn;
+	void *arg;
+	int quit;
+};
+
+int ptServeInit(struct _ptserve *s, const char *path, int threads, ptserve_fn fn, void *arg);
+void ptServeRun(struct _ptserve *s);
+void ptServeStop(struct _ptserve *s);
+
+#endif
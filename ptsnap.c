@@ -0,0 +1,366 @@
+// ptsnap.c
+// Daily prayer times snapshots
+// Keeps the prayer times of today for a fixed set of registered
+// locations, calculates tomorrow's in the background, and switches over
+// at midnight with a single pointer store, so lookups take no lock.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <time.h>
+#include "ptgrid.h"
+#include "ptsnap.h"
+
+// Notes:
+// 1. A day is never changed once published. Readers load the current day
+//     and search its sorted ids, with no lock, no retry and no write other
+//     than to their own reader slot, so a lookup is wait-free and never
+//     sees a day half calculated.
+// 2. Replaced days are reclaimed by epochs. A reader announces the epoch
+//     before it loads the current day. A day replaced at epoch e may only
+//     be in use by readers that announced e or before, so it is freed once
+//     every reader is idle or in a later epoch.
+// 3. The date of a snapshot is the local date of the time zone of the
+//     manager, the same calendar date for every location. Locations over
+//     many time zones are better served by a manager per zone.
+// 4. The background thread calculates the next day right after the
+//     switch, and sleeps until the local midnight. A snapshot started on
+//     a past date catches up a day at a time. ptSnapRoll() switches at
+//     once, i.e. for replays and tests.
+//
+
+struct _order
+{
+	long id;
+	long i;
+};
+
+static int byId(const void *a, const void *b)
+{
+	const struct _order *x = a, *y = b;
+
+	return x->id < y->id ? -1 : x->id > y->id;
+}
+
+// Calculate the day after the current one, or day *jd* when there is
+// none yet. Return 0 when out of memory.
+static struct _ptsnap_day *calcDay(struct _ptsnap *s, double jd)
+{
+	struct _ptsnap_day *d = malloc(sizeof(struct _ptsnap_day));
+	short y, m, dd;
+
+	if (d == 0)
+		return 0;
+
+	d->t = malloc(sizeof(double) * PT_FIELDS * (s->n > 0 ? s->n : 1));
+
+	if (d->t == 0)
+	{
+		free(d);
+		return 0;
+	}
+
+	gregorian(jd, &y, &m, &dd);
+	d->jd = jd;
+	d->n = s->n;
+	d->id = s->id;
+	d->retired = 0;
+	d->next = 0;
+
+	if (s->n > 0)
+	{
+		pthread_mutex_lock(&(s->calc));
+		ptGridRun(&(s->pool), s->loc, s->n, y, m, dd, 1, d->t);
+		pthread_mutex_unlock(&(s->calc));
+	}
+
+	return d;
+}
+
+// Free the retired days no reader can be in.
+static void reclaim(struct _ptsnap *s)
+{
+	struct _ptsnap_day **p = &(s->retired), *d;
+	uint64_t e, oldest = UINT64_MAX;
+	short r;
+
+	for (r = 0; r < PTSNAP_MAX_READERS; r++)
+	{
+		e = __atomic_load_n(&(s->reader[r].epoch), __ATOMIC_SEQ_CST);
+
+		if (e != 0 && e < oldest)
+			oldest = e;
+	}
+
+	while ((d = *p) != 0)
+	{
+		if (d->retired < oldest)
+		{
+			*p = d->next;
+			free(d->t);
+			free(d);
+			s->freed++;
+		}
+		else
+			p = &(d->next);
+	}
+}
+
+// Publish the next day, calculated ahead or now. Return 0 on success,
+// -1 when out of memory. Called with the writer lock.
+static int publish(struct _ptsnap *s)
+{
+	struct _ptsnap_day *old = s->cur;
+
+	if (s->next == 0 && (s->next = calcDay(s, old->jd + 1.0)) == 0)
+		return -1;
+
+	__atomic_store_n(&(s->cur), s->next, __ATOMIC_SEQ_CST);
+	s->next = 0;
+
+	old->retired = __atomic_fetch_add(&(s->epoch), 1, __ATOMIC_SEQ_CST);
+	old->next = s->retired;
+	s->retired = old;
+	s->days++;
+
+	reclaim(s);
+
+	return 0;
+}
+
+// Register *n* locations *loc*, with their settings, of ids *id*, and
+// publish their prayer times of *year*-*month*-*day*, the local date in
+// time zone *tz*, calculated on *threads* threads, 0 for one per CPU.
+// Return 0 on success, -1 on failure.
+int ptSnapInit(struct _ptsnap *s, struct _ptimes *loc, const long *id, long n, float tz, int threads, short year, short month, short day)
+{
+	struct _order *o = malloc(sizeof(struct _order) * (n > 0 ? n : 1));
+	long i;
+	short r;
+
+	s->loc = malloc(sizeof(struct _ptimes) * (n > 0 ? n : 1));
+	s->id = malloc(sizeof(long) * (n > 0 ? n : 1));
+
+	if (o == 0 || s->loc == 0 || s->id == 0 || ptPoolInit(&(s->pool), threads) != 0)
+	{
+		free(o);
+		free(s->loc);
+		free(s->id);
+		return -1;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		o[i].id = id[i];
+		o[i].i = i;
+	}
+
+	qsort(o, n, sizeof(struct _order), byId);
+
+	for (i = 0; i < n; i++)
+	{
+		s->id[i] = o[i].id;
+		s->loc[i] = loc[o[i].i];
+	}
+
+	free(o);
+
+	s->n = n;
+	s->tz = tz;
+	s->next = 0;
+	s->retired = 0;
+	s->epoch = 1;
+	s->running = 0;
+	s->quit = 0;
+	s->days = 1;
+	s->freed = 0;
+
+	for (r = 0; r < PTSNAP_MAX_READERS; r++)
+		s->reader[r].epoch = 0;
+
+	pthread_mutex_init(&(s->lock), 0);
+	pthread_mutex_init(&(s->calc), 0);
+	pthread_cond_init(&(s->wake), 0);
+
+	s->cur = calcDay(s, julian(year, month, day));
+
+	if (s->cur == 0)
+	{
+		ptSnapFree(s);
+		return -1;
+	}
+
+	return 0;
+}
+
+// Start reading as *reader*, a slot of its own from 0 to
+// PTSNAP_MAX_READERS - 1. Return the current day, valid until
+// ptSnapLeave().
+struct _ptsnap_day *ptSnapEnter(struct _ptsnap *s, short reader)
+{
+	__atomic_store_n(&(s->reader[reader].epoch), __atomic_load_n(&(s->epoch), __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+
+	return __atomic_load_n(&(s->cur), __ATOMIC_SEQ_CST);
+}
+
+// Prayer times of location *id* in day *d*, 0 if not registered.
+const double *ptSnapFind(struct _ptsnap_day *d, long id)
+{
+	long lo = 0, hi = d->n - 1, m;
+
+	while (lo <= hi)
+	{
+		m = lo + (hi - lo) / 2;
+
+		if (d->id[m] < id)
+			lo = m + 1;
+		else if (d->id[m] > id)
+			hi = m - 1;
+		else
+			return d->t + m * PT_FIELDS;
+	}
+
+	return 0;
+}
+
+void ptSnapLeave(struct _ptsnap *s, short reader)
+{
+	__atomic_store_n(&(s->reader[reader].epoch), 0, __ATOMIC_RELEASE);
+}
+
+// Copy today's prayer times of location *id* to *t* as *reader*.
+// Return 0 when the location is not registered.
+int ptSnapGet(struct _ptsnap *s, short reader, long id, double *t)
+{
+	const double *p = ptSnapFind(ptSnapEnter(s, reader), id);
+	short f;
+
+	for (f = 0; p != 0 && f < PT_FIELDS; f++)
+		t[f] = p[f];
+
+	ptSnapLeave(s, reader);
+
+	return p != 0;
+}
+
+// Switch to the next day now. Return 0 on success, -1 when out of memory.
+int ptSnapRoll(struct _ptsnap *s)
+{
+	int r;
+
+	pthread_mutex_lock(&(s->lock));
+	r = publish(s);
+	pthread_cond_signal(&(s->wake)); // to calculate ahead again
+	pthread_mutex_unlock(&(s->lock));
+
+	return r;
+}
+
+// Local midnight that starts the day after day *d*, in wall clock time.
+static struct timespec rollover(struct _ptsnap *s, struct _ptsnap_day *d)
+{
+	struct timespec t;
+
+	t.tv_sec = (time_t)((d->jd + 1.0 - 2440587.5) * 86400.0 - (double)s->tz * 3600.0);
+	t.tv_nsec = 0;
+
+	return t;
+}
+
+static void *manage(void *arg)
+{
+	struct _ptsnap *s = arg;
+	struct _ptsnap_day *d;
+	struct timespec at;
+
+	pthread_mutex_lock(&(s->lock));
+
+	while (!s->quit)
+	{
+		d = s->cur;
+
+		// calculate ahead without the lock, ptSnapRoll() may not wait
+		if (s->next == 0)
+		{
+			pthread_mutex_unlock(&(s->lock));
+			d = calcDay(s, d->jd + 1.0);
+			pthread_mutex_lock(&(s->lock));
+
+			if (d != 0 && s->next == 0 && d->jd == s->cur->jd + 1.0)
+				s->next = d;
+			else if (d != 0)
+			{
+				free(d->t);
+				free(d);
+			}
+
+			continue;
+		}
+
+		at = rollover(s, s->cur);
+
+		if (pthread_cond_timedwait(&(s->wake), &(s->lock), &at) != 0 && !s->quit)
+		{
+			if (s->next != 0 && s->next->jd == s->cur->jd + 1.0)
+				publish(s);
+		}
+
+		reclaim(s); // readers may have left since
+	}
+
+	pthread_mutex_unlock(&(s->lock));
+
+	return 0;
+}
+
+// Switch days at the local midnights on a thread of the manager.
+// Return 0 on success, -1 on failure.
+int ptSnapStart(struct _ptsnap *s)
+{
+	if (pthread_create(&(s->th), 0, manage, s) != 0)
+		return -1;
+
+	s->running = 1;
+
+	return 0;
+}
+
+// Stop the manager and free every day. No reader may be left.
+void ptSnapFree(struct _ptsnap *s)
+{
+	struct _ptsnap_day *d;
+
+	if (s->running)
+	{
+		pthread_mutex_lock(&(s->lock));
+		s->quit = 1;
+		pthread_cond_signal(&(s->wake));
+		pthread_mutex_unlock(&(s->lock));
+		pthread_join(s->th, 0);
+		s->running = 0;
+	}
+
+	if (s->cur != 0)
+		s->cur->next = s->next;
+
+	for (d = s->retired; d != 0; d = s->retired)
+	{
+		s->retired = d->next;
+		free(d->t);
+		free(d);
+	}
+
+	for (d = s->cur; d != 0; d = s->cur)
+	{
+		s->cur = d->next;
+		free(d->t);
+		free(d);
+	}
+
+	ptPoolFree(&(s->pool));
+	pthread_mutex_destroy(&(s->lock));
+	pthread_mutex_destroy(&(s->calc));
+	pthread_cond_destroy(&(s->wake));
+	free(s->loc);
+	free(s->id);
+}
@@ -0,0 +1,64 @@
+// ptsnap.h
+
+#ifndef __PTSNAP_H__
+#define __PTSNAP_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include "prayertimes.h"
+#include "ptpool.h"
+
+#define PTSNAP_MAX_READERS 128
+
+// Prayer times of every registered location for a date.
+struct _ptsnap_day
+{
+	double jd;
+	long n;
+	const long *id; // sorted, shared by every day
+	double *t;      // times of location i at t[i * PT_FIELDS + PT_IMSAK] and so on
+	uint64_t retired; // epoch it was replaced at
+	struct _ptsnap_day *next; // retired list
+};
+
+// Epoch a reader thread is in, 0 when not reading.
+struct _ptsnap_reader
+{
+	uint64_t epoch;
+	char pad[64 - sizeof(uint64_t)]; // a cache line each
+};
+
+// Daily snapshots of the prayer times of registered locations, switched
+// over at the local midnight of *tz*.
+struct _ptsnap
+{
+	long n;
+	struct _ptimes *loc; // sorted by id
+	long *id;
+	float tz;
+	struct _ptpool pool;
+	struct _ptsnap_day *cur;  // published
+	struct _ptsnap_day *next; // calculated ahead
+	struct _ptsnap_day *retired;
+	uint64_t epoch;
+	struct _ptsnap_reader reader[PTSNAP_MAX_READERS];
+	pthread_mutex_t lock; // of the writers
+	pthread_mutex_t calc; // of the pool
+	pthread_cond_t wake;
+	pthread_t th;
+	int running;
+	int quit;
+	long days; // published
+	long freed;
+};
+
+int ptSnapInit(struct _ptsnap *s, struct _ptimes *loc, const long *id, long n, float tz, int threads, short year, short month, short day);
+struct _ptsnap_day *ptSnapEnter(struct _ptsnap *s, short reader);
+const double *ptSnapFind(struct _ptsnap_day *d, long id);
+void ptSnapLeave(struct _ptsnap *s, short reader);
+int ptSnapGet(struct _ptsnap *s, short reader, long id, double *t);
+int ptSnapRoll(struct _ptsnap *s);
+int ptSnapStart(struct _ptsnap *s);
+void ptSnapFree(struct _ptsnap *s);
+
+#endif
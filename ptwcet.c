@@ -0,0 +1,280 @@
+// ptwcet.c
+// Worst case time of the ptCalc() phases
+// Runs every phase of ptCalc() over a sweep of adversarial inputs: the
+// poles and the polar circles, NAN, infinite and huge coordinates, dates
+// at the ends of a short year, every method, high latitude rule and model
+// of the Sun. Reports the most cycles each phase took, and the input.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "prayertimes.h"
+#include "ptmethod.h"
+
+// Notes:
+// 1. A phase is timed from a copy of the state the phases before it left,
+//     a few times over, and the fastest run is kept. That leaves out the
+//     interrupts and the cache misses of the harness, which belong to the
+//     system the library runs in. The largest of those over the inputs is
+//     the measured worst case of the phase.
+// 2. Cycles are of the time stamp counter on x86, otherwise nanoseconds
+//     of the monotonic clock. The cost of reading them is taken off.
+// 3. The inputs are every extreme value of every setting with the others
+//     at their default, then random picks of the values of all settings
+//     together, from a fixed seed so runs compare.
+// 4. The bound of ptCalc() is the sum of the worst cases of its phases,
+//     as a scheduler running one phase per tick would see them.
+//
+
+#define WCET_PHASES 29
+#define WCET_SETTINGS 10
+
+// Inputs of a run.
+struct _input
+{
+	float lat;
+	float lng;
+	float elv;
+	float tz;
+	short year;
+	short month;
+	short day;
+	short method;
+	short high_lats;
+	float asr_factor;
+	short model;
+	short shared; // with the positions of the Sun shared
+};
+
+// Worst case of a phase.
+struct _worst
+{
+	uint64_t max;
+	uint64_t sum;
+	struct _input at;
+};
+
+static const float lats[] = {0.0f, -90.0f, -89.999f, -66.56f, 1e-40f, 45.0f, 65.0f, 66.56f, 89.999f, 90.0f, 1e30f, -1e30f, NAN, INFINITY};
+static const float lngs[] = {0.0f, -180.0f, 180.0f, 1e30f, -1e30f, NAN, INFINITY};
+static const float elvs[] = {0.0f, -1e30f, -1.0f, 1e-40f, 8848.0f, 1e30f, NAN, INFINITY};
+static const float tzs[] = {0.0f, -12.0f, 14.0f, 1e30f, NAN, -INFINITY};
+static const short dates[][3] = {{2024, 6, 21}, {2024, 12, 21}, {2024, 2, 29}, {1582, 10, 15}, {1, 1, 1},
+	{32767, 12, 31}, {-32768, 1, 1}, {2024, 13, 40}, {0, 0, 0}};
+static const short methods[] = {0, 1, 2, 3, 4, 5, 6};
+static const short highs[] = {HIGHLAT_NIGHT_MIDDLE, HIGHLAT_NONE, HIGHLAT_ANGLE_BASED, HIGHLAT_ONE_SEVEN};
+static const float asrs[] = {1.0f, 2.0f, 0.0f, 1e30f};
+static const short models[] = {PT_SUN_USNO, PT_SUN_NOAA, PT_SUN_LITE};
+static const short shareds[] = {0, 1};
+
+#define COUNT(a) ((int)(sizeof(a) / sizeof(a[0])))
+
+static const int counts[WCET_SETTINGS] = {COUNT(lats), COUNT(lngs), COUNT(elvs), COUNT(tzs), COUNT(dates),
+	COUNT(methods), COUNT(highs), COUNT(asrs), COUNT(models), COUNT(shareds)};
+
+static uint64_t rnd(uint64_t *s)
+{
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+
+	return *s;
+}
+
+static uint64_t ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// Set input *in* to the values of index *v* of every setting.
+static void pick(struct _input *in, const int *v)
+{
+	in->lat = lats[v[0]];
+	in->lng = lngs[v[1]];
+	in->elv = elvs[v[2]];
+	in->tz = tzs[v[3]];
+	in->year = dates[v[4]][0];
+	in->month = dates[v[4]][1];
+	in->day = dates[v[4]][2];
+	in->method = methods[v[5]];
+	in->high_lats = highs[v[6]];
+	in->asr_factor = asrs[v[7]];
+	in->model = models[v[8]];
+	in->shared = shareds[v[9]];
+}
+
+// Time every phase of input *in*, best of *repeats*, into *w*.
+static void run(const struct _input *in, int repeats, uint64_t overhead, struct _worst *w, struct _worst *total)
+{
+	struct _ptimes pt, snap;
+	struct _ptsun sun;
+	uint64_t t, best, sum = 0;
+	short phase;
+	int k;
+
+	ptInit(&pt);
+	ptSetMethod(&pt, in->method);
+	ptSetLocation(&pt, in->lat, in->lng, in->elv, in->tz);
+	ptSetDate(&pt, in->year, in->month, in->day);
+	ptSetSunModel(&pt, in->model);
+	pt.high_lats = in->high_lats;
+	pt.asr_factor = in->asr_factor;
+
+	if (in->shared)
+	{
+		ptSunInit(&sun, pt.jd, pt.sun_model);
+		pt.sun = &sun;
+	}
+
+	for (phase = 0; phase < WCET_PHASES; phase++)
+	{
+		snap = pt;
+		best = UINT64_MAX;
+
+		for (k = 0; k < repeats; k++)
+		{
+			pt = snap;
+			t = ticks();
+			ptCalc(&pt);
+			t = ticks() - t;
+
+			if (t < best)
+				best = t;
+		}
+
+		best = best > overhead ? best - overhead : 0;
+		sum += best;
+		w[phase].sum += best;
+
+		if (best > w[phase].max)
+		{
+			w[phase].max = best;
+			w[phase].at = *in;
+		}
+	}
+
+	total->sum += sum;
+
+	if (sum > total->max)
+	{
+		total->max = sum;
+		total->at = *in;
+	}
+}
+
+static void printInput(const struct _input *in)
+{
+	printf("%g %g %g %g %d-%d-%d m%d h%d f%g x%d%s", in->lat, in->lng, in->elv, in->tz,
+		in->year, in->month, in->day, in->method + 1, in->high_lats, in->asr_factor,
+		in->model + 1, in->shared ? " shared" : "");
+}
+
+static void help(void)
+{
+	printf("PRAYER TIMES WORST CASE TIME\n\n");
+	printf("USAGE:\n");
+	printf("\tptwcet <options>\n\n");
+	printf("\toptions:\n");
+	printf("\tn <inputs>       random inputs on top of the extremes, 20000 by default\n");
+	printf("\tr <repeats>      timed runs of a phase, the best kept, 8 by default\n");
+	printf("\ts <seed>         of the inputs\n");
+	printf("\n");
+	printf("\tExample: ptwcet n 100000\n\n");
+}
+
+int main(int argc, char *argv[])
+{
+	static struct _worst w[WCET_PHASES];
+	struct _worst total;
+	struct _input in;
+	uint64_t seed = 88172645463325252ULL, t, bound = 0, overhead = UINT64_MAX;
+	long n = 20000, runs = 0, i;
+	int repeats = 8, v[WCET_SETTINGS], k, j;
+
+	for (k = 1; k + 1 < argc; k += 2)
+	{
+		switch (argv[k][0] != '\0' && argv[k][1] == '\0' ? argv[k][0] : 0)
+		{
+			case 'n': n = atol(argv[k + 1]); break;
+			case 'r': repeats = atoi(argv[k + 1]); break;
+			case 's': seed = strtoull(argv[k + 1], 0, 10) | 1; break;
+			default: help(); return 1;
+		}
+	}
+
+	if (n < 0 || repeats < 1 || k < argc)
+	{
+		help();
+		return 1;
+	}
+
+	for (k = 0; k < 1000; k++)
+	{
+		t = ticks();
+		t = ticks() - t;
+
+		if (t < overhead)
+			overhead = t;
+	}
+
+	memset(&total, 0, sizeof(total));
+
+	// every value of a setting, the others at the first
+	for (j = 0; j < WCET_SETTINGS; j++)
+	{
+		for (k = 0; k < counts[j]; k++)
+		{
+			memset(v, 0, sizeof(v));
+			v[j] = k;
+			pick(&in, v);
+			run(&in, repeats, overhead, w, &total);
+			++runs;
+		}
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		for (j = 0; j < WCET_SETTINGS; j++)
+			v[j] = (int)(rnd(&seed) % (uint64_t)counts[j]);
+
+		pick(&in, v);
+		run(&in, repeats, overhead, w, &total);
+		++runs;
+	}
+
+#if defined(__x86_64__) || defined(__i386__)
+	printf("%ld inputs, best of %d, in cycles of the time stamp counter\n\n", runs, repeats);
+#else
+	printf("%ld inputs, best of %d, in nanoseconds\n\n", runs, repeats);
+#endif
+	printf("%-6s %8s %8s  %s\n", "phase", "worst", "mean", "worst input: lat lng elv tz date settings");
+
+	for (k = 0; k < WCET_PHASES; k++)
+	{
+		bound += w[k].max;
+		printf("%-6d %8llu %8.0f  ", k, (unsigned long long)w[k].max, (double)w[k].sum / (double)runs);
+		printInput(&w[k].at);
+		printf("\n");
+	}
+
+	printf("%-6s %8llu %8.0f  ", "all", (unsigned long long)total.max, (double)total.sum / (double)runs);
+	printInput(&total.at);
+	printf("\n%-6s %8llu\n", "bound", (unsigned long long)bound);
+
+	return 0;
+}
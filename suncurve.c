@@ -0,0 +1,125 @@
+// suncurve.c
+// Whole-day solar elevation/azimuth curve
+// The hour angle advances by the same step between samples. Hence its
+// cosine and sine are rotated forward with a few multiply-adds instead
+// of calling dm_cos() and dm_sin() for every sample.
+
+#include "suncurve.h"
+
+// Notes:
+// 1. The declination and the equation of time are taken once at sundial
+//     noon of the date, as ptCalc() does for dhuhr. Their change through
+//     the day (below 0.4 degree and 30 seconds) is not followed.
+// 2. Every rotation rounds cos(H) and sin(H) by at most a few ulps. The
+//     error builds up linearly with the number of rotations, so each lane
+//     is re-anchored from dm_cos()/dm_sin() every SUNCURVE_ANCHOR samples.
+//     Between anchors a lane is rotated SUNCURVE_ANCHOR / SUNCURVE_LANES
+//     times, which bounds the drift to below 16 * 4 ulps (1.5e-14) on top
+//     of the error of dm_cos()/dm_sin() for the anchor and the step.
+// 3. Cost per sample is 4 multiplies and 2 adds for the rotation and up to
+//     5 multiply-adds for the three outputs. Two trigonometry calls are
+//     spent per anchor, and 2 * (SUNCURVE_LANES + 1) once per curve.
+//
+
+// Prepare the curve of the Sun for the location and date in *pt*.
+void sunCurveInit(struct _suncurve *sc, struct _ptimes *pt)
+{
+	double decl, eqt, sd, cd, sl, cl;
+
+	pt->sun_model(pt->jd + DAYTIME_DHUHR, &decl, &eqt);
+
+	sd = dm_sin(decl);
+	cd = dm_cos(decl);
+	sl = dm_sin(pt->lat);
+	cl = dm_cos(pt->lat);
+
+	sc->up0 = sl * sd;
+	sc->up1 = cl * cd;
+	sc->east1 = -cd;
+	sc->north0 = cl * sd;
+	sc->north1 = -sl * cd;
+	sc->noon = dm_fixHour(12.0 - eqt) + pt->tz - pt->lng / 15.0;
+}
+
+// Sample *n* points of the curve starting at local clock time *t0* hours
+// every *step* hours, i.e. 1.0 / 60.0 for each minute. Any of *up*, *east*
+// and *north* may be NULL when not needed.
+void sunCurve(struct _suncurve *sc, double t0, double step, int n, double *up, double *east, double *north)
+{
+	double c[SUNCURVE_LANES], s[SUNCURVE_LANES];
+	double rc[SUNCURVE_LANES], rs[SUNCURVE_LANES];
+	double h, dh, cr, sr, ca, sa, x;
+	int i, j, k, m;
+
+	h = 15.0 * (t0 - sc->noon); // hour angle of the first sample in degrees
+	dh = 15.0 * step;
+
+	// lane j runs j steps ahead of lane 0
+	for (j = 0; j < SUNCURVE_LANES; j++)
+	{
+		x = dm_fixAngle(j * dh);
+		rc[j] = dm_cos(x);
+		rs[j] = dm_sin(x);
+	}
+
+	// rotation of every lane per block of samples
+	x = dm_fixAngle(SUNCURVE_LANES * dh);
+	cr = dm_cos(x);
+	sr = dm_sin(x);
+
+	for (i = 0; i < n; i += SUNCURVE_ANCHOR)
+	{
+		// re-anchor to the exact hour angle
+		x = dm_fixAngle(h + i * dh);
+		ca = dm_cos(x);
+		sa = dm_sin(x);
+
+		for (j = 0; j < SUNCURVE_LANES; j++)
+		{
+			c[j] = ca * rc[j] - sa * rs[j];
+			s[j] = sa * rc[j] + ca * rs[j];
+		}
+
+		m = n - i < SUNCURVE_ANCHOR ? n - i : SUNCURVE_ANCHOR;
+
+		for (k = 0; k < m; k += SUNCURVE_LANES)
+		{
+			if (m - k >= SUNCURVE_LANES) // full block
+			{
+				if (up != 0)
+					for (j = 0; j < SUNCURVE_LANES; j++)
+						up[i + k + j] = sc->up0 + sc->up1 * c[j];
+
+				if (east != 0)
+					for (j = 0; j < SUNCURVE_LANES; j++)
+						east[i + k + j] = sc->east1 * s[j];
+
+				if (north != 0)
+					for (j = 0; j < SUNCURVE_LANES; j++)
+						north[i + k + j] = sc->north0 + sc->north1 * c[j];
+			}
+			else // tail
+			{
+				for (j = 0; j < m - k; j++)
+				{
+					if (up != 0)
+						up[i + k + j] = sc->up0 + sc->up1 * c[j];
+
+					if (east != 0)
+						east[i + k + j] = sc->east1 * s[j];
+
+					if (north != 0)
+						north[i + k + j] = sc->north0 + sc->north1 * c[j];
+				}
+			}
+
+			// rotate every lane by SUNCURVE_LANES steps
+			for (j = 0; j < SUNCURVE_LANES; j++)
+			{
+				x = c[j] * cr - s[j] * sr;
+				s[j] = s[j] * cr + c[j] * sr;
+				c[j] = x;
+			}
+		}
+	}
+}
@@ -0,0 +1,36 @@
+// suncurve.h
+
+#ifndef __SUNCURVE_H__
+#define __SUNCURVE_H__
+
+#include "prayertimes.h"
+
+// Samples per lane that are advanced together by one rotation.
+// A multiple of the host vector width keeps the inner loops vectorizable.
+#define SUNCURVE_LANES 4
+
+// Samples between two re-anchors of the hour angle with dm_sin()/dm_cos().
+// Must be a multiple of SUNCURVE_LANES.
+#define SUNCURVE_ANCHOR 64
+
+// The Sun's direction for a day at a location as linear functions of
+// the cosine and sine of the hour angle H:
+//  up    = up0 + up1 * cos(H)       sine of the altitude
+//  east  = east1 * sin(H)           towards the east
+//  north = north0 + north1 * cos(H) towards the north
+// The three form a unit vector. The azimuth from north clockwise is
+// dm_arctan2(east, north) and the altitude is dm_arcsin(up).
+struct _suncurve
+{
+	double up0;
+	double up1;
+	double east1;
+	double north0;
+	double north1;
+	double noon; // local clock time when H is zero
+};
+
+void sunCurveInit(struct _suncurve *sc, struct _ptimes *pt);
+void sunCurve(struct _suncurve *sc, double t0, double step, int n, double *up, double *east, double *north);
+
+#endif